@@ -4,20 +4,23 @@
 #include "tier.h"
 #include <assert.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 
 #define ENOUGH_SPACE 100 // For file names.
 #define GZ_EXT ".gz"
 #define GZ_MAX_LEVEL 9
-#define MGZ_BLOCK_SIZE (1 << 20) // 1 MiB.
+#define MGZ_BLOCK_SIZE (DB_TIER_BLOCK_VALUES * sizeof(uint16_t)) // 1 MiB.
 #define GZ_READ_CHUNK_SIZE INT_MAX
 #define GZ_SEEK_FORWARD_CHUNK_SIZE LONG_MAX
 #define GZ_SEEK_BACKWARDS_CHUNK_SIZE (LONG_MIN + 1)
+#define DB_TELEMETRY_READ_MAX 4096 // Telemetry records are far shorter.
 
 /* Important note: gzread returns the number of bytes read, whereas
    fread returns the number of items read. */
@@ -28,8 +31,11 @@ static char *get_dirname(const char *tier);
 static char *get_tier_filename(const char *tier, bool gz);
 static char *get_lookup_filename(const char *tier);
 static char *get_stat_filename(const char *tier);
+static char *get_telemetry_filename(const char *tier);
+static uint16_t *load_tier_file(const char *tier, uint64_t tierSize);
 static int64_t gzread_helper(gzFile file, voidp buf, uint64_t len);
 static int64_t gzseek_helper(gzFile file, int64_t offset, int whence);
+static bool pread_helper(int fd, void *buf, uint64_t len, uint64_t offset);
 
 static FILE *fopen_tier(const char *tier, const char *modes, bool gz) {
     char *dirname = get_dirname(tier);
@@ -73,6 +79,49 @@ static FILE *fopen_lookup(const char *tier, const char *modes) {
     return fp;
 }
 
+/* Opens a new temporary file in the directory of TIER for writing what
+   is to become file FILENAME, and sets *TMPFILENAME to its name. Each
+   writer gets a file of its own, which commit_file renames over FILENAME
+   once complete, so that readers never see a partially written file even
+   if another process is writing the same file. Returns NULL on failure. */
+static FILE *fopen_tmp(const char *tier, const char *filename, char **tmpFilename) {
+    char *dirname = get_dirname(tier);
+    mkdir(dirname, 0777);
+    free(dirname);
+
+    *tmpFilename = (char*)safe_malloc(strlen(filename) + 8);
+    sprintf(*tmpFilename, "%s.XXXXXX", filename);
+    int fd = mkstemp(*tmpFilename);
+    FILE *fp = NULL;
+    if (fd >= 0 && (fchmod(fd, 0644) || !(fp = fdopen(fd, "wb")))) {
+        close(fd);
+        remove(*tmpFilename);
+    }
+    return fp;
+}
+
+/* Closes FP, opened by fopen_tmp, and renames TMPFILENAME over FILENAME
+   if SUCCESS is true. Otherwise, or on failure, removes TMPFILENAME.
+   Frees TMPFILENAME and returns whether FILENAME was replaced. */
+static bool commit_file(FILE *fp, char *tmpFilename, const char *filename, bool success) {
+    if (fp && fclose(fp)) success = false;
+    success = success && fp && !rename(tmpFilename, filename);
+    if (!success) remove(tmpFilename);
+    free(tmpFilename);
+    return success;
+}
+
+/* Removes the stat file of TIER if it records a layout other than LAYOUT.
+   Called before a tier file in LAYOUT replaces the existing one, so that
+   the tier reads as unsolved rather than being decoded in the wrong
+   layout should the process die before the new stat file is saved. */
+static void remove_stale_stat(const char *tier, int layout) {
+    if (db_load_layout(tier) == layout) return;
+    char *statFilename = get_stat_filename(tier);
+    remove(statFilename);
+    free(statFilename);
+}
+
 static FILE *fopen_stat(const char *tier, const char *modes) {
     char *dirname = get_dirname(tier);
     char *statFilename = get_stat_filename(tier);
@@ -88,6 +137,8 @@ static FILE *fopen_stat(const char *tier, const char *modes) {
 }
 
 uint16_t db_get_value(const char *tier, uint64_t hash) {
+    int layout = db_load_layout(tier);
+    if (layout != DB_LAYOUT_HASH) hash = db_layout_index(layout, tier_size(tier), hash);
     gzFile f = gzopen_tier(tier, "rb");
     if (f == Z_NULL) {
         printf("db_get_value: failed to open tier %s\n", tier);
@@ -111,7 +162,8 @@ uint16_t db_get_value(const char *tier, uint64_t hash) {
 
 /* Returns DB_TIER_OK only if both the given tier and the
    statistics file exist in the database and are believed
-   to be intact. Returns DB_TIER_MISSING if the given tier
+   to be intact. The statistics file may or may not include
+   a memory record, which may be followed by a layout record. Returns DB_TIER_MISSING if the given tier
    does not exist or is believe to be corrupted. Returns
    DB_TIER_STAT_CORRUPTED if both files exist but the
    statistics file appears to be corrupted. */
@@ -150,7 +202,10 @@ int db_check_tier(const char *tier) {
         goto _bailout;
     }
     fseek(fp, 0L, SEEK_END);
-    if (ftell(fp) != sizeof(tier_solver_stat_t)) {
+    long statSize = ftell(fp);
+    if (statSize != sizeof(tier_solver_stat_t) &&
+            statSize != sizeof(tier_solver_stat_t) + sizeof(tier_mem_stat_t) &&
+            statSize != sizeof(tier_solver_stat_t) + sizeof(tier_mem_stat_t) + sizeof(uint64_t)) {
         ret = DB_TIER_STAT_CORRUPTED;
         goto _bailout;
     }
@@ -165,14 +220,16 @@ _bailout:
 }
 
 static bool tier_file_is_valid(const char *tier, const uint16_t *values,
-                               uint64_t tierSize) {
+                               uint64_t tierSize, int layout) {
     int db_tier_status = db_check_tier(tier);
     if (db_tier_status == DB_TIER_MISSING) return false;
+    /* A tier file in another layout is replaced. */
+    if (db_load_layout(tier) != layout) return false;
 
     /* Check if tier file already exists and contains the same data. */
-    uint16_t *existingValues = db_load_tier(tier, tierSize);
+    uint16_t *existingValues = load_tier_file(tier, tierSize);
     if (!existingValues) return false;
-    if (memcmp(existingValues, values, tierSize)) {
+    if (memcmp(existingValues, values, tierSize * sizeof(uint16_t))) {
         printf("tier_file_is_valid: (fatal) new solver result does not match "
                "old database in tier %s.\n", tier);
         exit(1);
@@ -182,62 +239,202 @@ static bool tier_file_is_valid(const char *tier, const uint16_t *values,
     return true;
 }
 
-static void db_save_tier_write_lookup_table(const char *tier,
+/* Writes the lookup table of TIER from the compressed sizes of its
+   blocks and frees OUTBLOCKSIZES. Returns false on failure. */
+static bool db_save_tier_write_lookup_table(const char *tier,
                                             uint64_t *outBlockSizes,
-                                            uint64_t nOutBlocks) {
+                                            uint64_t nOutBlocks,
+                                            memtrack_t *mem) {
     uint64_t t1 = 0, t2 = 0;
     for (uint64_t i = 0; i < nOutBlocks; ++i) {
         t2 = t1 + outBlockSizes[i];
         outBlockSizes[i] = t1;
         t1 = t2;
     }
-    FILE *fp = fopen_lookup(tier, "wb");
-    fwrite(&nOutBlocks, sizeof(uint64_t), 1, fp);
-    fwrite(outBlockSizes, sizeof(uint64_t), nOutBlocks, fp);
-    fclose(fp);
-    free(outBlockSizes);
+    char *filename = get_lookup_filename(tier), *tmpFilename;
+    FILE *fp = fopen_tmp(tier, filename, &tmpFilename);
+    bool success = fp && fwrite(&nOutBlocks, sizeof(uint64_t), 1, fp) == 1 &&
+                   fwrite(outBlockSizes, sizeof(uint64_t), nOutBlocks, fp) == nOutBlocks;
+    success = commit_file(fp, tmpFilename, filename, success);
+    free(filename);
+    memtrack_free(mem, outBlockSizes);
+    return success;
 }
 
-void db_save_tier(const char *tier, const uint16_t *values, uint64_t tierSize) {
+/* Compresses and saves TIERSIZE VALUES of TIER, which are in LAYOUT.
+   The same LAYOUT must be passed to db_save_stat. All memory used for
+   compression is counted towards account MEM, which may be NULL.
+   Returns the number of bytes written, which is 0 if an intact tier
+   file already exists. */
+uint64_t db_save_tier(const char *tier, const uint16_t *values, uint64_t tierSize, int layout,
+                      memtrack_t *mem) {
     /* If the tier file is believed to be intact, skip saving. */
-    if (tier_file_is_valid(tier, values, tierSize)) return;
+    if (tier_file_is_valid(tier, values, tierSize, layout)) return 0;
+    remove_stale_stat(tier, layout);
+    uint64_t written;
+    bool success;
+    char *tmpFilename;
     mgz_res_t mgzRes = mgz_parallel_deflate(values, tierSize * sizeof(uint16_t),
-                                            GZ_MAX_LEVEL, MGZ_BLOCK_SIZE, true);
+                                            GZ_MAX_LEVEL, MGZ_BLOCK_SIZE, true, mem);
+    /* Both files are renamed into place before the caller saves the stat
+       file, which marks the tier as solved. */
     if (mgzRes.out) {
         /* In-memory compression succesfully completed, write it to disk. */
-        FILE *fp = fopen_tier(tier, "wb", true);
-        fwrite(mgzRes.out, 1, mgzRes.size, fp);
-        fclose(fp);
-        free(mgzRes.out);
+        char *filename = get_tier_filename(tier, true);
+        FILE *fp = fopen_tmp(tier, filename, &tmpFilename);
+        success = fp && fwrite(mgzRes.out, 1, mgzRes.size, fp) == mgzRes.size;
+        memtrack_free(mem, mgzRes.out);
+        written = mgzRes.size + (mgzRes.nOutBlocks + 1) * sizeof(uint64_t);
 
         /* Write the lookup table. */
-        db_save_tier_write_lookup_table(tier, mgzRes.outBlockSizes, mgzRes.nOutBlocks);
+        success &= db_save_tier_write_lookup_table(tier, mgzRes.outBlockSizes, mgzRes.nOutBlocks, mem);
+        success = commit_file(fp, tmpFilename, filename, success);
+        free(filename);
     } else {
         /* OOM occured during compression, fall back to storing raw bytes. */
         printf("db_save_tier: mgz compression failed, storing tier %s "
                "in raw bytes\n", tier);
-        FILE *fp = fopen_tier(tier, "wb", false);
-        fwrite(values, sizeof(uint16_t), tierSize, fp);
-        fclose(fp);
+        char *filename = get_tier_filename(tier, false);
+        FILE *fp = fopen_tmp(tier, filename, &tmpFilename);
+        success = fp && fwrite(values, sizeof(uint16_t), tierSize, fp) == tierSize;
+        success = commit_file(fp, tmpFilename, filename, success);
+        free(filename);
+        written = tierSize * sizeof(uint16_t);
+    }
+    if (!success) {
+        printf("db_save_tier: (fatal) failed to save tier %s\n", tier);
+        exit(1);
+    }
+    return written;
+}
+
+/* Opens WRITER for saving TIER block by block in LAYOUT, which must also
+   be passed to db_save_stat. The tier file is written under a temporary
+   name and only replaces any existing one when the writer is closed. All
+   memory used for compression is counted towards account MEM, which may
+   be NULL. Returns false on failure. */
+bool db_open_tier_writer(tier_writer_t *writer, const char *tier, int layout, memtrack_t *mem) {
+    memset(writer, 0, sizeof(*writer));
+    writer->tier = tier;
+    writer->mem = mem;
+    remove_stale_stat(tier, layout);
+    char *filename = get_tier_filename(tier, true);
+    writer->fp = fopen_tmp(tier, filename, &writer->tmpFilename);
+    free(filename);
+    return writer->fp != NULL;
+}
+
+/* Compresses N VALUES into blocks of DB_TIER_BLOCK_VALUES values, as
+   they are stored in a tier file. All memory is allocated through account
+   MEM. Returns all zeros if OOM. */
+mgz_res_t db_compress_tier_values(const uint16_t *values, uint64_t n, memtrack_t *mem) {
+    return mgz_parallel_deflate(values, n * sizeof(uint16_t), GZ_MAX_LEVEL, MGZ_BLOCK_SIZE, true, mem);
+}
+
+/* Appends the compressed BLOCKS, which may have been compressed by
+   another process using db_compress_tier_values, to the tier file of
+   WRITER. The same alignment rule as in db_write_tier_values applies. */
+bool db_write_tier_blocks(tier_writer_t *writer, const mgz_res_t *blocks) {
+    if (writer->nBlocks + blocks->nOutBlocks > writer->capacity) {
+        uint64_t capacity = writer->capacity ? writer->capacity : 64;
+        while (capacity < writer->nBlocks + blocks->nOutBlocks) capacity <<= 1;
+        uint64_t *blockSizes = (uint64_t*)memtrack_realloc(writer->mem, writer->blockSizes,
+                                                           capacity * sizeof(uint64_t));
+        if (!blockSizes) return false;
+        writer->blockSizes = blockSizes;
+        writer->capacity = capacity;
+    }
+    if (fwrite(blocks->out, 1, blocks->size, writer->fp) != blocks->size) return false;
+    memcpy(writer->blockSizes + writer->nBlocks, blocks->outBlockSizes, blocks->nOutBlocks * sizeof(uint64_t));
+    writer->nBlocks += blocks->nOutBlocks;
+    writer->written += blocks->size;
+    return true;
+}
+
+/* Compresses and appends the next N VALUES to the tier file of WRITER.
+   N must be a multiple of DB_TIER_BLOCK_VALUES except for the last call,
+   so that blocks line up with those of db_save_tier. */
+bool db_write_tier_values(tier_writer_t *writer, const uint16_t *values, uint64_t n) {
+    if (!n) return true;
+    mgz_res_t mgzRes = db_compress_tier_values(values, n, writer->mem);
+    if (!mgzRes.out) return false;
+    bool success = db_write_tier_blocks(writer, &mgzRes);
+    memtrack_free(writer->mem, mgzRes.out);
+    memtrack_free(writer->mem, mgzRes.outBlockSizes);
+    return success;
+}
+
+/* Closes WRITER and, if SUCCESS is true, writes the lookup table and
+   moves the tier file into place. Returns the number of bytes written,
+   or 0 on failure, in which case the incomplete tier file is removed. */
+uint64_t db_close_tier_writer(tier_writer_t *writer, bool success) {
+    uint64_t written = writer->written + (writer->nBlocks + 1) * sizeof(uint64_t);
+    if (success) {
+        /* Takes ownership of the block sizes. */
+        success = db_save_tier_write_lookup_table(writer->tier, writer->blockSizes, writer->nBlocks,
+                                                  writer->mem);
+    } else {
+        memtrack_free(writer->mem, writer->blockSizes);
     }
+    if (writer->tmpFilename) {
+        char *filename = get_tier_filename(writer->tier, true);
+        success = commit_file(writer->fp, writer->tmpFilename, filename, success);
+        free(filename);
+    }
+    writer->fp = NULL;
+    writer->tmpFilename = NULL;
+    writer->blockSizes = NULL;
+    return success ? written : 0;
 }
 
-void db_save_stat(const char *tier, const tier_solver_stat_t stat) {
+/* Returns the name of scratch file NAME of TIER, which lives next to the
+   tier file, and creates the directory of the tier if necessary. The
+   returned string should be freed by the caller. */
+char *db_get_scratch_filename(const char *tier, const char *name) {
+    char *dirname = get_dirname(tier);
+    mkdir(dirname, 0777);
+    free(dirname);
+    char *tierFilename = get_tier_filename(tier, false);
+    char *filename = (char*)safe_malloc(strlen(tierFilename) + strlen(name) + 2);
+    sprintf(filename, "%s.%s", tierFilename, name);
+    free(tierFilename);
+    return filename;
+}
+
+/* Saves STAT of TIER, followed by the memory record MEMSTAT unless it
+   is NULL, and the LAYOUT of the tier file unless it is DB_LAYOUT_HASH.
+   An empty memory record is saved if only the layout is needed. */
+void db_save_stat(const char *tier, const tier_solver_stat_t stat, const tier_mem_stat_t *memStat,
+                  int layout) {
+    tier_mem_stat_t emptyMemStat = {0};
+    uint64_t layoutRecord = layout;
     FILE *fp = fopen_stat(tier, "wb");
     fwrite(&stat, sizeof(stat), 1, fp);
+    if (!memStat && layout != DB_LAYOUT_HASH) memStat = &emptyMemStat;
+    if (memStat) fwrite(memStat, sizeof(*memStat), 1, fp);
+    if (layout != DB_LAYOUT_HASH) fwrite(&layoutRecord, sizeof(layoutRecord), 1, fp);
     fclose(fp);
 }
 
-/* Loads values from TIER of size TIERSIZE into a malloc'ed array
-   and return a pointer to the array. The user of this function
-   is responsible for freeing the array. Assumes that TIER exists
-   in the database.
-   
-   Returns a pointer to a malloc'ed array of size 2*TIERSIZE bytes
-   containing the values of tier TIER if no error occurs. Returns
-   NULL if malloc failed. Terminates the program if TIER does not
-   exist in database. */
-uint16_t *db_load_tier(const char *tier, uint64_t tierSize) {
+/* Saves the telemetry record JSON of TIER next to its stat file. */
+void db_save_telemetry(const char *tier, const char *json) {
+    char *dirname = get_dirname(tier);
+    char *filename = get_telemetry_filename(tier);
+    mkdir(dirname, 0777);
+    free(dirname);
+    FILE *fp = fopen(filename, "w");
+    free(filename);
+    if (!fp) {
+        printf("db_save_telemetry: failed to save telemetry for tier %s\n", tier);
+        return;
+    }
+    fputs(json, fp);
+    fclose(fp);
+}
+
+/* Same as db_load_tier, but returns the values in the order in which
+   they are stored in the tier file. */
+static uint16_t *load_tier_file(const char *tier, uint64_t tierSize) {
     bool gz = true;
     gzFile gzLoadFile = Z_NULL;
     FILE *loadfile = NULL;
@@ -276,6 +473,30 @@ uint16_t *db_load_tier(const char *tier, uint64_t tierSize) {
     return values;
 }
 
+/* Loads values from TIER of size TIERSIZE into a malloc'ed array
+   and return a pointer to the array. The user of this function
+   is responsible for freeing the array. Assumes that TIER exists
+   in the database.
+   
+   Returns a pointer to a malloc'ed array of size 2*TIERSIZE bytes
+   containing the values of tier TIER in hash order, regardless of the
+   layout of the tier file, if no error occurs. Returns NULL if malloc
+   failed. Terminates the program if TIER does not exist in database. */
+uint16_t *db_load_tier(const char *tier, uint64_t tierSize) {
+    int layout = db_load_layout(tier);
+    uint16_t *stored = load_tier_file(tier, tierSize);
+    if (!stored || layout == DB_LAYOUT_HASH) return stored;
+
+    uint16_t *values = (uint16_t*)malloc(tierSize * sizeof(uint16_t));
+    if (values) {
+        for (uint64_t i = 0; i < tierSize; ++i) {
+            values[db_layout_hash(layout, tierSize, i)] = stored[i];
+        }
+    }
+    free(stored);
+    return values;
+}
+
 tier_solver_stat_t db_load_stat(const char *tier) {
     tier_solver_stat_t st;
     char *statFilename = get_stat_filename(tier);
@@ -291,6 +512,170 @@ tier_solver_stat_t db_load_stat(const char *tier) {
     return st;
 }
 
+/* Loads the memory record of TIER into MEMSTAT. Returns false if TIER
+   has not been solved or its stat file has no memory record. */
+bool db_load_mem_stat(const char *tier, tier_mem_stat_t *memStat) {
+    char *statFilename = get_stat_filename(tier);
+    FILE *fp = fopen(statFilename, "rb");
+    free(statFilename);
+    if (!fp) return false;
+    bool ret = !fseek(fp, sizeof(tier_solver_stat_t), SEEK_SET) &&
+               fread(memStat, sizeof(*memStat), 1, fp) == 1;
+    fclose(fp);
+    return ret;
+}
+
+/* Loads the number of threads used to solve TIER and the wall-clock
+   seconds of all solver steps from its telemetry record. Returns false
+   if TIER has no telemetry record. */
+bool db_load_solve_time(const char *tier, double *seconds, int *nThreads) {
+    char json[DB_TELEMETRY_READ_MAX + 1];
+    char *filename = get_telemetry_filename(tier);
+    FILE *fp = fopen(filename, "r");
+    free(filename);
+    if (!fp) return false;
+    size_t len = fread(json, 1, DB_TELEMETRY_READ_MAX, fp);
+    fclose(fp);
+    json[len] = '\0';
+
+    /* Step times are the only fields named "seconds" and come after the
+       number of threads. */
+    const char *threads = strstr(json, "\"threads\":");
+    const char *steps = strstr(json, "\"steps\":");
+    if (!threads || !steps) return false;
+    *nThreads = atoi(threads + strlen("\"threads\":"));
+    *seconds = 0.0;
+    for (const char *walker = strstr(steps, "\"seconds\":"); walker; walker = strstr(walker, "\"seconds\":")) {
+        walker += strlen("\"seconds\":");
+        *seconds += atof(walker);
+    }
+    return true;
+}
+
+/* Returns the layout of the tier file of TIER as recorded in its stat
+   file, or DB_LAYOUT_HASH if there is no layout record. */
+int db_load_layout(const char *tier) {
+    uint64_t layout;
+    char *statFilename = get_stat_filename(tier);
+    FILE *fp = fopen(statFilename, "rb");
+    free(statFilename);
+    if (!fp) return DB_LAYOUT_HASH;
+    bool found = !fseek(fp, sizeof(tier_solver_stat_t) + sizeof(tier_mem_stat_t), SEEK_SET) &&
+                 fread(&layout, sizeof(layout), 1, fp) == 1;
+    fclose(fp);
+    return found ? (int)layout : DB_LAYOUT_HASH;
+}
+
+/* Opens TIER of size TIERSIZE for block-wise reading and sets up READER.
+   Block boundaries are taken from the lookup table written alongside
+   the compressed tier file. If the lookup table is missing, the whole
+   compressed tier is treated as a single block. Raw tier files are split
+   into blocks of the same size as compressed ones.
+
+   Values are read in the layout of the tier file, see READER->layout.
+   Returns true on success, or false if malloc failed. Terminates the
+   program if TIER does not exist in the database. The READER should be
+   closed using db_close_tier_reader. All memory used by the reader is
+   counted towards account MEM, which may be NULL. */
+bool db_open_tier_reader(tier_reader_t *reader, const char *tier, uint64_t tierSize,
+                         memtrack_t *mem) {
+    const uint64_t blockSize = MGZ_BLOCK_SIZE / sizeof(uint16_t);
+    char *filename = get_tier_filename(tier, true);
+    struct stat st;
+    FILE *lookup = NULL;
+    memset(reader, 0, sizeof(*reader));
+    reader->mem = mem;
+    reader->tierSize = tierSize;
+    reader->layout = db_load_layout(tier);
+    reader->gz = true;
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0) {
+        /* .gz file not found. Try loading the raw bytes. */
+        free(filename);
+        filename = get_tier_filename(tier, false);
+        reader->gz = false;
+        reader->fd = open(filename, O_RDONLY);
+    }
+    free(filename);
+    if (reader->fd < 0 || fstat(reader->fd, &st)) {
+        printf("db_open_tier_reader: (fatal) failed to open tier %s\n", tier);
+        exit(1);
+    }
+
+    reader->blockSize = blockSize;
+    reader->nBlocks = (tierSize + blockSize - 1) / blockSize;
+    if (reader->gz) {
+        lookup = fopen_lookup(tier, "rb");
+        uint64_t nBlocks = 0;
+        if (!lookup || fread(&nBlocks, sizeof(uint64_t), 1, lookup) != 1 ||
+                nBlocks != reader->nBlocks) {
+            /* Lookup table missing or inconsistent with the tier size. */
+            reader->blockSize = tierSize;
+            reader->nBlocks = 1;
+        }
+    }
+    reader->offsets = (uint64_t*)memtrack_malloc(mem, (reader->nBlocks + 1) * sizeof(uint64_t));
+    if (!reader->offsets) {
+        if (lookup) fclose(lookup);
+        db_close_tier_reader(reader);
+        return false;
+    }
+
+    if (!reader->gz) {
+        for (uint64_t i = 0; i <= reader->nBlocks; ++i) {
+            reader->offsets[i] = i * blockSize * sizeof(uint16_t);
+        }
+        reader->offsets[reader->nBlocks] = tierSize * sizeof(uint16_t);
+    } else if (reader->nBlocks == 1 && reader->blockSize == tierSize) {
+        reader->offsets[0] = 0;
+    } else if (fread(reader->offsets, sizeof(uint64_t), reader->nBlocks, lookup) != reader->nBlocks) {
+        printf("db_open_tier_reader: (fatal) corrupted lookup table for tier %s\n", tier);
+        exit(1);
+    }
+    if (reader->gz) reader->offsets[reader->nBlocks] = (uint64_t)st.st_size;
+    if (lookup) fclose(lookup);
+    return true;
+}
+
+/* Reads and, if necessary, decompresses block BLOCK of the tier opened
+   by READER into OUT, which must have space for READER->blockSize values.
+   This function is thread-safe.
+
+   Returns the number of values read, or 0 if malloc failed. Terminates
+   the program if the block cannot be read from disk or is corrupted. */
+uint64_t db_read_tier_block(const tier_reader_t *reader, uint64_t block, uint16_t *out) {
+    uint64_t begin = block * reader->blockSize;
+    uint64_t size = reader->tierSize - begin;
+    if (size > reader->blockSize) size = reader->blockSize;
+    uint64_t inSize = reader->offsets[block + 1] - reader->offsets[block];
+
+    if (!reader->gz) {
+        if (!pread_helper(reader->fd, out, size * sizeof(uint16_t), reader->offsets[block])) {
+            printf("db_read_tier_block: (fatal) failed to read block %"PRIu64
+                   " in raw format.\n", block);
+            exit(1);
+        }
+        return size;
+    }
+
+    void *in = memtrack_malloc(reader->mem, inSize);
+    if (!in) return 0;
+    if (!pread_helper(reader->fd, in, inSize, reader->offsets[block]) ||
+            mgz_inflate(out, size * sizeof(uint16_t), in, inSize) != size * sizeof(uint16_t)) {
+        printf("db_read_tier_block: (fatal) failed to load block %"PRIu64
+               " in gzip format.\n", block);
+        exit(1);
+    }
+    memtrack_free(reader->mem, in);
+    return size;
+}
+
+void db_close_tier_reader(tier_reader_t *reader) {
+    if (reader->fd >= 0) close(reader->fd);
+    reader->fd = -1;
+    memtrack_free(reader->mem, reader->offsets); reader->offsets = NULL;
+}
+
 /* Helper function definitions. */
 
 /* Assumes enough space at rem. */
@@ -339,6 +724,15 @@ static char *get_stat_filename(const char *tier) {
     return statFilename;
 }
 
+static char *get_telemetry_filename(const char *tier) {
+    char *filename = get_tier_filename(tier, false);
+    char *telemetryFilename = (char *)safe_calloc(ENOUGH_SPACE, sizeof(char));
+    strcat(telemetryFilename, filename);
+    strcat(telemetryFilename, ".json");
+    free(filename);
+    return telemetryFilename;
+}
+
 /* Wrapper function around gzread using 64-bit unsigned integer
    as read size and 64-bit signed integer as return type to
    allow the reading of more than INT_MAX bytes. */
@@ -391,3 +785,16 @@ static int64_t gzseek_helper(gzFile file, int64_t offset, int whence) {
 
     return total + sought;
 }
+
+/* Wrapper function around pread that keeps reading until all LEN
+   bytes at OFFSET are read. Returns true on success. */
+static bool pread_helper(int fd, void *buf, uint64_t len, uint64_t offset) {
+    while (len) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n <= 0) return false;
+        buf = (void*)((uint8_t*)buf + n);
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
@@ -1,7 +1,12 @@
 #ifndef DB_H
 #define DB_H
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "memtrack.h"
+#include "mgz.h"
+
+#define DB_NUM_SOLVER_STEPS 7
 
 enum db_tier_file_status {
     DB_TIER_OK = 0,
@@ -19,12 +24,93 @@ typedef struct TierSolverStat {
     uint64_t longestPosToBlackWin;
 } tier_solver_stat_t;
 
+/* Measured memory usage of solving a tier, stored in the stat file right
+   after the statistics. Stat files written before this record existed
+   hold the statistics only. */
+typedef struct TierMemStat {
+    uint64_t mode;                             // Solver mode, see tiersolver.h.
+    uint64_t peak;                             // Peak bytes over all steps.
+    uint64_t stepPeaks[DB_NUM_SOLVER_STEPS];   // Peak bytes in each solver step.
+} tier_mem_stat_t;
+
+/* Order of the values in a tier file, recorded in its stat file right
+   after the memory record. Tier files without this record are in hash
+   order. All functions below take the layout into account, so values
+   can always be looked up and loaded by hash. */
+enum db_tier_layout {
+    DB_LAYOUT_HASH = 0,    // The value of position HASH is at index HASH.
+    DB_LAYOUT_TURN_SPLIT   // Even hashes (red to move) first, then odd hashes, both in ascending order.
+};
+
+/* Returns the index of position HASH in a tier of size TIERSIZE stored in LAYOUT. */
+static inline uint64_t db_layout_index(int layout, uint64_t tierSize, uint64_t hash) {
+    if (layout != DB_LAYOUT_TURN_SPLIT) return hash;
+    return (hash & 1) ? ((tierSize + 1) >> 1) + (hash >> 1) : hash >> 1;
+}
+
+/* Returns the hash of the position at INDEX in a tier of size TIERSIZE stored in LAYOUT. */
+static inline uint64_t db_layout_hash(int layout, uint64_t tierSize, uint64_t index) {
+    if (layout != DB_LAYOUT_TURN_SPLIT) return index;
+    uint64_t half = (tierSize + 1) >> 1;
+    return (index < half) ? index << 1 : ((index - half) << 1) | 1;
+}
+
+/* Number of values in each block of a compressed tier file. */
+#define DB_TIER_BLOCK_VALUES ((1 << 20) / sizeof(uint16_t))
+
+/* Block-wise reader of a tier file. A tier file consists of NBLOCKS
+   blocks of BLOCKSIZE values each, except for the last block which may
+   be shorter. Blocks are independent and may be read concurrently. */
+typedef struct TierReader {
+    int fd;
+    bool gz;
+    uint64_t tierSize;
+    uint64_t blockSize;
+    uint64_t nBlocks;
+    uint64_t *offsets; // NBLOCKS+1 byte offsets of each block in the tier file.
+    int layout;        // Layout of the tier file, see enum db_tier_layout.
+    memtrack_t *mem;   // Account of all memory used by the reader.
+} tier_reader_t;
+
 uint16_t db_get_value(const char *tier, uint64_t hash);
 int db_check_tier(const char *tier);
 
-void db_save_tier(const char *tier, const uint16_t *values, uint64_t tierSize);
-void db_save_stat(const char *tier, const tier_solver_stat_t stat);
+uint64_t db_save_tier(const char *tier, const uint16_t *values, uint64_t tierSize, int layout,
+                      memtrack_t *mem);
+void db_save_stat(const char *tier, const tier_solver_stat_t stat, const tier_mem_stat_t *memStat,
+                  int layout);
+void db_save_telemetry(const char *tier, const char *json);
 uint16_t *db_load_tier(const char *tier, uint64_t tierSize);
 tier_solver_stat_t db_load_stat(const char *tier);
+bool db_load_mem_stat(const char *tier, tier_mem_stat_t *memStat);
+bool db_load_solve_time(const char *tier, double *seconds, int *nThreads);
+int db_load_layout(const char *tier);
+
+bool db_open_tier_reader(tier_reader_t *reader, const char *tier, uint64_t tierSize,
+                         memtrack_t *mem);
+uint64_t db_read_tier_block(const tier_reader_t *reader, uint64_t block, uint16_t *out);
+void db_close_tier_reader(tier_reader_t *reader);
+
+/* Streaming writer of a compressed tier file, for tiers whose values do
+   not fit into memory at once. The file is identical to the one saved by
+   db_save_tier from the same values. */
+typedef struct TierWriter {
+    const char *tier;
+    FILE *fp;
+    char *tmpFilename;     // Name of the tier file until it is complete.
+    uint64_t *blockSizes;  // Compressed size of each block written so far.
+    uint64_t nBlocks;
+    uint64_t capacity;     // Capacity of BLOCKSIZES.
+    uint64_t written;      // Bytes written to the tier file so far.
+    memtrack_t *mem;       // Account of all memory used by the writer.
+} tier_writer_t;
+
+bool db_open_tier_writer(tier_writer_t *writer, const char *tier, int layout, memtrack_t *mem);
+bool db_write_tier_values(tier_writer_t *writer, const uint16_t *values, uint64_t n);
+mgz_res_t db_compress_tier_values(const uint16_t *values, uint64_t n, memtrack_t *mem);
+bool db_write_tier_blocks(tier_writer_t *writer, const mgz_res_t *blocks);
+uint64_t db_close_tier_writer(tier_writer_t *writer, bool success);
+
+char *db_get_scratch_filename(const char *tier, const char *name);
 
 #endif // DB_H
@@ -1,58 +1,137 @@
 #include "frontier.h"
 #include "misc.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-void frontier_init(fr_t *frontier, uint16_t size) {
-    frontier->size = size;
-    frontier->buckets = (uint64_t**)safe_calloc(size, sizeof(uint64_t*));
-    frontier->capacities = (uint64_t*)safe_calloc(size, sizeof(uint64_t));
-    frontier->sizes = (uint64_t*)safe_calloc(size, sizeof(uint64_t));
-    frontier->locks = (omp_lock_t*)safe_calloc(size, sizeof(omp_lock_t));
-    for (uint16_t i = 0; i < frontier->size; ++i) {
-        omp_init_lock(&frontier->locks[i]);
+static fr_level_t *level_create(uint16_t nSegments, memtrack_t *mem) {
+    /* All arrays of a level live in the same allocation. */
+    uint64_t bytes = sizeof(fr_level_t) + nSegments * (sizeof(uint64_t*) +
+                     2 * sizeof(uint64_t) + sizeof(omp_lock_t));
+    fr_level_t *level = (fr_level_t*)memtrack_calloc(mem, 1, bytes);
+    if (!level) return NULL;
+    level->buckets = (uint64_t**)(level + 1);
+    level->capacities = (uint64_t*)(level->buckets + nSegments);
+    level->sizes = level->capacities + nSegments;
+    level->locks = (omp_lock_t*)(level->sizes + nSegments);
+    for (uint16_t i = 0; i < nSegments; ++i) {
+        omp_init_lock(&level->locks[i]);
+    }
+    return level;
+}
+
+static void level_destroy(fr_level_t *level, uint16_t nSegments, memtrack_t *mem) {
+    if (!level) return;
+    for (uint16_t i = 0; i < nSegments; ++i) {
+        memtrack_free(mem, level->buckets[i]);
+        omp_destroy_lock(&level->locks[i]);
     }
+    memtrack_free(mem, level);
+}
+
+/* Returns false if OOM, in which case FRONTIER is empty and may still
+   be passed to frontier_destroy. */
+bool frontier_init(fr_t *frontier, uint16_t size, uint16_t nSegments, memtrack_t *mem) {
+    frontier->size = size;
+    frontier->nSegments = nSegments;
+    frontier->levelsEnd = 0;
+    frontier->mem = mem;
+    frontier->lockWaitNs = 0;
+    frontier->levels = (fr_level_t**)memtrack_calloc(mem, size, sizeof(fr_level_t*));
+    if (!frontier->levels) return false;
+    omp_init_lock(&frontier->levelsLock);
+    return true;
 }
 
 void frontier_destroy(fr_t *frontier) {
-    if (frontier->buckets) {
-        for (uint16_t i = 0; i < frontier->size; ++i) {
-            if (frontier->buckets[i]) {
-                free(frontier->buckets[i]);
-            }
-        }
-        free(frontier->buckets); frontier->buckets = NULL;
+    if (!frontier->levels) return;
+    for (uint16_t i = 0; i < frontier->size; ++i) {
+        level_destroy(frontier->levels[i], frontier->nSegments, frontier->mem);
     }
-    free(frontier->capacities); frontier->capacities = NULL;
-    free(frontier->sizes); frontier->sizes = NULL;
-    if (frontier->locks) {
-        for (uint16_t i = 0; i < frontier->size; ++i) {
-            omp_destroy_lock(&frontier->locks[i]);
+    memtrack_free(frontier->mem, frontier->levels); frontier->levels = NULL;
+    omp_destroy_lock(&frontier->levelsLock);
+}
+
+bool frontier_add(fr_t *frontier, uint64_t hash, uint16_t rmt, uint16_t seg) {
+    fr_level_t *level = __atomic_load_n(&frontier->levels[rmt], __ATOMIC_ACQUIRE);
+    if (!level) {
+        /* First position at this remoteness, allocate the level. */
+        uint64_t wait = set_lock_timed(&frontier->levelsLock);
+        if (wait) __atomic_add_fetch(&frontier->lockWaitNs, wait, __ATOMIC_RELAXED);
+        level = frontier->levels[rmt];
+        if (!level) {
+            level = level_create(frontier->nSegments, frontier->mem);
+            __atomic_store_n(&frontier->levels[rmt], level, __ATOMIC_RELEASE);
+            if (level && rmt >= frontier->levelsEnd) frontier->levelsEnd = rmt + 1;
         }
-        free(frontier->locks); frontier->locks = NULL;
+        omp_unset_lock(&frontier->levelsLock);
+        if (!level) return false;
     }
-}
 
-bool frontier_add(fr_t *frontier, uint64_t hash, uint16_t rmt) {
-    omp_set_lock(&frontier->locks[rmt]);
-    if (frontier->sizes[rmt] == frontier->capacities[rmt]) {
-        if (frontier->capacities[rmt]) {
-            frontier->capacities[rmt] <<= 1;
+    uint64_t wait = set_lock_timed(&level->locks[seg]);
+    if (wait) __atomic_add_fetch(&frontier->lockWaitNs, wait, __ATOMIC_RELAXED);
+    if (level->sizes[seg] == level->capacities[seg]) {
+        if (level->capacities[seg]) {
+            level->capacities[seg] <<= 1;
         } else {
-            frontier->capacities[rmt] = 1ULL;
+            level->capacities[seg] = 1ULL;
         }
-        uint64_t *newBucket = (uint64_t*)realloc(frontier->buckets[rmt], frontier->capacities[rmt] * sizeof(uint64_t));
+        uint64_t *newBucket = (uint64_t*)memtrack_realloc(frontier->mem, level->buckets[seg],
+                                                         level->capacities[seg] * sizeof(uint64_t));
         if (!newBucket) {
-            omp_unset_lock(&frontier->locks[rmt]);
+            omp_unset_lock(&level->locks[seg]);
             return false;
         }
-        frontier->buckets[rmt] = newBucket;
+        level->buckets[seg] = newBucket;
     }
-    frontier->buckets[rmt][frontier->sizes[rmt]++] = hash;
-    omp_unset_lock(&frontier->locks[rmt]);
+    level->buckets[seg][level->sizes[seg]++] = hash;
+    omp_unset_lock(&level->locks[seg]);
     return true;
 }
 
+/* Frees all segments of level RMT. */
 void frontier_free(fr_t *frontier, uint16_t rmt) {
-    free(frontier->buckets[rmt]); frontier->buckets[rmt] = NULL;
+    level_destroy(frontier->levels[rmt], frontier->nSegments, frontier->mem);
+    frontier->levels[rmt] = NULL;
+}
+
+static int cmp_hash(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts segment SEG of level RMT by hash. */
+void frontier_sort(fr_t *frontier, uint16_t rmt, uint16_t seg) {
+    fr_level_t *level = frontier->levels[rmt];
+    if (!level || level->sizes[seg] < 2) return;
+    qsort(level->buckets[seg], level->sizes[seg], sizeof(uint64_t), cmp_hash);
+}
+
+/**
+ * @brief Lays the segments of level RMT out as consecutive ranges and
+ * returns the total number of positions at that level. Positions of
+ * segment SEG occupy indices OFFSETS[SEG] to OFFSETS[SEG+1]-1. OFFSETS
+ * must have space for NSEGMENTS+1 entries.
+ */
+uint64_t frontier_get_ranges(const fr_t *frontier, uint16_t rmt, uint64_t *offsets) {
+    const fr_level_t *level = frontier->levels[rmt];
+    offsets[0] = 0;
+    for (uint16_t seg = 0; seg < frontier->nSegments; ++seg) {
+        offsets[seg + 1] = offsets[seg] + (level ? level->sizes[seg] : 0);
+    }
+    return offsets[frontier->nSegments];
+}
+
+/**
+ * @brief Returns the segment whose range contains index I, given the
+ * OFFSETS returned by frontier_get_ranges. Assumes I is in range.
+ */
+uint16_t frontier_find_segment(const uint64_t *offsets, uint16_t nSegments, uint64_t i) {
+    uint16_t lo = 0, hi = nSegments - 1;
+    while (lo < hi) {
+        uint16_t mid = lo + ((hi - lo + 1) >> 1);
+        if (offsets[mid] <= i) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
 }
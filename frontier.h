@@ -3,19 +3,40 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <omp.h>
+#include "memtrack.h"
 
-typedef struct Frontier {
-    uint16_t size;
+/* Positions at one remoteness level, split into NSEGMENTS segments so
+   that positions from different tiers never share an array. A level is
+   only allocated once the first position is added to it. */
+typedef struct FrontierLevel {
     uint64_t **buckets;
     uint64_t *capacities;
     uint64_t *sizes;
     omp_lock_t *locks;
+} fr_level_t;
+
+/* A frontier holds SIZE remoteness levels. Levels that have never been
+   added to are NULL and take no memory besides their pointer. All levels
+   at or above LEVELSEND have always been empty. All memory of the
+   frontier is counted towards account MEM. */
+typedef struct Frontier {
+    uint16_t size;
+    uint16_t nSegments;
+    uint16_t levelsEnd;
+    fr_level_t **levels;
+    omp_lock_t levelsLock;
+    memtrack_t *mem;
+    uint64_t lockWaitNs; // Total time spent waiting for locks.
 } fr_t;
 
-void frontier_init(fr_t *frontier, uint16_t size);
+bool frontier_init(fr_t *frontier, uint16_t size, uint16_t nSegments, memtrack_t *mem);
 void frontier_destroy(fr_t *frontier);
 
-bool frontier_add(fr_t *frontier, uint64_t hash, uint16_t rmt);
+bool frontier_add(fr_t *frontier, uint64_t hash, uint16_t rmt, uint16_t seg);
 void frontier_free(fr_t *frontier, uint16_t rmt);
+void frontier_sort(fr_t *frontier, uint16_t rmt, uint16_t seg);
+
+uint64_t frontier_get_ranges(const fr_t *frontier, uint16_t rmt, uint64_t *offsets);
+uint16_t frontier_find_segment(const uint64_t *offsets, uint16_t nSegments, uint64_t i);
 
 #endif // FRONTIER_H
@@ -45,6 +45,8 @@ static void add_parents(pos_array_t *parents, const char *tier,
 static uint64_t *hash_to_steps(const char *tier, uint64_t hash);
 static uint64_t steps_to_hash(const char *tier, const uint64_t *steps);
 static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps);
+static void steps_to_board_from(board_t *board, const char *tier, const uint64_t *steps,
+                                int firstStep, uint8_t (*sizesBefore)[2]);
 static uint64_t *board_to_steps(const char *tier, const board_t *board);
 
 static uint64_t combiCount(const uint8_t *counts, uint8_t numPieces);
@@ -131,6 +133,7 @@ ext_pos_array_t game_get_children(const char *tier, uint64_t hash) {
  * wish to return to) to child tier (the current TIER.)
  * @param board: this global board should be pre-allocated and empty
  * initialized by the caller.
+ * @param cache: unhash cache of the calling thread, or NULL.
  * @return A PositionArray which contains a pointer to an array of
  * parent position hashes and the size of that array. If OOM,
  * the size of the array is set to ILLEGAL_POSITION_ARRAY_SIZE_OOM
@@ -138,10 +141,10 @@ ext_pos_array_t game_get_children(const char *tier, uint64_t hash) {
  * malloced and should be freed by the caller of this function.
  */
 pos_array_t game_get_parents(const char *tier, uint64_t hash, const char *parentTier,
-                             tier_change_t change, board_t *board) {
+                             tier_change_t change, board_t *board, unhash_cache_t *cache) {
     pos_array_t parents;
     memset(&parents, 0, sizeof(parents));
-    if (!game_unhash(board, tier, hash)) {
+    if (!game_unhash_cached(board, tier, hash, cache)) {
         parents.size = ILLEGAL_POSITION_ARRAY_SIZE_OOM;
         goto _bailout;
     }
@@ -238,6 +241,62 @@ bool game_unhash(board_t *board, const char *tier, uint64_t hash) {
     return success;
 }
 
+void game_init_unhash_cache(unhash_cache_t *cache) {
+    memset(cache, 0, sizeof(*cache));
+    game_init_board(&cache->board);
+}
+
+/**
+ * @brief Same as game_unhash, but reuses the leading steps of the position
+ * unhashed last through CACHE if they match. BOARD is overwritten with a
+ * copy of the cached board. Falls back to game_unhash if CACHE is NULL.
+ */
+bool game_unhash_cached(board_t *board, const char *tier, uint64_t hash, unhash_cache_t *cache) {
+    if (!cache) return game_unhash(board, tier, hash);
+    uint64_t steps[NUM_TIER_SIZE_STEPS + 1];
+    int firstStep = 0;
+
+    if (!cache->valid || strcmp(cache->tier, tier)) {
+        uint64_t *stepsMax = tier_size_steps(tier);
+        if (!stepsMax) return false; // OOM.
+        memcpy(cache->stepsMax, stepsMax, NUM_TIER_SIZE_STEPS * sizeof(uint64_t));
+        free(stepsMax);
+        strcpy(cache->tier, tier);
+        game_init_board(&cache->board);
+        cache->valid = false;
+    }
+
+    /* Same as hash_to_steps. */
+    steps[NUM_TIER_SIZE_STEPS] = hash & 1ULL;
+    hash >>= 1;
+    for (int i = NUM_TIER_SIZE_STEPS - 1; i >= 0; --i) {
+        steps[i] = hash % cache->stepsMax[i];
+        hash /= cache->stepsMax[i];
+    }
+
+    if (cache->valid) {
+        /* Take off the pieces placed at and after the first step that differs. */
+        while (firstStep < NUM_TIER_SIZE_STEPS && steps[firstStep] == cache->steps[firstStep]) ++firstStep;
+        for (int color = 0; color < 2; ++color) {
+            piece_t *pieces = cache->board.pieces + color * BOARD_PIECES_OFFSET;
+            for (uint8_t i = cache->sizesBefore[firstStep][color];
+                    i < cache->sizesBefore[NUM_TIER_SIZE_STEPS][color]; ++i) {
+                cache->board.layout[pieces[i].row*BOARD_COLS + pieces[i].col] = BOARD_EMPTY_CELL;
+            }
+        }
+    }
+    steps_to_board_from(&cache->board, tier, steps, firstStep, cache->sizesBefore);
+    memcpy(cache->steps, steps, sizeof(steps));
+    cache->nSteps += NUM_TIER_SIZE_STEPS;
+    cache->nStepsReused += firstStep;
+
+    /* Overlapping pieces of an invalid position can not be taken off
+       one by one, so the next position is unhashed from scratch. */
+    cache->valid = cache->board.valid;
+    memcpy(board, &cache->board, sizeof(board_t));
+    return true;
+}
+
 static void take_pieces_off_and_rotate(piece_t *pieces, int8_t *layout) {
     for (int8_t i = 0; pieces[i].token != BOARD_EMPTY_CELL; ++i) {
         layout[pieces[i].row*BOARD_COLS + pieces[i].col] = BOARD_EMPTY_CELL;
@@ -985,6 +1044,23 @@ static uint8_t set_slots(uint8_t *slots, const int8_t *layout, int step, uint8_t
 
 static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
     if (!steps) return false; // OOM in previous step.
+    steps_to_board_from(board, tier, steps, 0, NULL);
+    return true;
+}
+
+static inline void record_sizes_before(uint8_t (*sizesBefore)[2], int step, const uint8_t *piecesSizes) {
+    if (sizesBefore) memcpy(sizesBefore[step], piecesSizes, 2 * sizeof(uint8_t));
+}
+
+/**
+ * @brief Places the pieces of STEPS on BOARD starting from step FIRSTSTEP,
+ * assuming that the pieces of all previous steps are already on BOARD.
+ * If SIZESBEFORE is not NULL, it holds the number of pieces of each color
+ * placed before each step and is updated for FIRSTSTEP and later steps.
+ * SIZESBEFORE must not be NULL if FIRSTSTEP is not 0.
+ */
+static void steps_to_board_from(board_t *board, const char *tier, const uint64_t *steps,
+                                int firstStep, uint8_t (*sizesBefore)[2]) {
     int step, parity;
     uint8_t i, j, nLessRestrictedP, nMoreRestrictedP;
     uint8_t slots[BOARD_SIZE];
@@ -993,12 +1069,14 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
     uint8_t piecesSizes[2] = {0, 0};
     uint8_t pawnsPerRow[2 * BOARD_ROWS];
 
+    if (firstStep) memcpy(piecesSizes, sizesBefore[firstStep], sizeof(piecesSizes));
     board->valid = true; // Should an error occur, set this value to false in that step.
     tier_get_pawns_per_row(tier, pawnsPerRow);
     piecesToPlace[0] = BOARD_EMPTY_CELL; // Empty cell is always the 0-th piece to place.
 
     /* STEP 0 & 1: KINGS AND ADVISORS. */
-    for (step = 0; step < 2; ++step) {
+    for (step = firstStep; step < 2; ++step) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
         piece_t *pieces = board->pieces + step * BOARD_PIECES_OFFSET;
         set_slots(slots, NULL, step, 0);
         piecesToPlace[1] = BOARD_RED_KING + step;
@@ -1073,6 +1151,7 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
 
     /* STEP 2 & 3: BISHOPS. */
     for (; step < 4; ++step) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
         parity = step & 1;
         set_slots(slots, NULL, step, 0);
         rems[1] = tier[RED_B_IDX + parity] - '0';
@@ -1084,6 +1163,7 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
 
     /* STEPS 4 - 6: RED PAWNS IN THE TOP THREE ROWS. */
     for (; step < 7; ++step) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
         set_slots(slots, NULL, step, 0);
         rems[1] = pawnsPerRow[step - 4]; // # red pawns in curr row.
         rems[0] = BOARD_COLS - rems[1];  // # empty slots in curr row.
@@ -1094,6 +1174,7 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
 
     /* STEPS 7 - 10: PAWNS IN ROW 3 THRU ROW 6. */
     for (; step < 11; ++step) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
         nMoreRestrictedP = pawnsPerRow[BOARD_ROWS * (step < 9) + step - 4];
         nLessRestrictedP = pawnsPerRow[BOARD_ROWS * (step >= 9) + step - 4];
 
@@ -1116,6 +1197,7 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
 
     /* STEPS 11 - 13: BLACK PAWNS IN THE BOTTOM THREE ROWS. */
     for (; step < 14; ++step) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
         set_slots(slots, NULL, step, 0);
         rems[1] = pawnsPerRow[BOARD_ROWS + step - 4]; // # black pawns in curr row.
         rems[0] = BOARD_COLS - rems[1];               // # empty slots in curr row.
@@ -1125,14 +1207,19 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
     }
 
     /* STEP 14: KNIGHTS, CANNONS, AND ROOKS. */
-    i = set_slots(slots, board->layout, step, 0);
-    rems[0] = i;
-    for (j = RED_N_IDX; j <= BLACK_R_IDX; ++j) {
-        rems[j - RED_N_IDX + 1] = tier[j] - '0';
-        rems[0] -= tier[j] - '0';
-        piecesToPlace[j - RED_N_IDX + 1] = BOARD_RED_KNIGHT + j - RED_N_IDX;
+    if (step == 14) {
+        record_sizes_before(sizesBefore, step, piecesSizes);
+        i = set_slots(slots, board->layout, step, 0);
+        rems[0] = i;
+        for (j = RED_N_IDX; j <= BLACK_R_IDX; ++j) {
+            rems[j - RED_N_IDX + 1] = tier[j] - '0';
+            rems[0] -= tier[j] - '0';
+            piecesToPlace[j - RED_N_IDX + 1] = BOARD_RED_KNIGHT + j - RED_N_IDX;
+        }
+        hash_uncruncher(steps[step], board, piecesSizes, slots, i, piecesToPlace, rems, 7);
+        ++step;
     }
-    hash_uncruncher(steps[step], board, piecesSizes, slots, i, piecesToPlace, rems, 7);
+    record_sizes_before(sizesBefore, step, piecesSizes);
 
     /* STEP 15: TURN BIT. */
     board->blackTurn = steps[15];
@@ -1140,7 +1227,6 @@ static bool steps_to_board(board_t *board, const char *tier, uint64_t *steps) {
     /* NULL-terminate the pieces arrays. */
     board->pieces[piecesSizes[0]] = (piece_t){BOARD_EMPTY_CELL, 0, 0};
     board->pieces[BOARD_PIECES_OFFSET + piecesSizes[1]] = (piece_t){BOARD_EMPTY_CELL, 0, 0};
-    return true;
 }
 
 static uint64_t *board_to_steps(const char *tier, const board_t *board) {
@@ -41,15 +41,34 @@ typedef struct ExtendedPositionArray {
     uint8_t size;
 } ext_pos_array_t;
 
+/* Board of the position unhashed last by a thread, together with what is
+   needed to unhash the next position from it. Unhashing places pieces
+   one step at a time, so if the next position shares the leading steps
+   of the last one, only the remaining steps are redone. Positions
+   unhashed in ascending hash order share most of their leading steps. */
+typedef struct UnhashCache {
+    char tier[TIER_STR_LENGTH_MAX];
+    uint64_t stepsMax[NUM_TIER_SIZE_STEPS];
+    uint64_t steps[NUM_TIER_SIZE_STEPS + 1];
+    uint8_t sizesBefore[NUM_TIER_SIZE_STEPS + 1][2]; // Pieces of each color placed before each step.
+    board_t board;
+    bool valid;
+    uint64_t nSteps;       // Steps needed by all unhashes so far.
+    uint64_t nStepsReused; // Steps taken from the cached board instead.
+} unhash_cache_t;
+
+void game_init_unhash_cache(unhash_cache_t *cache);
+
 uint8_t game_num_child_pos(const char *tier, uint64_t hash, board_t *board);
 ext_pos_array_t game_get_children(const char *tier, uint64_t hash);
 pos_array_t game_get_parents(const char *tier, uint64_t hash, const char *parentTier,
-                             tier_change_t change, board_t *board);
+                             tier_change_t change, board_t *board, unhash_cache_t *cache);
 
 bool game_is_black_turn(uint64_t hash);
 
 uint64_t game_hash(const char *tier, const board_t *board);
 bool game_unhash(board_t *board, const char *tier, uint64_t hash);
+bool game_unhash_cached(board_t *board, const char *tier, uint64_t hash, unhash_cache_t *cache);
 uint64_t game_get_noncanonical_hash(const char *canonicalTier, uint64_t canonicalHash,
                                     const char *noncanonicalTier, board_t *board);
 
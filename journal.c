@@ -0,0 +1,70 @@
+#include "journal.h"
+#include "misc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Returns all complete records of the journal in FILENAME and sets
+ * *N to their number, or returns NULL if there is no such journal or it
+ * is empty. A record cut short by the previous process being killed
+ * while appending it is ignored.
+ */
+journal_record_t *journal_load(const char *filename, uint64_t *n) {
+    struct stat st;
+    *n = 0;
+    if (stat(filename, &st) || st.st_size < (off_t)sizeof(journal_record_t)) return NULL;
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    uint64_t capacity = st.st_size / sizeof(journal_record_t);
+    journal_record_t *records = (journal_record_t*)safe_malloc(capacity * sizeof(journal_record_t));
+    *n = fread(records, sizeof(journal_record_t), capacity, fp);
+    fclose(fp);
+    if (!*n) {
+        free(records);
+        return NULL;
+    }
+    return records;
+}
+
+/* Opens the journal in FILENAME for appending, creating it if it does
+   not exist. A record cut short at its end is dropped. Returns false on
+   failure. */
+bool journal_open(journal_t *journal, const char *filename) {
+    journal->fp = fopen(filename, "ab");
+    if (!journal->fp) return false;
+    fseek(journal->fp, 0, SEEK_END);
+    long size = ftell(journal->fp);
+    journal->nRecords = size / sizeof(journal_record_t);
+    if (size % sizeof(journal_record_t)) {
+        fflush(journal->fp);
+        if (ftruncate(fileno(journal->fp), journal->nRecords * sizeof(journal_record_t))) {
+            fclose(journal->fp);
+            journal->fp = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+void journal_append(journal_t *journal, int type, const char *tier, int worker, uint64_t mem, bool spilled) {
+    journal_record_t record;
+    memset(&record, 0, sizeof(record));
+    strncpy(record.tier, tier, TIER_STR_LENGTH_MAX - 1);
+    record.type = (uint8_t)type;
+    record.spilled = spilled;
+    record.worker = worker;
+    record.mem = mem;
+    if (!journal->fp || fwrite(&record, sizeof(record), 1, journal->fp) != 1) {
+        printf("journal_append: failed to record an event of tier %s\n", tier);
+        return;
+    }
+    fflush(journal->fp);
+    ++journal->nRecords;
+}
+
+void journal_close(journal_t *journal) {
+    if (journal->fp) fclose(journal->fp);
+    journal->fp = NULL;
+}
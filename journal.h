@@ -0,0 +1,37 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "tier.h"
+
+enum journal_record_type {
+    JOURNAL_DISPATCHED = 0, // The tier was sent to WORKER.
+    JOURNAL_SOLVED,         // The tier was solved by WORKER.
+    JOURNAL_FAILED,         // The tier failed to solve on WORKER with MEM bytes.
+    JOURNAL_LOST            // WORKER stopped responding while solving the tier.
+};
+
+/* Fixed-size record of an event in the scheduling of a tier. */
+typedef struct JournalRecord {
+    char tier[TIER_STR_LENGTH_MAX];
+    uint8_t type;
+    uint8_t spilled;        // JOURNAL_FAILED: true if the tier failed in spill mode.
+    int32_t worker;
+    uint64_t mem;           // JOURNAL_FAILED: memory budget the tier failed with.
+} journal_record_t;
+
+/* Append-only log of scheduling events. Every record is handed to the
+   operating system as soon as it is appended, so that a journal survives
+   its process being killed and holds every event up to that point. */
+typedef struct Journal {
+    FILE *fp;
+    uint64_t nRecords;
+} journal_t;
+
+journal_record_t *journal_load(const char *filename, uint64_t *n);
+bool journal_open(journal_t *journal, const char *filename);
+void journal_append(journal_t *journal, int type, const char *tier, int worker, uint64_t mem, bool spilled);
+void journal_close(journal_t *journal);
+
+#endif // JOURNAL_H
@@ -1,14 +1,42 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "solver.h"
+#include "tiersolver.h"
+
+#define CHECKPOINT_INTERVAL 3600.0 // Seconds between checkpoints.
+
+/* Asks the solver to checkpoint and stop. A second signal of the same
+   kind terminates the process right away. */
+static void handle_stop_signal(int sig) {
+    signal(sig, SIG_DFL);
+    tiersolver_request_stop();
+}
 
 int main(int argc, char **argv) {
-    // if (argc != 3) {
-    //     printf("Usage: %s <tier-to-solve> <memory-in-GiB>.\n", argv[0]);
-    //     return 1;
-    // }
+    if (argc == 4 && !strcmp(argv[1], "--bench-manager")) {
+        /* Usage: --bench-manager <n-pieces> <n-workers>. */
+        solve_benchmark_manager(atoi(argv[2]), atoi(argv[3]));
+        return 0;
+    }
+    if (argc == 3 || argc == 4) {
+        /* Usage: <tier-to-solve> <memory-in-GiB> [checkpoint-dir]. */
+        if (argc == 4) {
+            /* SLURM sends SIGUSR1 ahead of the time limit if the job is
+               submitted with --signal, and SIGTERM when it is cancelled. */
+            tiersolver_set_checkpoint(argv[3], CHECKPOINT_INTERVAL);
+            signal(SIGUSR1, handle_stop_signal);
+            signal(SIGTERM, handle_stop_signal);
+        }
+        return !solve_local_single_tier(argv[1], (uint64_t)atoi(argv[2]) << 30);
+    }
+    if (argc == 5 && !strcmp(argv[1], "--simulate")) {
+        /* Usage: --simulate <n-pieces> <n-workers> <n-threads-per-worker>. */
+        solve_simulate_schedule(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+        return 0;
+    }
 
-    // solve_local_single_tier(argv[1], (uint64_t)atoi(argv[2]) << 30);
     // solve_local_remaining_pieces(4, 24, 2ULL << 30, false);
     solve_local_from_file("../test", 2ULL << 30);
     return 0;
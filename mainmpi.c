@@ -3,12 +3,18 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void init_multi(char **argv, int processID) {
-    uint64_t mem = (uint64_t)atoi(argv[3]) << 30;
+/* Each worker registers its own memory with the manager, so nodes of a
+   heterogeneous cluster may be given different amounts. A fractional
+   amount is allowed, and 0 gives a worker most of its node's memory.
+   With --one-sided, workers update the tier tree themselves. */
+void init_multi(int argc, char **argv, int processID) {
+    uint64_t mem = (uint64_t)(atof(argv[3]) * (1ULL << 30));
+    solve_mpi_set_one_sided(argc == 5);
     if (processID == 0) {
         /* Manager node. */
-        solve_mpi_manager(atoi(argv[1]), atoi(argv[2]), mem);
+        solve_mpi_manager(atoi(argv[1]), atoi(argv[2]));
     } else {
         /* Worker node. */
         solve_mpi_worker(mem, false);
@@ -25,10 +31,22 @@ void init_single(char **argv) {
     solve_local_remaining_pieces(nPiecesMax, nthread, mem, false);
 }
 
+/* Solves the given tier with all ranks together. Each rank is given the
+   same amount of memory. */
+void init_tier(char **argv, int processID, int clusterSize) {
+    uint64_t mem = ((uint64_t)atoi(argv[2])) << 30;
+    if (processID == 0) {
+        printf("main: solving tier %s on %d node(s) with "
+               "%zd bytes of memory each.\n", argv[1], clusterSize, mem);
+    }
+    solve_mpi_single_tier(argv[1], mem);
+}
+
 int main(int argc, char **argv) {
-    if (argc != 4) {
-		printf("Usage: %s <n-pieces> <n-threads> <memory-in-GiB>\n",
-               argv[0]);
+    if ((argc != 3 && argc != 4 && argc != 5) || (argc == 5 && strcmp(argv[4], "--one-sided"))) {
+		printf("Usage: %s <n-pieces> <n-threads> <memory-in-GiB> [--one-sided]\n"
+               "       %s <tier-to-solve> <memory-in-GiB>\n",
+               argv[0], argv[0]);
 		return 1;
     }
 
@@ -49,10 +67,12 @@ int main(int argc, char **argv) {
         printf("main: (fatal) clusterSize is less than 1.\n");
 		MPI_Finalize();
 		return 1;
+    } else if (argc == 3) {
+        init_tier(argv, processID, clusterSize);
     } else if (clusterSize == 1) {
         init_single(argv);
 	} else {
-        init_multi(argv, processID);
+        init_multi(argc, argv, processID);
     }
 
     /* Terminates MPI execution environment. */
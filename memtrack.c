@@ -0,0 +1,114 @@
+#include "memtrack.h"
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+static memtrack_t nodeMem;
+
+/* Subtracts BYTES from MT and its ancestors up to but excluding END. */
+static void account_sub_until(memtrack_t *mt, uint64_t bytes, const memtrack_t *end) {
+    for (; mt != end; mt = mt->parent) {
+        __atomic_sub_fetch(&mt->live, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+static void account_sub(memtrack_t *mt, uint64_t bytes) {
+    account_sub_until(mt, bytes, NULL);
+}
+
+/* Adds BYTES to MT and its ancestors. If ENFORCE is true and any of them
+   would exceed its budget, nothing is added and false is returned. */
+static bool account_add(memtrack_t *mt, uint64_t bytes, bool enforce) {
+    for (memtrack_t *a = mt; a; a = a->parent) {
+        uint64_t live = __atomic_add_fetch(&a->live, bytes, __ATOMIC_RELAXED);
+        uint64_t limit = __atomic_load_n(&a->limit, __ATOMIC_RELAXED);
+        if (enforce && limit && live > limit) {
+            account_sub_until(mt, bytes, a->parent);
+            __atomic_add_fetch(&mt->nDenied, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    }
+    for (memtrack_t *a = mt; a; a = a->parent) {
+        uint64_t live = __atomic_load_n(&a->live, __ATOMIC_RELAXED);
+        uint64_t peak = __atomic_load_n(&a->peak, __ATOMIC_RELAXED);
+        while (live > peak && !__atomic_compare_exchange_n(
+                &a->peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    return true;
+}
+
+void memtrack_init(memtrack_t *mt, memtrack_t *parent) {
+    mt->live = mt->peak = mt->limit = mt->nDenied = 0;
+    mt->parent = parent;
+}
+
+void memtrack_set_limit(memtrack_t *mt, uint64_t limit) {
+    __atomic_store_n(&mt->limit, limit, __ATOMIC_RELAXED);
+}
+
+memtrack_t *memtrack_node(void) {
+    return &nodeMem;
+}
+
+/* Allocation sizes are taken from malloc_usable_size, so no header is
+   needed and tracked blocks are ordinary heap blocks. Large blocks are
+   mapped but not touched by malloc, so a block that turns out to exceed
+   the budget is released before it takes any physical memory. */
+void *memtrack_malloc(memtrack_t *mt, size_t size) {
+    void *ret = malloc(size);
+    if (ret && mt && !account_add(mt, malloc_usable_size(ret), true)) {
+        free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+void *memtrack_calloc(memtrack_t *mt, size_t n, size_t size) {
+    void *ret = calloc(n, size);
+    if (ret && mt && !account_add(mt, malloc_usable_size(ret), true)) {
+        free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+/* Growth is checked against the budget before reallocating, as a block
+   that has been moved can not be given back. The difference between the
+   requested and the usable size is settled afterwards. */
+void *memtrack_realloc(memtrack_t *mt, void *ptr, size_t size) {
+    uint64_t oldSize = ptr ? malloc_usable_size(ptr) : 0;
+    uint64_t reserved = (mt && size > oldSize) ? size - oldSize : 0;
+    if (reserved && !account_add(mt, reserved, true)) return NULL;
+    void *ret = realloc(ptr, size);
+    if (!mt) return ret;
+    if (!ret && size) { // Old block is untouched on failure.
+        account_sub(mt, reserved);
+        return NULL;
+    }
+    uint64_t newSize = ret ? malloc_usable_size(ret) : 0;
+    if (newSize > oldSize + reserved) account_add(mt, newSize - oldSize - reserved, false);
+    else account_sub(mt, oldSize + reserved - newSize);
+    return ret;
+}
+
+void memtrack_free(memtrack_t *mt, void *ptr) {
+    if (ptr && mt) account_sub(mt, malloc_usable_size(ptr));
+    free(ptr);
+}
+
+uint64_t memtrack_live(const memtrack_t *mt) {
+    return __atomic_load_n(&mt->live, __ATOMIC_RELAXED);
+}
+
+uint64_t memtrack_peak(const memtrack_t *mt) {
+    return __atomic_load_n(&mt->peak, __ATOMIC_RELAXED);
+}
+
+uint64_t memtrack_denied(const memtrack_t *mt) {
+    return __atomic_load_n(&mt->nDenied, __ATOMIC_RELAXED);
+}
+
+uint64_t memtrack_reset_peak(memtrack_t *mt) {
+    uint64_t live = __atomic_load_n(&mt->live, __ATOMIC_RELAXED);
+    return __atomic_exchange_n(&mt->peak, live, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,52 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* Memory account. Counts the bytes currently allocated through it and the
+   highest count seen since its peak was last reset. Every allocation is
+   also counted towards the account's parent, if any, so that a single node
+   account sees the total of all accounts below it. An account may have a
+   budget, in which case allocations that would take it or any of its
+   ancestors beyond their budget fail as if the system were out of memory.
+   All counters are updated atomically and accounts may be shared between
+   threads. */
+typedef struct MemTrack {
+    uint64_t live;
+    uint64_t peak;
+    uint64_t limit;               // Budget in bytes, 0 if unlimited.
+    uint64_t nDenied;             // Number of allocations through this account denied by a budget.
+    struct MemTrack *parent;
+} memtrack_t;
+
+/* Initializes account MT with zero counters and no budget under PARENT,
+   which may be NULL. Most accounts should be created under memtrack_node(). */
+void memtrack_init(memtrack_t *mt, memtrack_t *parent);
+
+/* Sets the budget of MT to LIMIT bytes, or removes it if LIMIT is 0.
+   Memory already allocated is not affected. */
+void memtrack_set_limit(memtrack_t *mt, uint64_t limit);
+
+/* Returns the account of the whole process. */
+memtrack_t *memtrack_node(void);
+
+/* Drop-in replacements of malloc, calloc, realloc and free that count
+   allocated bytes towards MT and its ancestors. Memory allocated through
+   one account must be reallocated and freed through the same account.
+   If MT is NULL, these functions fall back to the untracked versions.
+   Like their counterparts, they return NULL if the allocation fails,
+   which includes exceeding a budget. */
+void *memtrack_malloc(memtrack_t *mt, size_t size);
+void *memtrack_calloc(memtrack_t *mt, size_t n, size_t size);
+void *memtrack_realloc(memtrack_t *mt, void *ptr, size_t size);
+void memtrack_free(memtrack_t *mt, void *ptr);
+
+uint64_t memtrack_live(const memtrack_t *mt);
+uint64_t memtrack_peak(const memtrack_t *mt);
+uint64_t memtrack_denied(const memtrack_t *mt);
+
+/* Returns the peak of MT since the last reset and resets it to the number
+   of bytes currently allocated. */
+uint64_t memtrack_reset_peak(memtrack_t *mt);
+
+#endif // MEMTRACK_H
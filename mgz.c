@@ -1,5 +1,7 @@
 #include "mgz.h"
+#include "memtrack.h"
 #include <assert.h>
+#include <limits.h>
 #include <malloc.h>
 #include <omp.h>
 #include <stdlib.h>
@@ -27,11 +29,11 @@ static uInt load_input(uint8_t *inBuf, const void *in,
 }
 
 static uInt copy_output(void **out, uint64_t outOffset, uint64_t *outCapacity,
-                        uint8_t *outBuf, uInt have) {
+                        uint8_t *outBuf, uInt have, memtrack_t *mem) {
     if (outOffset + have > *outCapacity) {
         /* Not enough space, reallocate output array. */
         do (*outCapacity) *= 2; while (outOffset + have > *outCapacity);
-        void *newOut = realloc(*out, *outCapacity);
+        void *newOut = memtrack_realloc(mem, *out, *outCapacity);
         if (!newOut) return ILLEGAL_CHUNK_SIZE;
         *out = newOut;
     }
@@ -40,11 +42,11 @@ static uInt copy_output(void **out, uint64_t outOffset, uint64_t *outCapacity,
 }
 
 static uint64_t copy_block(void **out, uint64_t outOffset, uint64_t *outCapacity,
-                           uint8_t *outPart, uint64_t outPartSize) {
+                           uint8_t *outPart, uint64_t outPartSize, memtrack_t *mem) {
     if (outOffset + outPartSize > *outCapacity) {
         /* Not enough space, reallocate output array. */
         do (*outCapacity) *= 2; while (outOffset + outPartSize > *outCapacity);
-        void *newOut = realloc(*out, *outCapacity);
+        void *newOut = memtrack_realloc(mem, *out, *outCapacity);
         if (!newOut) return ILLEGAL_BLOCK_SIZE;
         *out = newOut;
     }
@@ -52,16 +54,18 @@ static uint64_t copy_block(void **out, uint64_t outOffset, uint64_t *outCapacity
     return outPartSize;
 }
 
-uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level) {
+/* Same as mgz_deflate, but *OUT is allocated through account MEM. */
+static uint64_t deflate_tracked(void **out, const void *in, uint64_t inSize, int level,
+                                memtrack_t *mem) {
     int zRet, flush;
     uint64_t inOffset = 0, outOffset = 0, outCapacity = DEFAULT_OUT_CAPACITY;
     z_stream strm;
-    uint8_t *inBuf = (uint8_t*)malloc(CHUNK_SIZE);
-    uint8_t *outBuf = (uint8_t*)malloc(CHUNK_SIZE);
-    *out = malloc(outCapacity);
+    uint8_t *inBuf = (uint8_t*)memtrack_malloc(mem, CHUNK_SIZE);
+    uint8_t *outBuf = (uint8_t*)memtrack_malloc(mem, CHUNK_SIZE);
+    *out = memtrack_malloc(mem, outCapacity);
     if (!inBuf || !outBuf || !(*out)) {
         printf("mgz_deflate: malloc failed.\n");
-        free(*out); *out = NULL;
+        memtrack_free(mem, *out); *out = NULL;
         goto _bailout;
     }
 
@@ -72,7 +76,7 @@ uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level) {
     zRet = deflateInit2(&strm, level, Z_DEFLATED,
                         15 + 16, 8, Z_DEFAULT_STRATEGY); // +16 for gzip header.
     if (zRet != Z_OK) {
-        free(*out); *out = NULL;
+        memtrack_free(mem, *out); *out = NULL;
         goto _bailout;
     }
 
@@ -94,11 +98,11 @@ uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level) {
                 exit(1);
             }
             uInt have = CHUNK_SIZE - strm.avail_out;
-            uInt copied = copy_output(out, outOffset, &outCapacity, outBuf, have);
+            uInt copied = copy_output(out, outOffset, &outCapacity, outBuf, have, mem);
             if (copied == ILLEGAL_CHUNK_SIZE) {
                 printf("mgz_deflate: output realloc failed.\n");
                 (void)deflateEnd(&strm);
-                free(*out); *out = NULL;
+                memtrack_free(mem, *out); *out = NULL;
                 outOffset = 0;
                 goto _bailout;
             }
@@ -111,11 +115,15 @@ uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level) {
     (void)deflateEnd(&strm);
 
 _bailout:
-    free(inBuf);
-    free(outBuf);
+    memtrack_free(mem, inBuf);
+    memtrack_free(mem, outBuf);
     return outOffset;
 }
 
+uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level) {
+    return deflate_tracked(out, in, inSize, level, NULL);
+}
+
 static uint64_t get_correct_block_size(uint64_t blockSize) {
     if (blockSize == 0) return DEFAULT_BLOCK_SIZE;
     if (blockSize < MIN_BLOCK_SIZE) {
@@ -127,29 +135,31 @@ static uint64_t get_correct_block_size(uint64_t blockSize) {
 }
 
 mgz_res_t mgz_parallel_deflate(const void *in, uint64_t inSize, int level,
-                               uint64_t blockSize, bool outBlockSizesNeeded) {
+                               uint64_t blockSize, bool outBlockSizesNeeded,
+                               memtrack_t *mem) {
     mgz_res_t ret = {0};
     blockSize = get_correct_block_size(blockSize);
     uint64_t nBlocks = (inSize + blockSize - 1) / blockSize; // Round up division.
     uint64_t outOffset = 0, outCapacity = DEFAULT_OUT_CAPACITY;
-    void *out = malloc(outCapacity);
+    void *out = memtrack_malloc(mem, outCapacity);
 
     /* Allocate space for the output of each block. */
-    void **outBlocks = (void**)calloc(nBlocks, sizeof(void*));
-    uint64_t *outBlockSizes = (uint64_t*)malloc(nBlocks * sizeof(uint64_t));
+    void **outBlocks = (void**)memtrack_calloc(mem, nBlocks, sizeof(void*));
+    uint64_t *outBlockSizes = (uint64_t*)memtrack_malloc(mem, nBlocks * sizeof(uint64_t));
     if (!out || !outBlocks || !outBlockSizes) {
         printf("mgz_parallel_deflate: malloc failed.\n");
         goto _bailout;
     }
 
-    /* Compress each block. */
+    /* Compress each block. Compression time varies with the contents
+       of a block, so blocks are handed out one at a time. */
     bool oom = false;
-    #pragma omp parallel for
+    #pragma omp parallel for schedule(dynamic)
     for (uint64_t i = 0; i < nBlocks; ++i) {
         uint64_t thisBlockSize = (i == nBlocks - 1) ?
                                  inSize - i * blockSize : blockSize;
-        outBlockSizes[i] = mgz_deflate(&outBlocks[i], (void*)((uint8_t*)in + i * blockSize),
-                                       thisBlockSize, level);
+        outBlockSizes[i] = deflate_tracked(&outBlocks[i], (void*)((uint8_t*)in + i * blockSize),
+                                           thisBlockSize, level, mem);
         if (outBlockSizes[i] == 0) oom = true;
     }
     if (oom) goto _bailout;
@@ -157,14 +167,14 @@ mgz_res_t mgz_parallel_deflate(const void *in, uint64_t inSize, int level,
     /* Concatenate blocks to form the final output. */
     for (uint64_t i = 0; i < nBlocks; ++i) {
         uint64_t copied = copy_block(&out, outOffset, &outCapacity,
-                                     outBlocks[i], outBlockSizes[i]);
+                                     outBlocks[i], outBlockSizes[i], mem);
         if (copied == ILLEGAL_BLOCK_SIZE) {
             printf("mgz_parallel_deflate: copy_block realloc failed.\n");
             goto _bailout;
         }
         assert(copied == outBlockSizes[i]);
         outOffset += copied;
-        free(outBlocks[i]); outBlocks[i] = NULL;
+        memtrack_free(mem, outBlocks[i]); outBlocks[i] = NULL;
     }
 
     /* Reach here only if compression was successful. Setup return value. */
@@ -177,9 +187,51 @@ mgz_res_t mgz_parallel_deflate(const void *in, uint64_t inSize, int level,
     ret.nOutBlocks = nBlocks;
 
 _bailout:
-    free(out);
-    if (outBlocks) for (uint64_t i = 0; i < nBlocks; ++i) free(outBlocks[i]);
-    free(outBlocks);
-    free(outBlockSizes);
+    memtrack_free(mem, out);
+    if (outBlocks) for (uint64_t i = 0; i < nBlocks; ++i) memtrack_free(mem, outBlocks[i]);
+    memtrack_free(mem, outBlocks);
+    memtrack_free(mem, outBlockSizes);
     return ret;
 }
+
+uint64_t mgz_inflate(void *out, uint64_t outSize, const void *in, uint64_t inSize) {
+    int zRet = Z_OK;
+    uint64_t inOffset = 0, outOffset = 0;
+    z_stream strm;
+
+    /* Allocate inflate state. */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) return 0; // +16 for gzip header.
+
+    /* Inflate until the end of IN. zlib counts bytes in uInt, so feed
+       at most UINT_MAX bytes of input and output at a time. */
+    while (inOffset < inSize || strm.avail_in) {
+        if (!strm.avail_in) {
+            uint64_t remIn = inSize - inOffset;
+            strm.avail_in = remIn < UINT_MAX ? (uInt)remIn : UINT_MAX;
+            strm.next_in = (Bytef*)((uint8_t*)in + inOffset);
+            inOffset += strm.avail_in;
+        }
+        uint64_t remOut = outSize - outOffset;
+        if (!remOut) break; // Output is full but input remains.
+        strm.avail_out = remOut < UINT_MAX ? (uInt)remOut : UINT_MAX;
+        strm.next_out = (Bytef*)((uint8_t*)out + outOffset);
+        uInt availOut = strm.avail_out;
+
+        zRet = inflate(&strm, Z_NO_FLUSH);
+        outOffset += availOut - strm.avail_out;
+        if (zRet == Z_STREAM_END) {
+            /* End of one gzip member. Start over for the next one, if any. */
+            if (inflateReset(&strm) != Z_OK) break;
+        } else if (zRet != Z_OK) {
+            break;
+        }
+    }
+    bool complete = (zRet == Z_STREAM_END && inOffset == inSize && !strm.avail_in);
+    (void)inflateEnd(&strm);
+    return complete ? outOffset : 0;
+}
@@ -2,6 +2,7 @@
 #define MGZ_H
 #include <stdbool.h>
 #include <stdint.h>
+#include "memtrack.h"
 
 typedef struct {
     void *out;
@@ -38,12 +39,30 @@ uint64_t mgz_deflate(void **out, const void *in, uint64_t inSize, int level);
 
    Return value contains all zeros if an error occurs during compression.
 
+   All memory is allocated through account MEM, which may be NULL. The
+   output stream and block sizes must be freed using memtrack_free with
+   the same account.
+
    Example usage:
-    mgz_res_t res = mgz_parallel_deflate(in, inSize, level, blockSize);
-    fwrite(out, 1, outSize, outfile);
-    free(out);
+    mgz_res_t res = mgz_parallel_deflate(in, inSize, level, blockSize, false, NULL);
+    fwrite(res.out, 1, res.size, outfile);
+    free(res.out);
 */
 mgz_res_t mgz_parallel_deflate(const void *in, uint64_t inSize, int level,
-                               uint64_t blockSize, bool outBlockSizesNeeded);
+                               uint64_t blockSize, bool outBlockSizesNeeded,
+                               memtrack_t *mem);
+
+/* Decompresses INSIZE bytes of gzip data from IN into OUT, which is
+   assumed to have space for OUTSIZE bytes. IN may contain multiple
+   concatenated gzip members, such as the output of mgz_parallel_deflate.
+
+   Returns the number of bytes written to OUT. Returns 0 if an error
+   occurs or if IN inflates to more than OUTSIZE bytes.
+
+   Example usage:
+    uint64_t outSize = mgz_inflate(out, outCapacity, in, inSize);
+    if (outSize != expectedSize) handle_error();
+*/
+uint64_t mgz_inflate(void *out, uint64_t outSize, const void *in, uint64_t inSize);
 
 #endif // MGZ_H
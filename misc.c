@@ -21,3 +21,40 @@ void *safe_malloc(size_t n) {
     }
     return ret;
 }
+
+/* Sets LOCK and returns the number of nanoseconds spent waiting for it,
+   which is 0 if the lock was free. */
+uint64_t set_lock_timed(omp_lock_t *lock) {
+    if (omp_test_lock(lock)) return 0;
+    double start = omp_get_wtime();
+    omp_set_lock(lock);
+    return (uint64_t)((omp_get_wtime() - start) * 1e9);
+}
+
+/* Ends a worksharing loop with a barrier, for loops declared nowait. The
+   calling thread started the loop at time START. Adds the time spent in
+   the loop to BUSY and the time waiting at the barrier to IDLE. */
+void load_barrier(double start, double *busy, double *idle) {
+    double end = omp_get_wtime();
+    #pragma omp barrier
+    *busy += end - start;
+    *idle += omp_get_wtime() - end;
+}
+
+/* Adds the total BUSY and IDLE time of one thread to LOAD. Thread-safe. */
+void thread_load_add(thread_load_t *load, double busy, double idle) {
+    #pragma omp critical(thread_load)
+    {
+        ++load->nThreads;
+        load->busySum += busy;
+        if (busy > load->busyMax) load->busyMax = busy;
+        load->idleSum += idle;
+    }
+}
+
+/* Returns the ratio of the busy time of the busiest thread to the mean
+   busy time in LOAD, which is 1.0 if the work was perfectly balanced. */
+double thread_load_imbalance(const thread_load_t *load) {
+    if (!load->nThreads || load->busySum <= 0.0) return 1.0;
+    return load->busyMax * load->nThreads / load->busySum;
+}
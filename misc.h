@@ -3,8 +3,25 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <malloc.h>
+#include <omp.h>
 
 void *safe_calloc(size_t n, size_t size);
 void *safe_malloc(size_t);
 
+uint64_t set_lock_timed(omp_lock_t *lock);
+
+/* Busy and idle time of the threads of a team in worksharing loops. Busy
+   time is spent running loop iterations and idle time waiting at the
+   barriers that end the loops for threads that are still busy. */
+typedef struct ThreadLoad {
+    int nThreads;
+    double busySum;
+    double busyMax;
+    double idleSum;
+} thread_load_t;
+
+void load_barrier(double start, double *busy, double *idle);
+void thread_load_add(thread_load_t *load, double busy, double idle);
+double thread_load_imbalance(const thread_load_t *load);
+
 #endif // MISC_H
@@ -0,0 +1,23 @@
+#!/bin/bash
+# Solves TIER distributed across 1 to 8 MPI ranks on this machine and
+# prints the wall time of each run. All child tiers of TIER must have been
+# solved already. The tier file is removed before each run so that every
+# run solves it from scratch, and each run also reports the slowest rank's
+# time of every solver step and the fraction of parents exchanged between
+# ranks. Extra mpirun options may be passed in MPIRUN_FLAGS. That the
+# distributed tier file matches the one of a local solve is checked by
+# tiersolvermpi_test_solve_tier.
+# Usage: ./run-dist-tier-scaling.sh [tier] [memory-in-GiB-per-rank] [threads-per-rank]
+TIER=${1:-000000101011__}
+MEM=${2:-8}
+export OMP_NUM_THREADS=${3:-1}
+REM=${TIER:0:12}
+
+cd bin
+for N in 1 2 3 4 5 6 7 8; do
+    rm -f ../data/$REM/$TIER.gz ../data/$REM/$TIER.lookup ../data/$REM/$TIER.stat
+    echo "=== $N rank(s) ==="
+    START=$(date +%s.%N)
+    mpirun $MPIRUN_FLAGS --oversubscribe -np $N ./solve $TIER $MEM
+    awk -v n=$N -v s=$START -v e=$(date +%s.%N) 'BEGIN { printf "%d rank(s): %.1f seconds\n", n, e - s }'
+done
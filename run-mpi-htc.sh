@@ -10,5 +10,8 @@
 cd bin
 module load gcc openmpi
 export OMP_NUM_THREADS=$SLURM_CPUS_PER_TASK
+# Pinned as in run-mpi.sh, so each tier's pages stay near the threads that first touch them.
+export OMP_PLACES=cores
+export OMP_PROC_BIND=spread,close
 # Usage: ./solve <n-pieces> <n-threads> <memory-in-GiB>
 mpirun ./solve 4 40 380
@@ -10,5 +10,13 @@
 cd bin
 module load gcc openmpi
 export OMP_NUM_THREADS=$SLURM_CPUS_PER_TASK
+# One thread per core: batched tiers spread over the node, each tier's threads packed together.
+export OMP_PLACES=cores
+export OMP_PROC_BIND=spread,close
 # Usage: ./solve <n-pieces> <n-threads> <memory-in-GiB>
+# Workers on the same node share one child tier cache in /dev/shm, so the
+# node may also be split into several smaller workers, e.g. with
+# --ntasks-per-node=4 --cpus-per-task=10 and ./solve 255 10 22. A job
+# killed before its workers exit leaves /dev/shm/xiangqi-tier-cache-*
+# behind, which may be removed once no job is running.
 mpirun ./solve 255 40 90
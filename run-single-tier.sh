@@ -6,8 +6,22 @@
 #SBATCH --ntasks-per-node=1
 #SBATCH --cpus-per-task=40
 #SBATCH --time=48:00:00
+#SBATCH --signal=B:USR1@1800
 
 cd bin
 export OMP_NUM_THREADS=$SLURM_CPUS_PER_TASK
-# Usage: ./solve <tier-to-solve> <memory-in-GiB>
-/usr/bin/time ./solve 000000101011__ 380
+# One thread per core, so that pages first touched by a thread stay on its NUMA node.
+export OMP_PLACES=cores
+export OMP_PROC_BIND=spread,close
+CHECKPOINT_DIR=/global/scratch/users/$USER/checkpoints
+mkdir -p $CHECKPOINT_DIR
+# Usage: ./solve <tier-to-solve> <memory-in-GiB> [checkpoint-dir]
+# Resubmitting this script resumes from the last checkpoint. The solver
+# writes a final checkpoint and exits when it receives SIGUSR1, which is
+# forwarded from the batch shell 30 minutes before the time limit.
+/usr/bin/time ./solve 000000101011__ 380 $CHECKPOINT_DIR &
+SOLVER_PID=$!
+# $SOLVER_PID is /usr/bin/time, so signal its child.
+trap 'pkill -USR1 -P $SOLVER_PID' USR1
+wait $SOLVER_PID
+wait $SOLVER_PID
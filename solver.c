@@ -1,11 +1,28 @@
 #include "common.h"
 #include "misc.h"
 #include "solver.h"
+#include "tierqueue.h"
 #include "tiersolver.h"
 #include "tiertree.h"
+#include <omp.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* Tiers with at least this many positions are solved alone using all
+   threads. Smaller tiers are packed into batches and solved concurrently. */
+#define LARGE_TIER_SIZE (1ULL << 22)
+
+/* A batch of solvable tiers that are solved concurrently. */
+typedef struct TierBatch {
+    int size;
+    tier_tree_entry_t **entries;  // Solvable tier entries, owned by the batch.
+    uint64_t *tierSizes;          // Number of positions in each tier.
+    uint64_t *requiredMems;       // Memory needed by each tier, see tiersolver_required_mem.
+    int *nThreads;                // Number of threads assigned to each tier.
+    tier_solver_stat_t *stats;    // Solver statistics of each tier.
+} tier_batch_t;
+
 static tier_solver_stat_t globalStat;
 static int solvedTiers = 0;
 static int skippedTiers = 0;
@@ -18,19 +35,6 @@ static void initialize_solver(void) {
     make_triangle();
 }
 
-static tier_tree_entry_t *get_tail(TierTreeEntryList *list) {
-    if (!list) {
-        nSolvableTiers = 0;
-        return NULL;
-    }
-    nSolvableTiers = 1;
-    while (list->next) {
-        list = list->next;
-        ++nSolvableTiers;
-    }
-    return list;
-}
-
 static void print_stat(tier_solver_stat_t stat) {
     printf("total legal positions: %"PRIu64"\n", stat.numLegalPos);
     printf("number of winning positions: %"PRIu64"\n", stat.numWin);
@@ -57,35 +61,21 @@ static void update_global_stat(tier_solver_stat_t stat) {
     }
 }
 
-static void update_tier_tree(const char *solvedTier,
-                             tier_tree_entry_t **solvableTiersTail) {
-    tier_tree_entry_t *tmp;
-    TierList *parentTiers = tier_get_parent_tier_list(solvedTier);
-    TierList *canonicalParents = NULL;
-    for (struct TierListElem *walker = parentTiers; walker; walker = walker->next) {
-        /* Update canonical parent's number of unsolved children only. */
-        struct TierListElem *canonical = tier_get_canonical_tier(walker->tier);
-        if (tier_list_contains(canonicalParents, canonical->tier)) {
-            /* It is possible that a child has two parents that are symmetrical
-               to each other. In this case, we should only decrement the child
-               counter once. */
-            free(canonical);
-            continue;
-        }
-        canonical->next = canonicalParents;
-        canonicalParents = canonical;
-
-        tmp = tier_tree_find(canonical->tier);
-        if (tmp && --tmp->numUnsolvedChildren == 0) {
-            tmp = tier_tree_remove(canonical->tier);
-            (*solvableTiersTail)->next = tmp;
-            tmp->next = NULL;
-            *solvableTiersTail = tmp;
-            ++nSolvableTiers;
-        }
-    }
-    tier_list_destroy(canonicalParents);
-    tier_list_destroy(parentTiers);
+/* Marks the tier of ENTRY solved and pushes its parents that have become
+   solvable. */
+static void update_tier_tree(const tier_tree_entry_t *entry, tier_queue_t *solvable) {
+    TierTreeEntryList *parents = tier_tree_mark_solved(entry->id);
+    for (TierTreeEntryList *walker = parents; walker; walker = walker->next) ++nSolvableTiers;
+    tier_queue_push_list(solvable, parents);
+}
+
+/* Indexes the parents of all tiers in the tier tree and in SOLVABLELIST
+   and prints how long it took. */
+static void index_tier_tree(TierTreeEntryList *solvableList, const char *functionName) {
+    double start = omp_get_wtime();
+    tier_tree_index_parents(solvableList, omp_get_max_threads());
+    printf("%s: indexed the parents of %"PRId64" tiers in %f seconds\n", functionName,
+           tier_tree_parent_index()->nTiers, omp_get_wtime() - start);
 }
 
 static void print_solver_result(const char *functionName) {
@@ -103,36 +93,162 @@ static void print_solver_result(const char *functionName) {
     printf("\n");
 }
 
-static void solve_tier_tree(TierTreeEntryList *solvable, uint64_t mem,
-                            bool force, const char *functionName) {
-    tier_tree_entry_t *solvableTail = get_tail(solvable);
-    tier_tree_entry_t *tmp;
+static void tier_batch_init(tier_batch_t *batch, int maxSize) {
+    batch->size = 0;
+    batch->entries = (tier_tree_entry_t**)malloc(maxSize * sizeof(tier_tree_entry_t*));
+    batch->tierSizes = (uint64_t*)malloc(maxSize * sizeof(uint64_t));
+    batch->requiredMems = (uint64_t*)malloc(maxSize * sizeof(uint64_t));
+    batch->nThreads = (int*)malloc(maxSize * sizeof(int));
+    batch->stats = (tier_solver_stat_t*)malloc(maxSize * sizeof(tier_solver_stat_t));
+    if (!batch->entries || !batch->tierSizes || !batch->requiredMems ||
+            !batch->nThreads || !batch->stats) {
+        printf("tier_batch_init: OOM\n");
+        exit(1);
+    }
+}
 
-    while (solvable) {
+static void tier_batch_destroy(tier_batch_t *batch) {
+    free(batch->entries); batch->entries = NULL;
+    free(batch->tierSizes); batch->tierSizes = NULL;
+    free(batch->requiredMems); batch->requiredMems = NULL;
+    free(batch->nThreads); batch->nThreads = NULL;
+    free(batch->stats); batch->stats = NULL;
+    batch->size = 0;
+}
+
+/**
+ * @brief Moves canonical tiers from the front of the SOLVABLE queue into
+ * BATCH until either their total required memory would exceed MEM or
+ * there are as many tiers as threads. A large tier is always solved in
+ * a batch of its own. Non-canonical tiers are skipped and freed.
+ */
+static void fill_tier_batch(tier_batch_t *batch, tier_queue_t *solvable,
+                            uint64_t mem, int nThreads) {
+    uint64_t batchMem = 0;
+    tier_tree_entry_t *next;
+
+    batch->size = 0;
+    while ((next = tier_queue_peek(solvable)) && batch->size < nThreads) {
         /* Only solve canonical tiers. */
-        if (tier_is_canonical_tier(solvable->tier)) {
-            tier_solver_stat_t stat = 
-                tiersolver_solve_tier(solvable->tier, mem, force);
+        if (!tier_is_canonical_tier(next->tier)) {
+            ++skippedTiers;
+            free(tier_queue_pop(solvable));
+            --nSolvableTiers;
+            printf("Solvable tiers count: %d\n", nSolvableTiers);
+            continue;
+        }
+        uint64_t size = tier_size(next->tier);
+        uint64_t requiredMem = tiersolver_required_mem(next->tier, mem);
+        bool large = size >= LARGE_TIER_SIZE;
+        /* The first tier is always taken so that the solver can report OOM
+           if it does not fit into memory on its own. */
+        if (batch->size && (large || !requiredMem || batchMem + requiredMem > mem)) break;
+
+        batch->entries[batch->size] = tier_queue_pop(solvable);
+        batch->tierSizes[batch->size] = size;
+        batch->requiredMems[batch->size] = requiredMem;
+        ++batch->size;
+        batchMem += requiredMem;
+        if (large) break;
+    }
+}
+
+/**
+ * @brief Splits NTHREADS threads among the tiers in BATCH in proportion
+ * to tier size. Every tier gets at least one thread.
+ */
+static void assign_batch_threads(tier_batch_t *batch, int nThreads) {
+    uint64_t totalSize = 0;
+    for (int i = 0; i < batch->size; ++i) {
+        totalSize += batch->tierSizes[i];
+    }
+    for (int i = 0; i < batch->size; ++i) {
+        int share = totalSize ?
+            (int)((double)nThreads * batch->tierSizes[i] / totalSize) : 1;
+        batch->nThreads[i] = share < 1 ? 1 : share;
+    }
+}
+
+static void solve_tier_batch(tier_batch_t *batch, uint64_t mem, bool force, int nThreads) {
+    if (batch->size == 1) {
+        batch->stats[0] = tiersolver_solve_tier(batch->entries[0]->tier, mem, force);
+        return;
+    }
+
+    /* Each tier gets its own memory share so that concurrent solvers can
+       not run the node out of memory together. Memory left over is shared
+       among the tiers in proportion to what they need. */
+    uint64_t batchMem = 0;
+    for (int i = 0; i < batch->size; ++i) {
+        batchMem += batch->requiredMems[i];
+    }
+    assign_batch_threads(batch, nThreads);
+    #pragma omp parallel for num_threads(batch->size) schedule(dynamic, 1)
+    for (int i = 0; i < batch->size; ++i) {
+        omp_set_num_threads(batch->nThreads[i]);
+        uint64_t share = batchMem ? (uint64_t)((double)batch->requiredMems[i] * mem / batchMem) :
+                                    mem / batch->size;
+        batch->stats[i] = tiersolver_solve_tier(batch->entries[i]->tier, share, force);
+    }
+
+    /* A tier that outgrew its share is solved again alone with all of MEM. */
+    for (int i = 0; i < batch->size && !tiersolver_stop_requested(); ++i) {
+        if (batch->stats[i].numLegalPos) continue;
+        printf("Retrying tier %s alone with all memory\n", batch->entries[i]->tier);
+        batch->stats[i] = tiersolver_solve_tier(batch->entries[i]->tier, mem, force);
+    }
+}
+
+static void solve_tier_tree(TierTreeEntryList *solvableList, uint64_t mem,
+                            bool force, const char *functionName) {
+    int nThreads = omp_get_max_threads();
+    int maxActiveLevels = omp_get_max_active_levels();
+    tier_batch_t batch;
+    tier_queue_t solvable;
+
+    index_tier_tree(solvableList, functionName);
+    tier_queue_init(&solvable, TIER_QUEUE_CRITICAL_PATH);
+    tier_queue_push_list(&solvable, solvableList);
+    nSolvableTiers = (int)solvable.size;
+
+    /* Allow the tiers of a batch to run their own parallel regions. */
+    tier_batch_init(&batch, nThreads);
+    omp_set_max_active_levels(2);
+    while (tier_queue_peek(&solvable)) {
+        fill_tier_batch(&batch, &solvable, mem, nThreads);
+        if (!batch.size) continue;
+        solve_tier_batch(&batch, mem, force, nThreads);
+
+        /* The tier tree is updated serially once the whole batch is done. */
+        for (int i = 0; i < batch.size; ++i) {
+            tier_tree_entry_t *entry = batch.entries[i];
+            tier_solver_stat_t stat = batch.stats[i];
             if (stat.numLegalPos) {
                 /* Solve succeeded. Update tier tree. */
-                update_tier_tree(solvable->tier, &solvableTail);
+                update_tier_tree(entry, &solvable);
                 update_global_stat(stat);
-                printf("Tier %s:\n", solvable->tier);
+                printf("Tier %s:\n", entry->tier);
                 print_stat(stat);
                 printf("\n");
                 ++solvedTiers;
+            } else if (tiersolver_stop_requested()) {
+                printf("Stopped solving tier %s\n", entry->tier);
+                ++failedTiers;
             } else {
                 printf("Failed to solve tier %s: not enough memory\n",
-                       solvable->tier);
+                       entry->tier);
                 ++failedTiers;
             }
-        } else ++skippedTiers;
-        tmp = solvable;
-        solvable = solvable->next;
-        free(tmp);
-        --nSolvableTiers;
-        printf("Solvable tiers count: %d\n", nSolvableTiers);
+            free(entry);
+            --nSolvableTiers;
+            printf("Solvable tiers count: %d\n", nSolvableTiers);
+        }
+        if (tiersolver_stop_requested()) break;
     }
+    /* Tiers are only left over if solving was stopped. */
+    tier_queue_destroy(&solvable);
+    omp_set_max_active_levels(maxActiveLevels);
+    tier_batch_destroy(&batch);
     print_solver_result(functionName);
 }
 
@@ -161,6 +277,11 @@ bool solve_local_single_tier(const char *tier, uint64_t mem) {
         if (!ret) goto _bailout;
     }
     tier_array_destroy(&childTiers);
+    if (tiersolver_stop_requested()) {
+        printf("Stopped before solving tier %s\n", canonical->tier);
+        ret = false;
+        goto _bailout;
+    }
 
     /* Solve the given tier. */
     tier_solver_stat_t stat = tiersolver_solve_tier(canonical->tier, mem, false);
@@ -170,6 +291,9 @@ bool solve_local_single_tier(const char *tier, uint64_t mem) {
         print_stat(stat);
         printf("\n");
         ret = true;
+    } else if (tiersolver_stop_requested()) {
+        printf("Stopped solving tier %s\n", canonical->tier);
+        ret = false;
     } else {
         printf("Failed to solve tier %s: not enough memory\n", canonical->tier);
         ret = false;
@@ -186,3 +310,143 @@ void solve_local_from_file(const char *filename, uint64_t mem) {
     solve_tier_tree(tier_tree_init_from_file(filename, mem),
                     mem, false, "solve_local_from_file");
 }
+
+/* A simulated worker finishing its tier at TIME. */
+typedef struct SimEvent {
+    double time;
+    int worker;
+} sim_event_t;
+
+static bool sim_event_before(const sim_event_t *a, const sim_event_t *b) {
+    if (a->time != b->time) return a->time < b->time;
+    return a->worker < b->worker;
+}
+
+static void sim_event_push(sim_event_t *heap, int *size, sim_event_t event) {
+    int i = (*size)++;
+    heap[i] = event;
+    while (i && sim_event_before(&heap[i], &heap[(i - 1) / 2])) {
+        sim_event_t tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+static sim_event_t sim_event_pop(sim_event_t *heap, int *size) {
+    sim_event_t ret = heap[0];
+    heap[0] = heap[--(*size)];
+    int i = 0;
+    while (true) {
+        int first = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < *size && sim_event_before(&heap[left], &heap[first])) first = left;
+        if (right < *size && sim_event_before(&heap[right], &heap[first])) first = right;
+        if (first == i) break;
+        sim_event_t tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+    return ret;
+}
+
+/* Returns the time at which NWORKERS workers, each solving one tier at a
+   time with NTHREADS threads, finish solving the tier tree whose solvable
+   tiers are in SOLVABLELIST if solvable tiers are taken in the order of
+   POLICY, and sets *NCOMPLETED to the number of tiers solved. Each tier
+   takes as long as estimated by tier_queue_cost. Solved tiers are removed
+   from the tier tree as in solve_tier_tree. Finishing workers are kept in
+   a heap so that the replay scales to thousands of workers. */
+static double simulate_schedule(TierTreeEntryList *solvableList, int policy, int nWorkers,
+                                int nThreads, int *nCompleted) {
+    tier_tree_entry_t **running = (tier_tree_entry_t**)safe_calloc(nWorkers, sizeof(tier_tree_entry_t*));
+    sim_event_t *events = (sim_event_t*)safe_malloc(nWorkers * sizeof(sim_event_t));
+    int *idle = (int*)safe_malloc(nWorkers * sizeof(int));
+    int nEvents = 0, nIdle = nWorkers;
+    double now = 0.0;
+    tier_queue_t solvable;
+
+    for (int i = 0; i < nWorkers; ++i) idle[i] = nWorkers - 1 - i;
+    *nCompleted = 0;
+    tier_queue_init(&solvable, policy);
+    tier_queue_push_list(&solvable, solvableList);
+    while (true) {
+        /* Hand out solvable tiers to idle workers. */
+        while (nIdle) {
+            tier_tree_entry_t *next;
+            while ((next = tier_queue_pop(&solvable)) && !tier_is_canonical_tier(next->tier)) free(next);
+            if (!next) break;
+            int w = idle[--nIdle];
+            running[w] = next;
+            sim_event_push(events, &nEvents, (sim_event_t){now + tier_queue_cost(next->tier) / nThreads, w});
+        }
+
+        /* Advance to the first tier to finish. */
+        if (!nEvents) break;
+        sim_event_t first = sim_event_pop(events, &nEvents);
+        now = first.time;
+        update_tier_tree(running[first.worker], &solvable);
+        free(running[first.worker]); running[first.worker] = NULL;
+        idle[nIdle++] = first.worker;
+        ++(*nCompleted);
+    }
+    tier_queue_destroy(&solvable);
+    free(running);
+    free(events);
+    free(idle);
+    return now;
+}
+
+/**
+ * @brief Replays solving all tiers with at most NPIECESMAX pieces on
+ * NWORKERS workers with NTHREADS threads each, once taking solvable tiers
+ * in FIFO order and once by critical path, and prints both makespans.
+ * Nothing is solved. Tiers solved before take as long as recorded in
+ * their telemetry, others as long as estimated from their size.
+ */
+void solve_simulate_schedule(uint8_t nPiecesMax, int nWorkers, int nThreads) {
+    const char *names[] = {"FIFO", "critical path"};
+    const int policies[] = {TIER_QUEUE_FIFO, TIER_QUEUE_CRITICAL_PATH};
+    double makespans[2];
+
+    int nCompleted;
+
+    initialize_solver();
+    for (int i = 0; i < 2; ++i) {
+        TierTreeEntryList *solvableList = tier_tree_init(nPiecesMax, omp_get_max_threads());
+        index_tier_tree(solvableList, "solve_simulate_schedule");
+        makespans[i] = simulate_schedule(solvableList, policies[i], nWorkers, nThreads, &nCompleted);
+        tier_tree_destroy();
+    }
+    printf("solve_simulate_schedule: %d pieces on %d workers with %d threads each:\n",
+           2 + nPiecesMax, nWorkers, nThreads);
+    for (int i = 0; i < 2; ++i) {
+        printf("%s makespan: %f seconds\n", names[i], makespans[i]);
+    }
+    printf("critical path makespan is %.1f%% of FIFO\n",
+           makespans[0] ? 100.0 * makespans[1] / makespans[0] : 100.0);
+}
+
+/**
+ * @brief Measures how many completed tiers per second the bookkeeping of a
+ * scheduler keeps up with when NWORKERS simulated workers solve all tiers
+ * with at most NPIECESMAX pieces: every completion marks a tier solved,
+ * queues the parents it makes solvable, and hands the next tier to the
+ * idle worker. Nothing is solved and no worker is waited for, so the rate
+ * is that of the bookkeeping alone, which bounds how many workers one
+ * scheduler can keep busy.
+ */
+void solve_benchmark_manager(uint8_t nPiecesMax, int nWorkers) {
+    int nCompleted;
+
+    initialize_solver();
+    TierTreeEntryList *solvableList = tier_tree_init(nPiecesMax, omp_get_max_threads());
+    index_tier_tree(solvableList, "solve_benchmark_manager");
+    double start = omp_get_wtime();
+    simulate_schedule(solvableList, TIER_QUEUE_CRITICAL_PATH, nWorkers, 1, &nCompleted);
+    double elapsed = omp_get_wtime() - start;
+    tier_tree_destroy();
+    printf("solve_benchmark_manager: %d pieces on %d simulated workers: %d tiers "
+           "completed in %f seconds, %.0f completions per second\n", 2 + nPiecesMax,
+           nWorkers, nCompleted, elapsed, elapsed > 0.0 ? nCompleted / elapsed : 0.0);
+}
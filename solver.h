@@ -6,5 +6,7 @@
 void solve_local_remaining_pieces(uint8_t nPiecesMax, uint64_t nthread, uint64_t mem, bool force);
 bool solve_local_single_tier(const char *tier, uint64_t mem);
 void solve_local_from_file(const char *filename, uint64_t mem);
+void solve_simulate_schedule(uint8_t nPiecesMax, int nWorkers, int nThreads);
+void solve_benchmark_manager(uint8_t nPiecesMax, int nWorkers);
 
 #endif // SOLVER_H
@@ -1,9 +1,16 @@
 #include "common.h"
+#include "journal.h"
 #include "misc.h"
 #include "solvermpi.h"
+#include "tier.h"
+#include "tiercache.h"
+#include "tierqueue.h"
 #include "tiersolver.h"
+#include "tiersolvermpi.h"
 #include "tiertree.h"
 #include <mpi.h>
+#include <omp.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,27 +20,116 @@
 #define MPI_MANAGER_NODE 0
 #define MPI_MSG_TAG 0
 #define MPI_STAT_TAG 1
-#define MPI_MSG_LEN (TIER_STR_LENGTH_MAX + 1)
+#define MPI_HEARTBEAT_TAG 2
+#define MPI_READY_TAG 3
+#define MPI_POLL_INTERVAL_US 50
+#define MPI_WORKER_POLL_US 1000           // How often a solving worker checks whether it is done.
+#define MPI_HEARTBEAT_INTERVAL 10.0       // Seconds between heartbeats of a solving worker.
+#define MPI_HEARTBEAT_TIMEOUT 120.0       // Seconds of silence after which a solving worker is given up on.
+#define MPI_JOURNAL_FILENAME "../data/solvermpi.journal"
+#define MPI_BATCH_MAX 64                  // Most tiers solved concurrently by one worker.
+#define MPI_LARGE_TIER_SIZE (1ULL << 22)  // Tiers with at least this many positions are solved alone.
+#define MPI_PHYS_MEM_SHARE 0.9            // Largest share of its node's physical memory a worker uses.
+#define MPI_CACHE_SHARE 0.25              // Share of a worker's memory set aside for its child tier cache.
+#define MPI_CACHE_NAME_MAX 64             // Longest name of a node shared child tier cache, including the NUL.
+#define MPI_CACHE_REPORT_MAX 256          // Most cached tiers a worker reports to the manager.
+#define MPI_BCAST_CHUNK (1LL << 26)       // Most elements broadcast by one call.
+#define MPI_FIT_MEMO_MAX 16               // Most distinct worker memory sizes whose fit is remembered per tier.
+
+/* Tiers the manager hands to a worker, which solves them concurrently.
+   An assignment without tiers terminates the worker. */
+typedef struct WorkerAssignment {
+    int32_t nTiers;
+    int32_t modes[MPI_BATCH_MAX];   // Solver mode of each tier, TIERSOLVER_MODE_NONE to let admission control choose.
+    uint64_t mems[MPI_BATCH_MAX];   // Memory budget of each tier in Bytes.
+    int64_t ids[MPI_BATCH_MAX];     // Index of each tier in the parent index.
+    char tiers[MPI_BATCH_MAX][TIER_STR_LENGTH_MAX];
+} worker_assignment_t;
+
+/* Sent by a worker whenever it becomes idle. Carries the capacity of the
+   worker and whether each tier of its previous assignment was solved. */
+typedef struct WorkerReport {
+    uint64_t mem;
+    int32_t nThreads;
+    int32_t nTiers;                 // Number of tiers in the previous assignment, 0 if there was none.
+    uint8_t solved[MPI_BATCH_MAX];
+    int32_t nReady;                 // Number of ready tiers sent right after the report, see shared_mark_solved.
+    int32_t nCached;
+    char cached[MPI_CACHE_REPORT_MAX][TIER_STR_LENGTH_MAX]; // Tiers in the worker's cache, most recently used first.
+} worker_report_t;
+
+/* A worker as seen by the manager. */
+typedef struct WorkerInfo {
+    uint64_t mem;                   // 0 until the worker has sent its first report.
+    int nThreads;
+    worker_assignment_t assignment; // Tiers the worker is solving.
+    tier_tree_entry_t *entries[MPI_BATCH_MAX]; // Entries of the tiers the worker is solving.
+    int nCached;
+    char cached[MPI_CACHE_REPORT_MAX][TIER_STR_LENGTH_MAX]; // Tiers in the worker's cache as of its last report.
+    double lastHeard;               // Time of the last message from the worker.
+    bool dead;                      // True if the worker has been given up on.
+} worker_info_t;
+
+/* A worker's assignment being solved in a thread of its own. */
+typedef struct WorkerJob {
+    const worker_assignment_t *assignment;
+    worker_report_t *report;
+    bool force;
+    int done;
+} worker_job_t;
+
+/* A tier that has failed to solve at least once. */
+typedef struct FailedTier {
+    struct FailedTier *next;
+    char tier[TIER_STR_LENGTH_MAX];
+    uint64_t mem;                   // Largest memory budget the tier has failed with.
+    bool spilled;                   // True if the tier has failed in spill mode.
+} failed_tier_t;
 
 /* Global statistics. Used by the manager node and worker nodes. */
 static tier_solver_stat_t globalStat;
 
 /* The following constants are used only by the manager node. */
-static TierTreeEntryList *solvableTiersHead = NULL;
-static tier_tree_entry_t *solvableTiersTail = NULL;
-static TierTreeEntryList *solvingTiers = NULL;
+static tier_queue_t solvableTiers;
+static int nSolvingTiers = 0;
 static int solvedTiers = 0;
 static int skippedTiers = 0;
 static int failedTiers = 0;
+static int retriedTiers = 0;
+static worker_info_t *workers = NULL;
+static int nRanks = 0;
+static failed_tier_t *failures = NULL;
+static int lostWorkers = 0;
+static int resumedTiers = 0;        // Tiers found solved in the journal of a previous run.
+static journal_t journal;
 struct timeval globalStartTime, globalEndTime;
 struct timeval intervalStart, intervalEnd;
 double msgTime = 0.0;
 
-static tier_tree_entry_t *get_tail(TierTreeEntryList *list) {
-    if (!list) return NULL;
-    while (list->next)  list = list->next;
-    return list;
-}
+/* Idle workers are parked on the manager until a tier becomes solvable.
+   PARKEDWORKERS holds their ranks in the order they became idle, and
+   IDLESINCE[rank] the time at which each of them became idle. */
+static int *parkedWorkers = NULL;
+static int nParkedWorkers = 0;
+static double *idleSince = NULL;
+static int nDispatches = 0;
+static int nLocalDispatches = 0;     // Tiers sent to a worker holding some of their children.
+static tier_cache_stat_t cacheStat; // Child tier reads of all workers.
+static double dispatchLatency = 0.0; // Total time from a worker becoming idle to receiving a tier.
+static double bookkeepingTime = 0.0; // Time the manager spent updating the tier tree.
+static tier_admit_info_t *admitInfos = NULL; // Admission records of indexed tiers by index, see admit_info.
+
+/* With one-sided bookkeeping, the unsolved child counters and solved flags
+   of all indexed tiers are spread across the windows of all ranks, and each
+   worker updates them itself when it solves a tier. The manager only hears
+   which tiers have become solvable. Used by all ranks. */
+static bool oneSided = false;
+static tier_parent_index_t sharedIndex;  // Copy of the manager's parent index.
+static MPI_Win sharedWin;
+static int64_t sharedSlots = 0;          // Counters held by each rank. Solved flags follow them.
+static int sharedRanks = 0;
+static int64_t *readyIds = NULL;         // Tiers found ready by this worker since its last report.
+static int64_t nReadyIds = 0, readyCapacity = 0;
 
 static void print_stat(tier_solver_stat_t stat) {
     printf("total legal positions: %"PRIu64"\n", stat.numLegalPos);
@@ -61,96 +157,24 @@ static void update_global_stat(tier_solver_stat_t stat) {
     }
 }
 
-static void solvable_tiers_append(tier_tree_entry_t *e) {
-    if (!solvableTiersHead) {
-        solvableTiersHead = solvableTiersTail = e;
-    } else {
-        solvableTiersTail->next = e;
-        solvableTiersTail = e;
-    }
-    e->next = NULL;
-}
-
-static void solvable_tiers_remove_head(void) {
-    if (!solvableTiersHead) return;
-    tier_tree_entry_t *toRemove = solvableTiersHead;
-    solvableTiersHead = toRemove->next;
-    free(toRemove);
-    if (!solvableTiersHead) solvableTiersTail = NULL;
-}
-
-/* Update the tier tree and the solvable tier list by removing
-   the SOLVEDTIER from its canonical parent tiers' number of
-   unsolved children. If this number reaches zero, the parent
-   tier is removed from the tier tree and appended to the end
-   of the solvable tier list. */
-static void update_tier_tree(const char *solvedTier) {
-    tier_tree_entry_t *canonicalParentTierTreeEntry;
-    TierList *parentTiers = tier_get_parent_tier_list(solvedTier);
-    TierList *canonicalParents = NULL;
-    for (struct TierListElem *walker = parentTiers; walker; walker = walker->next) {
-        /* Update canonical parent's number of unsolved children only. */
-        struct TierListElem *canonicalParent = tier_get_canonical_tier(walker->tier);
-        if (tier_list_contains(canonicalParents, canonicalParent->tier)) {
-            /* It is possible that a child has two parents that are symmetrical
-               to each other. In this case, we should only decrement the child
-               counter once. */
-            free(canonicalParent);
-            continue;
-        }
-        canonicalParent->next = canonicalParents;
-        canonicalParents = canonicalParent;
-
-        canonicalParentTierTreeEntry = tier_tree_find(canonicalParent->tier);
-        if (canonicalParentTierTreeEntry && --canonicalParentTierTreeEntry->numUnsolvedChildren == 0) {
-            canonicalParentTierTreeEntry = tier_tree_remove(canonicalParent->tier);
-            solvable_tiers_append(canonicalParentTierTreeEntry);
-        }
-    }
-    tier_list_destroy(canonicalParents);
-    tier_list_destroy(parentTiers);
-}
-
-static void remove_tier_from_solving(const char *tier) {
-    if (!solvingTiers) {
-        /* This should never happen. */
-        printf("remove_tier_from_solving: removing from empty list.\n");
-        return;
-    }
-    if (strncmp(tier, solvingTiers->tier, TIER_STR_LENGTH_MAX) == 0) {
-        /* Special case: remove head. */
-        tier_tree_entry_t *toRemove = solvingTiers;
-        solvingTiers = toRemove->next;
-        free(toRemove);
-        return;
-    }
-    tier_tree_entry_t *prev = solvingTiers;
-    tier_tree_entry_t *curr = solvingTiers->next;
-    while (curr && strncmp(curr->tier, tier, TIER_STR_LENGTH_MAX)) {
-        prev = curr;
-        curr = curr->next;
-    }
-    if (!curr) {
-        /* This should never happen. */
-        printf("remove_tier_from_solving: tier to remove is not found"
-            " in the solving tiers list.\n");
-        return;
-    }
-    prev->next = curr->next;
-    free(curr);
+/* Marks the tier of ENTRY solved and pushes its parents that have become
+   solvable into the solvable tier queue. */
+static void update_tier_tree(const tier_tree_entry_t *entry) {
+    double start = MPI_Wtime();
+    tier_queue_push_list(&solvableTiers, tier_tree_mark_solved(entry->id));
+    bookkeepingTime += MPI_Wtime() - start;
 }
 
-static void move_solvable_head_to_solving(void) {
-    if (!solvableTiersHead) {
-        /* This should never happen. */
-        printf("move_solvable_head_to_solving: solvable list is empty.\n");
-        return;
+/* Pushes the tiers in IDS, which workers have found ready with one-sided
+   bookkeeping, into the solvable tier queue. A tier found ready more than
+   once is only pushed the first time. */
+static void push_ready_tiers(const int64_t *ids, int n) {
+    double start = MPI_Wtime();
+    for (int i = 0; i < n; ++i) {
+        tier_tree_entry_t *entry = tier_tree_remove_indexed(ids[i]);
+        if (entry) tier_queue_push(&solvableTiers, entry);
     }
-    tier_tree_entry_t *detached = solvableTiersHead;
-    solvableTiersHead = detached->next;
-    detached->next = solvingTiers;
-    solvingTiers = detached;
-    if (!solvableTiersHead) solvableTiersTail = NULL;
+    bookkeepingTime += MPI_Wtime() - start;
 }
 
 static double get_elapsed_time(struct timeval start, struct timeval end) {
@@ -167,134 +191,1135 @@ static void timed_send(void *buf, int count, MPI_Datatype datatype, int dest, in
     msgTime += get_elapsed_time(intervalStart, intervalEnd);
 }
 
+/* Receives a message without blocking inside MPI, which busy-waits in
+   most implementations. The request is tested every MPI_POLL_INTERVAL_US
+   microseconds, so a waiting process leaves its core to others on the
+   same node and still receives within a fraction of a millisecond. */
+static void wait_recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    MPI_Request request;
+    int done = 0;
+    MPI_Irecv(buf, count, datatype, source, tag, comm, &request);
+    MPI_Test(&request, &done, status);
+    while (!done) {
+        usleep(MPI_POLL_INTERVAL_US);
+        MPI_Test(&request, &done, status);
+    }
+}
+
 static void timed_recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
     gettimeofday(&intervalStart, NULL);
-    MPI_Recv(buf, count, datatype, source, tag, comm, status);
+    wait_recv(buf, count, datatype, source, tag, comm, status);
     gettimeofday(&intervalEnd, NULL);
     msgTime += get_elapsed_time(intervalStart, intervalEnd);
 }
 
-static void manager_solve_all(void) {
+static void park_worker(int worker) {
+    parkedWorkers[nParkedWorkers++] = worker;
+    idleSince[worker] = MPI_Wtime();
+}
+
+/* Removes the I-th parked worker from the parked workers and returns it. */
+static int unpark_worker(int i) {
+    int worker = parkedWorkers[i];
+    memmove(parkedWorkers + i, parkedWorkers + i + 1, (--nParkedWorkers - i) * sizeof(int));
+    return worker;
+}
+
+static failed_tier_t *find_failure(const char *tier) {
+    for (failed_tier_t *walker = failures; walker; walker = walker->next) {
+        if (!strncmp(walker->tier, tier, TIER_STR_LENGTH_MAX)) return walker;
+    }
+    return NULL;
+}
+
+/* Returns the failure record of TIER, creating it if there is none. */
+static failed_tier_t *get_failure(const char *tier) {
+    failed_tier_t *failure = find_failure(tier);
+    if (!failure) {
+        failure = (failed_tier_t*)safe_calloc(1, sizeof(failed_tier_t));
+        memcpy(failure->tier, tier, TIER_STR_LENGTH_MAX);
+        failure->next = failures;
+        failures = failure;
+    }
+    return failure;
+}
+
+/* Returns what admission needs to know of the tier of ENTRY. It is loaded
+   once, after the tier has become solvable and its children are all
+   solved, and kept for the rest of the run, so that weighing the tier
+   against workers again and again reads no files. Tiers that are not
+   indexed use SCRATCH, which must start out zeroed. */
+static tier_admit_info_t *admit_info(const tier_tree_entry_t *entry, tier_admit_info_t *scratch) {
+    tier_admit_info_t *info = (entry->id >= 0 && admitInfos) ? admitInfos + entry->id : scratch;
+    if (!info->loaded) tiersolver_load_admit_info(entry->tier, info);
+    return info;
+}
+
+/**
+ * @brief Decides whether the tier of ENTRY may be solved on WORKER by
+ * NTHREADS threads while AVAILABLE bytes of its memory are unused. Sets
+ * MODE to the solver mode to force,
+ * or TIERSOLVER_MODE_NONE to let admission control choose, and MEM to the
+ * memory the tier needs. A tier that has failed before only goes to a
+ * worker with more memory than it failed with, or, once there is none,
+ * is forced into spill mode on the largest worker. Either way, it gets
+ * the whole worker.
+ */
+static bool fit_tier(const tier_tree_entry_t *entry, int worker, uint64_t available, int nThreads,
+                     int *mode, uint64_t *mem) {
+    const worker_info_t *w = &workers[worker];
+    const failed_tier_t *failure = find_failure(entry->tier);
+    *mode = TIERSOLVER_MODE_NONE;
+    if (!failure) {
+        tier_admit_info_t scratch = {0};
+        *mem = tiersolver_required_mem_with(entry->tier, admit_info(entry, &scratch), available, nThreads);
+        return *mem != 0;
+    }
+    *mem = w->mem;
+    if (available < w->mem) return false;
+    if (w->mem > failure->mem) return true;
+    if (failure->spilled) return false;
+    for (int r = 0; r < nRanks; ++r) {
+        /* A worker that has not registered yet may have more memory. */
+        if (r == MPI_MANAGER_NODE || workers[r].dead) continue;
+        if (!workers[r].mem || workers[r].mem > w->mem) return false;
+    }
+    *mode = TIERSOLVER_MODE_SPILL;
+    return true;
+}
+
+/* Results of fit_tier for one tier on workers with up to MPI_FIT_MEMO_MAX
+   distinct sizes. Whether a tier that has not failed fits depends only on
+   the memory and threads of the worker, so it is decided once per size
+   rather than once per worker. */
+typedef struct FitMemo {
+    int n;
+    uint64_t workerMems[MPI_FIT_MEMO_MAX];
+    int workerThreads[MPI_FIT_MEMO_MAX];
+    bool fits[MPI_FIT_MEMO_MAX];
+    int modes[MPI_FIT_MEMO_MAX];
+    uint64_t mems[MPI_FIT_MEMO_MAX];
+} fit_memo_t;
+
+static bool fit_tier_memo(fit_memo_t *memo, const tier_tree_entry_t *entry, int worker, int *mode,
+                          uint64_t *mem) {
+    uint64_t workerMem = workers[worker].mem;
+    int workerThreads = workers[worker].nThreads;
+    for (int i = 0; i < memo->n; ++i) {
+        if (memo->workerMems[i] != workerMem || memo->workerThreads[i] != workerThreads) continue;
+        *mode = memo->modes[i];
+        *mem = memo->mems[i];
+        return memo->fits[i];
+    }
+    bool fits = fit_tier(entry, worker, workerMem, workerThreads, mode, mem);
+    if (memo->n < MPI_FIT_MEMO_MAX && !find_failure(entry->tier)) {
+        memo->workerMems[memo->n] = workerMem;
+        memo->workerThreads[memo->n] = workerThreads;
+        memo->fits[memo->n] = fits;
+        memo->modes[memo->n] = *mode;
+        memo->mems[memo->n++] = *mem;
+    }
+    return fits;
+}
+
+/* Returns true if the tier of ENTRY may be solved on some live worker
+   that has registered or may still register. */
+static bool tier_fits_any_worker(const tier_tree_entry_t *entry) {
+    int mode;
+    uint64_t mem;
+    fit_memo_t memo = {0};
+    for (int r = 0; r < nRanks; ++r) {
+        if (r == MPI_MANAGER_NODE || workers[r].dead) continue;
+        if (!workers[r].mem || fit_tier_memo(&memo, entry, r, &mode, &mem)) return true;
+    }
+    return false;
+}
+
+/* Returns the bytes of values of the canonical CHILDREN of a tier that
+   are in the cache of WORKER. */
+static uint64_t cached_child_bytes(const struct TierArray *children, int worker) {
+    uint64_t bytes = 0;
+    for (uint8_t i = 0; i < children->size; ++i) {
+        for (int j = 0; j < workers[worker].nCached; ++j) {
+            if (!strncmp(children->tiers[i], workers[worker].cached[j], TIER_STR_LENGTH_MAX)) {
+                bytes += tier_size(children->tiers[i]) * sizeof(uint16_t);
+                break;
+            }
+        }
+    }
+    return bytes;
+}
+
+/* Returns the child tiers of TIER, each replaced by the canonical tier it
+   is stored and cached under. */
+static struct TierArray canonical_child_tiers(const char *tier) {
+    struct TierArray children = tier_get_child_tier_array(tier);
+    for (uint8_t i = 0; i < children.size; ++i) {
+        struct TierListElem *canonical = tier_get_canonical_tier(children.tiers[i]);
+        memcpy(children.tiers[i], canonical->tier, TIER_STR_LENGTH_MAX);
+        free(canonical);
+    }
+    return children;
+}
+
+/**
+ * @brief Returns the index among the parked workers of the one that the
+ * tier of ENTRY should go to, or -1 if it fits on none of them. Prefers
+ * the worker whose cache holds the most bytes of the tier's children,
+ * then the one with the least memory, then the one that has been idle
+ * longest.
+ */
+static int best_parked_worker(const tier_tree_entry_t *entry, int *mode, uint64_t *mem) {
+    int best = -1;
+    uint64_t bestCached = 0;
+    fit_memo_t memo = {0};
+    struct TierArray children = canonical_child_tiers(entry->tier);
+    for (int i = 0; i < nParkedWorkers; ++i) {
+        int worker = parkedWorkers[i], m;
+        uint64_t req, cached = workers[worker].nCached ? cached_child_bytes(&children, worker) : 0;
+        if (best >= 0 && (cached < bestCached ||
+            (cached == bestCached && workers[worker].mem >= workers[parkedWorkers[best]].mem))) continue;
+        if (!fit_tier_memo(&memo, entry, worker, &m, &req)) continue;
+        best = i;
+        bestCached = cached;
+        *mode = m;
+        *mem = req;
+    }
+    tier_array_destroy(&children);
+    return best;
+}
+
+/* Returns the threads of NTHREADS that a tier of SIZE positions gets in a
+   batch of tiers of TOTALSIZE positions in all. */
+static int batch_thread_share(int nThreads, uint64_t size, uint64_t totalSize) {
+    int share = totalSize ? (int)((double)nThreads * size / totalSize) : 1;
+    return share < 1 ? 1 : share;
+}
+
+static void add_to_assignment(worker_info_t *w, tier_tree_entry_t *entry, int mode, uint64_t mem) {
+    worker_assignment_t *a = &w->assignment;
+    memcpy(a->tiers[a->nTiers], entry->tier, TIER_STR_LENGTH_MAX);
+    a->modes[a->nTiers] = mode;
+    a->mems[a->nTiers] = mem;
+    a->ids[a->nTiers] = entry->id;
+    w->entries[a->nTiers++] = entry;
+    ++nSolvingTiers;
+}
+
+/**
+ * @brief Sends ENTRY, to be solved in MODE with MEM bytes, to parked
+ * WORKER together with as many of the next solvable tiers as fit into the
+ * rest of its memory, at most one per thread. Tiers that need spill mode,
+ * large tiers and tiers being retried are solved alone. Memory left over
+ * is shared among the tiers in proportion to what they need.
+ */
+static void assign_tiers(int worker, tier_tree_entry_t *entry, int mode, uint64_t mem) {
+    worker_info_t *w = &workers[worker];
+    worker_assignment_t *a = &w->assignment;
+    uint64_t used = mem;
+    bool alone = mode != TIERSOLVER_MODE_NONE || find_failure(entry->tier) ||
+                 tier_size(entry->tier) >= MPI_LARGE_TIER_SIZE || mem >= w->mem;
+
+    a->nTiers = 0;
+    add_to_assignment(w, entry, mode, mem);
+    while (!alone && a->nTiers < w->nThreads && a->nTiers < MPI_BATCH_MAX) {
+        tier_tree_entry_t *next = tier_queue_peek(&solvableTiers);
+        if (!next) break;
+        if (!tier_is_canonical_tier(next->tier)) {
+            ++skippedTiers;
+            free(tier_queue_pop(&solvableTiers));
+            continue;
+        }
+        uint64_t req;
+        tier_admit_info_t scratch = {0};
+        if (find_failure(next->tier) || tier_size(next->tier) >= MPI_LARGE_TIER_SIZE) break;
+        /* Admitted as if it had all threads, which it may get if the rest
+           of the batch turns out small. */
+        int nextMode = tiersolver_admit_with(next->tier, admit_info(next, &scratch), w->mem - used,
+                                             w->nThreads, &req);
+        if (nextMode == TIERSOLVER_MODE_NONE || nextMode == TIERSOLVER_MODE_SPILL) break;
+        add_to_assignment(w, tier_queue_pop(&solvableTiers), TIERSOLVER_MODE_NONE, req);
+        used += req;
+    }
+    if (a->nTiers > 1) {
+        /* Each tier of a batch only needs buffers for its share of threads. */
+        uint64_t sizes[MPI_BATCH_MAX], totalSize = 0;
+        for (int i = 0; i < a->nTiers; ++i) {
+            sizes[i] = tier_size(a->tiers[i]);
+            totalSize += sizes[i];
+        }
+        used = 0;
+        for (int i = 0; i < a->nTiers; ++i) {
+            tier_admit_info_t scratch = {0};
+            int share = batch_thread_share(w->nThreads, sizes[i], totalSize);
+            uint64_t req = tiersolver_required_mem_with(a->tiers[i], admit_info(w->entries[i], &scratch),
+                                                        a->mems[i], share);
+            if (req) a->mems[i] = req;
+            used += a->mems[i];
+        }
+    }
+    for (int i = 0; i < a->nTiers; ++i) {
+        if (w->nCached) {
+            struct TierArray children = canonical_child_tiers(a->tiers[i]);
+            nLocalDispatches += (cached_child_bytes(&children, worker) != 0);
+            tier_array_destroy(&children);
+        }
+        a->mems[i] = (uint64_t)((double)a->mems[i] * w->mem / used);
+        printf("Dispatching %s to process %d%s.\n", a->tiers[i], worker,
+               a->modes[i] == TIERSOLVER_MODE_SPILL ? " out of core" : "");
+        journal_append(&journal, JOURNAL_DISPATCHED, a->tiers[i], worker, a->mems[i], false);
+    }
+    w->lastHeard = MPI_Wtime();
+    timed_send(a, sizeof(*a), MPI_BYTE, worker, MPI_MSG_TAG, MPI_COMM_WORLD);
+    dispatchLatency += MPI_Wtime() - idleSince[worker];
+    ++nDispatches;
+}
+
+/* Hands out solvable tiers to parked workers until either runs out. Each
+   tier goes to the parked worker with the least memory that can hold it.
+   Tiers that only fit on busy workers wait for them. Tiers that fit on
+   no worker at all fail. */
+static void dispatch_to_parked_workers(void) {
+    TierTreeEntryList *deferred = NULL;
+    tier_tree_entry_t **deferredTail = &deferred;
+    tier_tree_entry_t *entry;
+
+    while (nParkedWorkers && (entry = tier_queue_pop(&solvableTiers))) {
+        /* Only solve canonical tiers. */
+        if (!tier_is_canonical_tier(entry->tier)) {
+            ++skippedTiers;
+            free(entry);
+            continue;
+        }
+        int mode;
+        uint64_t mem;
+        int best = best_parked_worker(entry, &mode, &mem);
+        if (best >= 0) {
+            assign_tiers(unpark_worker(best), entry, mode, mem);
+        } else if (tier_fits_any_worker(entry)) {
+            entry->next = NULL;
+            *deferredTail = entry;
+            deferredTail = &entry->next;
+        } else {
+            printf("No live process has enough memory to solve %s.\n", entry->tier);
+            ++failedTiers;
+            free(entry);
+        }
+    }
+    tier_queue_push_list(&solvableTiers, deferred);
+}
+
+/* Records that ENTRY failed to solve on WORKER in MODE with MEM bytes and
+   queues it to be retried if some worker may still solve it. */
+static void retry_failed_tier(tier_tree_entry_t *entry, int worker, int mode, uint64_t mem) {
+    failed_tier_t *failure = get_failure(entry->tier);
+    tier_admit_info_t scratch = {0};
+    uint64_t req;
+    if (mem > failure->mem) failure->mem = mem;
+    if (mode == TIERSOLVER_MODE_SPILL ||
+        (mode == TIERSOLVER_MODE_NONE && tiersolver_admit_with(entry->tier, admit_info(entry, &scratch), mem,
+                                                               workers[worker].nThreads, &req) ==
+                                         TIERSOLVER_MODE_SPILL)) {
+        failure->spilled = true;
+    }
+    journal_append(&journal, JOURNAL_FAILED, entry->tier, worker, mem, failure->spilled);
+    if (tier_fits_any_worker(entry)) {
+        printf("Retrying %s.\n", entry->tier);
+        ++retriedTiers;
+        tier_queue_push(&solvableTiers, entry);
+    } else {
+        ++failedTiers;
+        free(entry);
+    }
+}
+
+/**
+ * @brief Gives up on every solving worker that has not been heard from for
+ * MPI_HEARTBEAT_TIMEOUT seconds. Its node may have died or hung, so its
+ * tiers are queued again and it gets no more tiers unless it reports back.
+ */
+static void give_up_on_silent_workers(void) {
+    double now = MPI_Wtime();
+    bool requeued = false;
+    for (int r = 0; r < nRanks; ++r) {
+        worker_info_t *w = &workers[r];
+        if (w->dead || !w->assignment.nTiers || now - w->lastHeard < MPI_HEARTBEAT_TIMEOUT) continue;
+        printf("Process %d has not been heard from for %f seconds, giving up on it.\n",
+               r, now - w->lastHeard);
+        w->dead = true;
+        ++lostWorkers;
+        for (int i = 0; i < w->assignment.nTiers; ++i) {
+            journal_append(&journal, JOURNAL_LOST, w->assignment.tiers[i], r, 0, false);
+            tier_queue_push(&solvableTiers, w->entries[i]);
+            --nSolvingTiers;
+            requeued = true;
+        }
+        w->assignment.nTiers = 0;
+    }
+    if (requeued) dispatch_to_parked_workers();
+}
+
+/* Waits for the next report of any worker and returns the rank of its
+   sender. Heartbeats received in the meantime are recorded, and workers
+   that have fallen silent are given up on. A worker given up on that
+   reports again is taken back, but the results of its assignment are
+   ignored as its tiers have been queued again. Tiers it found ready with
+   one-sided bookkeeping are not, as no other worker will report them. */
+static int manager_recv_report(worker_report_t *report) {
     MPI_Status status;
-    char buf[MPI_MSG_LEN];
-
-    /* Loop until all solvable tiers are solved. */
-    while (solvableTiersHead || solvingTiers) {
-        timed_recv(buf, MPI_MSG_LEN, MPI_INT8_T, MPI_ANY_SOURCE, MPI_MSG_TAG, MPI_COMM_WORLD, &status);
-        if (strncmp(buf, "check", MPI_MSG_LEN) != 0) {
-            /* Received solver result from a worker node. */
-            if (buf[0] != '!') {
-                /* Solve succeeded, update tier tree and solvable tier list. */
-                printf("Process %d successfully solved %s.\n", status.MPI_SOURCE, buf);
-                update_tier_tree(buf);
-                remove_tier_from_solving(buf);
+    int flag;
+    gettimeofday(&intervalStart, NULL);
+    while (true) {
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (flag && status.MPI_TAG == MPI_MSG_TAG) break;
+        if (flag && status.MPI_TAG == MPI_HEARTBEAT_TAG) {
+            int32_t beat;
+            MPI_Recv(&beat, 1, MPI_INT32_T, status.MPI_SOURCE, MPI_HEARTBEAT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            workers[status.MPI_SOURCE].lastHeard = MPI_Wtime();
+            continue;
+        }
+        give_up_on_silent_workers();
+        usleep(MPI_POLL_INTERVAL_US);
+    }
+    MPI_Recv(report, sizeof(*report), MPI_BYTE, status.MPI_SOURCE, MPI_MSG_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (report->nReady) {
+        int64_t *ids = (int64_t*)safe_malloc(report->nReady * sizeof(int64_t));
+        MPI_Recv(ids, report->nReady, MPI_INT64_T, status.MPI_SOURCE, MPI_READY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        push_ready_tiers(ids, report->nReady);
+        free(ids);
+    }
+    gettimeofday(&intervalEnd, NULL);
+    msgTime += get_elapsed_time(intervalStart, intervalEnd);
+
+    worker_info_t *w = &workers[status.MPI_SOURCE];
+    w->lastHeard = MPI_Wtime();
+    if (w->dead) {
+        printf("Process %d reported back.\n", status.MPI_SOURCE);
+        w->dead = false;
+    }
+    return status.MPI_SOURCE;
+}
+
+static void manager_solve_all(void) {
+    worker_report_t report;
+
+    /* Loop until all solvable tiers are solved. Workers only send a report
+       when they become idle, which is answered as soon as there are tiers
+       for them. */
+    while (tier_queue_peek(&solvableTiers) || nSolvingTiers) {
+        int worker = manager_recv_report(&report);
+        worker_assignment_t *a = &workers[worker].assignment;
+        if (!workers[worker].mem) {
+            printf("Process %d registered with %"PRIu64" bytes of memory and %d threads.\n",
+                   worker, report.mem, report.nThreads);
+            workers[worker].mem = report.mem;
+            workers[worker].nThreads = report.nThreads;
+        }
+        workers[worker].nCached = report.nCached;
+        memcpy(workers[worker].cached, report.cached, report.nCached * TIER_STR_LENGTH_MAX);
+        for (int i = 0; i < a->nTiers; ++i) {
+            tier_tree_entry_t *entry = workers[worker].entries[i];
+            if (report.solved[i]) {
+                /* Solve succeeded. With one-sided bookkeeping, the worker has
+                   updated the tier tree already. */
+                printf("Process %d successfully solved %s.\n", worker, a->tiers[i]);
+                journal_append(&journal, JOURNAL_SOLVED, a->tiers[i], worker, 0, false);
+                if (!oneSided) update_tier_tree(entry);
+                free(entry);
                 ++solvedTiers;
             } else {
                 /* Solve failed due to OOM. */
-                printf("Process %d failed to solve %s.\n", status.MPI_SOURCE, buf);
-                remove_tier_from_solving(buf + 1);
-                ++failedTiers;
+                printf("Process %d failed to solve %s.\n", worker, a->tiers[i]);
+                retry_failed_tier(entry, worker, a->modes[i], a->mems[i]);
             }
         }
+        nSolvingTiers -= a->nTiers;
+        a->nTiers = 0;
         /* The worker node that we received a message from is now idle. */
+        park_worker(worker);
+        dispatch_to_parked_workers();
+    }
+}
 
-        /* Keep popping off non-nanonical tiers from the head of the solvable tier list
-           until we see the first canonical one or the list becomes empty. */
-        while (solvableTiersHead && !tier_is_canonical_tier(solvableTiersHead->tier)) {
-            ++skippedTiers;
-            solvable_tiers_remove_head();
+/* Returns the number of live workers that have not been terminated. */
+static int count_running_workers(const bool *terminated) {
+    int n = 0;
+    for (int r = 0; r < nRanks; ++r) {
+        n += (r != MPI_MANAGER_NODE && !workers[r].dead && !terminated[r]);
+    }
+    return n;
+}
+
+/* Sends WORKER, which is waiting for a reply to its report, the empty
+   assignment and collects its statistics. */
+static void terminate_worker(int worker) {
+    worker_assignment_t terminate = {0};
+    timed_send(&terminate, sizeof(terminate), MPI_BYTE, worker, MPI_MSG_TAG, MPI_COMM_WORLD);
+    tier_solver_stat_t stat;
+    timed_recv(&stat, sizeof(stat), MPI_INT8_T, worker, MPI_STAT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    update_global_stat(stat);
+    tier_cache_stat_t workerCacheStat;
+    timed_recv(&workerCacheStat, sizeof(workerCacheStat), MPI_BYTE, worker, MPI_STAT_TAG, MPI_COMM_WORLD,
+               MPI_STATUS_IGNORE);
+    cacheStat.hits += workerCacheStat.hits;
+    cacheStat.misses += workerCacheStat.misses;
+    cacheStat.evictions += workerCacheStat.evictions;
+    cacheStat.bytesRead += workerCacheStat.bytesRead;
+    cacheStat.bytesSaved += workerCacheStat.bytesSaved;
+}
+
+/**
+ * @brief Terminates all workers. Workers given up on may only have been
+ * slow, and one that reports back after all others are terminated would
+ * wait for a reply forever, so each is waited for until it has been
+ * silent for MPI_HEARTBEAT_TIMEOUT seconds since the wait began. Returns
+ * false if some of them never reported back, in which case the job must
+ * be aborted rather than finalized.
+ */
+static bool manager_terminate_workers(void) {
+    worker_report_t report;
+    bool *terminated = (bool*)safe_calloc(nRanks, sizeof(bool));
+
+    while (count_running_workers(terminated)) {
+        /* Parked workers are already waiting for a reply. All others have
+           not yet checked in for their first tier. */
+        int worker = nParkedWorkers ? unpark_worker(0) : manager_recv_report(&report);
+        terminate_worker(worker);
+        terminated[worker] = true;
+    }
+
+    double start = MPI_Wtime();
+    int nLost = 0;
+    for (int r = 0; r < nRanks; ++r) {
+        if (!workers[r].dead) continue;
+        if (workers[r].lastHeard < start) workers[r].lastHeard = start;
+        ++nLost;
+    }
+    while (nLost) {
+        MPI_Status status;
+        int flag;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (flag && status.MPI_TAG == MPI_MSG_TAG) {
+            /* A late report, whose results are ignored. */
+            int worker = manager_recv_report(&report);
+            terminate_worker(worker);
+            terminated[worker] = true;
+            --nLost;
+        } else if (flag && status.MPI_TAG == MPI_HEARTBEAT_TAG) {
+            int32_t beat;
+            MPI_Recv(&beat, 1, MPI_INT32_T, status.MPI_SOURCE, MPI_HEARTBEAT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            workers[status.MPI_SOURCE].lastHeard = MPI_Wtime();
+        } else {
+            bool waiting = false;
+            for (int r = 0; r < nRanks; ++r) {
+                waiting |= workers[r].dead && MPI_Wtime() - workers[r].lastHeard < MPI_HEARTBEAT_TIMEOUT;
+            }
+            if (!waiting) break;
+            usleep(MPI_POLL_INTERVAL_US);
         }
-        if (solvableTiersHead) {
-            /* A solvable tier is available, dispatch it to the worker node. */
-            printf("Dispatching %s to process %d.\n", solvableTiersHead->tier, status.MPI_SOURCE);
-            memcpy(buf, solvableTiersHead->tier, TIER_STR_LENGTH_MAX);
-            move_solvable_head_to_solving();
+    }
+    for (int r = 0; r < nRanks; ++r) {
+        if (workers[r].dead) printf("Process %d was given up on and never reported back.\n", r);
+    }
+    free(terminated);
+    while (failures) {
+        failed_tier_t *next = failures->next;
+        free(failures);
+        failures = next;
+    }
+    free(parkedWorkers); parkedWorkers = NULL;
+    free(idleSince); idleSince = NULL;
+    free(workers); workers = NULL;
+    free(admitInfos); admitInfos = NULL;
+    return !nLost;
+}
+
+/**
+ * @brief Picks up where a previous run left off using its journal, without
+ * looking at the database. Tiers the journal records as solved are taken
+ * out of the tier tree and the solvable tier queue, and failures are
+ * remembered so that failed tiers go to larger workers right away. Tiers
+ * that were being solved when the previous run ended are solved again.
+ */
+static void resume_from_journal(void) {
+    double start = MPI_Wtime();
+    uint64_t n;
+    journal_record_t *records = journal_load(MPI_JOURNAL_FILENAME, &n);
+    if (!records) return;
+
+    /* A tier may have been solved more than once, for example by a worker
+       that was given up on but finished anyway, and is counted once. */
+    for (uint64_t i = 0; i < n; ++i) {
+        if (records[i].type == JOURNAL_SOLVED) {
+            int64_t id = tier_tree_index_find(records[i].tier);
+            if (id < 0 || tier_tree_index_solved(id)) continue;
+            tier_queue_push_list(&solvableTiers, tier_tree_mark_solved(id));
+            ++resumedTiers;
+        } else if (records[i].type == JOURNAL_FAILED) {
+            failed_tier_t *failure = get_failure(records[i].tier);
+            if (records[i].mem > failure->mem) failure->mem = records[i].mem;
+            failure->spilled |= records[i].spilled;
+        }
+    }
+    free(records);
+
+    /* Solved tiers that were solvable are in the queue now. Solved tiers
+       found solved before all of their children stay in the tier tree. */
+    TierTreeEntryList *unsolved = NULL;
+    tier_tree_entry_t *entry;
+    while ((entry = tier_queue_pop(&solvableTiers))) {
+        if (tier_tree_index_solved(entry->id)) {
+            free(entry);
         } else {
-            /* No solvable tiers available, let the worker node go to sleep. */
-            snprintf(buf, MPI_MSG_LEN, "sleep");
+            entry->next = unsolved;
+            unsolved = entry;
         }
-        timed_send(buf, MPI_MSG_LEN, MPI_INT8_T, status.MPI_SOURCE, MPI_MSG_TAG, MPI_COMM_WORLD);
     }
+    tier_queue_push_list(&solvableTiers, unsolved);
+    printf("solve_mpi_manager: resumed from %s with %d solved tiers in %f seconds.\n",
+           MPI_JOURNAL_FILENAME, resumedTiers, MPI_Wtime() - start);
 }
 
-static void manager_terminate_workers(void) {
-    MPI_Status status;
-    char buf[MPI_MSG_LEN];
-    int clusterSize;
-    int terminated = 0;
+/* Selects one-sided bookkeeping of the tier tree if ENABLED. All ranks
+   must make the same choice before solving. */
+void solve_mpi_set_one_sided(bool enabled) {
+    oneSided = enabled;
+}
+
+/* Broadcasts N elements of TYPE, each SIZE bytes, from the manager in
+   chunks small enough for the int counts of MPI. */
+static void bcast_large(void *buf, int64_t n, MPI_Datatype type, size_t size) {
+    for (int64_t i = 0; i < n; i += MPI_BCAST_CHUNK) {
+        int count = (int)(n - i < MPI_BCAST_CHUNK ? n - i : MPI_BCAST_CHUNK);
+        MPI_Bcast((char*)buf + i * size, count, type, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    }
+}
 
-    MPI_Comm_size(MPI_COMM_WORLD, &clusterSize);
-    while (terminated < (clusterSize - 1)) { // All nodes except the manager node.
-        timed_recv(buf, MPI_MSG_LEN, MPI_INT8_T, MPI_ANY_SOURCE, MPI_MSG_TAG, MPI_COMM_WORLD, &status);
-        sprintf(buf, "terminate");
-        timed_send(buf, MPI_MSG_LEN, MPI_INT8_T, status.MPI_SOURCE, MPI_MSG_TAG, MPI_COMM_WORLD);
-        tier_solver_stat_t stat;
-        timed_recv(&stat, sizeof(stat), MPI_INT8_T, status.MPI_SOURCE, MPI_STAT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        update_global_stat(stat);
-        ++terminated;
+/**
+ * @brief Sets up one-sided bookkeeping of the tier tree. Collective: the
+ * manager calls it once its parent index is built, and every worker before
+ * asking for its first tier. The parent index is copied to every rank,
+ * and the unsolved child counter and solved flag of tier I are kept by
+ * rank I % NRANKS, so that atomics on them are spread evenly across ranks.
+ */
+static void shared_init(void) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &sharedRanks);
+    if (rank == MPI_MANAGER_NODE) sharedIndex = *tier_tree_parent_index();
+    int64_t sizes[2] = {sharedIndex.nTiers, sharedIndex.nTiers ? sharedIndex.offsets[sharedIndex.nTiers] : 0};
+    MPI_Bcast(sizes, 2, MPI_INT64_T, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (rank != MPI_MANAGER_NODE) {
+        sharedIndex.nTiers = sizes[0];
+        sharedIndex.offsets = (int64_t*)safe_calloc(sizes[0] + 1, sizeof(int64_t));
+        sharedIndex.parents = (int64_t*)safe_malloc((sizes[1] ? sizes[1] : 1) * sizeof(int64_t));
     }
+    bcast_large(sharedIndex.offsets, sizes[0] + 1, MPI_INT64_T, sizeof(int64_t));
+    bcast_large(sharedIndex.parents, sizes[1], MPI_INT64_T, sizeof(int64_t));
+
+    int64_t *base, *values = NULL;
+    int *counts = NULL, *displs = NULL;
+    sharedSlots = (sharedIndex.nTiers + sharedRanks - 1) / sharedRanks;
+    MPI_Win_allocate((MPI_Aint)(2 * sharedSlots * sizeof(int64_t)), sizeof(int64_t), MPI_INFO_NULL,
+                     MPI_COMM_WORLD, &base, &sharedWin);
+    if (rank == MPI_MANAGER_NODE) {
+        /* Tiers solved by a previous run are solved already. */
+        values = (int64_t*)safe_calloc(2 * sharedSlots * sharedRanks + 1, sizeof(int64_t));
+        counts = (int*)safe_malloc(sharedRanks * sizeof(int));
+        displs = (int*)safe_malloc(sharedRanks * sizeof(int));
+        for (int r = 0; r < sharedRanks; ++r) {
+            counts[r] = (int)(2 * sharedSlots);
+            displs[r] = (int)(2 * sharedSlots * r);
+        }
+        for (int64_t id = 0; id < sharedIndex.nTiers; ++id) {
+            int64_t *slice = values + 2 * sharedSlots * (id % sharedRanks);
+            tier_tree_entry_t *entry = tier_tree_indexed_entry(id);
+            slice[id / sharedRanks] = entry ? entry->numUnsolvedChildren : 0;
+            slice[sharedSlots + id / sharedRanks] = !entry;
+        }
+    }
+    MPI_Scatterv(values, counts, displs, MPI_INT64_T, base, (int)(2 * sharedSlots), MPI_INT64_T,
+                 MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    free(values);
+    free(counts);
+    free(displs);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, sharedWin);
+    MPI_Win_sync(sharedWin);
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+static void shared_destroy(void) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Win_unlock_all(sharedWin);
+    MPI_Win_free(&sharedWin);
+    if (rank != MPI_MANAGER_NODE) {
+        free(sharedIndex.offsets);
+        free(sharedIndex.parents);
+    }
+    memset(&sharedIndex, 0, sizeof(sharedIndex));
+    free(readyIds); readyIds = NULL;
+    nReadyIds = readyCapacity = 0;
+}
+
+static void append_ready(int64_t id) {
+    if (nReadyIds == readyCapacity) {
+        readyCapacity = readyCapacity ? readyCapacity * 2 : 256;
+        int64_t *grown = (int64_t*)realloc(readyIds, readyCapacity * sizeof(int64_t));
+        if (!grown) {
+            printf("shared_mark_solved: OOM\n");
+            exit(1);
+        }
+        readyIds = grown;
+    }
+    readyIds[nReadyIds++] = id;
+}
+
+/**
+ * @brief Marks tier ID solved in the shared solved flags and decrements
+ * the unsolved child counters of its parents with one-sided atomics. The
+ * parents whose counters drop to 0 are ready and are reported to the
+ * manager with the next report. If ID was marked solved before, by a
+ * worker that was given up on and may never report back, the parents that
+ * are ready already are reported instead. The manager ignores tiers that
+ * it has heard of before.
+ */
+static void shared_mark_solved(int64_t id) {
+    const int64_t one = 1, zero = 0, minusOne = -1;
+    int64_t was, begin = sharedIndex.offsets[id], n = sharedIndex.offsets[id + 1] - begin;
+    MPI_Compare_and_swap(&one, &zero, &was, MPI_INT64_T, (int)(id % sharedRanks),
+                         sharedSlots + id / sharedRanks, sharedWin);
+    MPI_Win_flush((int)(id % sharedRanks), sharedWin);
+
+    int64_t *left = (int64_t*)safe_malloc((n ? n : 1) * sizeof(int64_t));
+    for (int64_t i = 0; i < n; ++i) {
+        int64_t parent = sharedIndex.parents[begin + i];
+        MPI_Fetch_and_op(&minusOne, &left[i], MPI_INT64_T, (int)(parent % sharedRanks),
+                         parent / sharedRanks, was ? MPI_NO_OP : MPI_SUM, sharedWin);
+    }
+    MPI_Win_flush_all(sharedWin);
+    for (int64_t i = 0; i < n; ++i) {
+        if (left[i] == (was ? 0 : 1)) append_ready(sharedIndex.parents[begin + i]);
+    }
+    free(left);
+}
+
+/**
+ * @brief Builds the tier tree of tiers with at most NPIECESMAX pieces with
+ * all ranks. Collective: the manager calls it with its own arguments, and
+ * every worker, whose arguments are ignored, before asking for its first
+ * tier. Each rank scans its part of the sets of remaining pieces with all
+ * of its threads, and the tiers found are gathered into the manager's tier
+ * tree. Returns the solvable tiers on the manager and NULL on workers. A
+ * tree read from a file (NPIECESMAX 255) is built by the manager alone and
+ * keeps every tier regardless of its memory, since which worker, if any,
+ * can hold a tier is only known once workers register.
+ */
+static TierTreeEntryList *build_tier_tree(uint8_t nPiecesMax, uint64_t nthread) {
+    int rank, size, pieces = nPiecesMax;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Bcast(&pieces, 1, MPI_INT, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (pieces == 255) return (rank == MPI_MANAGER_NODE) ? tier_tree_init_from_file("../endgames", 0) : NULL;
+
+    double start = MPI_Wtime(), scanTime, slowestScan;
+    int64_t n;
+    tier_tree_record_t *records = tier_tree_scan_part((uint8_t)pieces, rank, size,
+                                                      rank == MPI_MANAGER_NODE ? nthread : (uint64_t)omp_get_max_threads(), &n);
+    scanTime = MPI_Wtime() - start;
+    MPI_Reduce(&scanTime, &slowestScan, 1, MPI_DOUBLE, MPI_MAX, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+
+    MPI_Datatype recordType;
+    MPI_Type_contiguous(sizeof(tier_tree_record_t), MPI_BYTE, &recordType);
+    MPI_Type_commit(&recordType);
+    int count = (int)n, *counts = NULL, *displs = NULL;
+    int64_t total = 0;
+    tier_tree_record_t *all = NULL;
+    if (rank == MPI_MANAGER_NODE) {
+        counts = (int*)safe_malloc(size * sizeof(int));
+        displs = (int*)safe_malloc(size * sizeof(int));
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (rank == MPI_MANAGER_NODE) {
+        for (int r = 0; r < size; ++r) {
+            displs[r] = (int)total;
+            total += counts[r];
+        }
+        all = (tier_tree_record_t*)safe_malloc((total ? total : 1) * sizeof(tier_tree_record_t));
+    }
+    MPI_Gatherv(records, count, recordType, all, counts, displs, recordType, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    MPI_Type_free(&recordType);
+    free(records);
+    if (rank != MPI_MANAGER_NODE) return NULL;
+
+    double gathered = MPI_Wtime();
+    TierTreeEntryList *solvable = tier_tree_init_from_records((uint8_t)pieces, all, total);
+    printf("solve_mpi_manager: tier tree of %"PRId64" tiers built by %d processes in %f seconds: "
+           "slowest scan %f seconds, gather %f seconds, insertion %f seconds.\n",
+           total, size, MPI_Wtime() - start, slowestScan, gathered - start - slowestScan,
+           MPI_Wtime() - gathered);
+    free(all);
+    free(counts);
+    free(displs);
+    return solvable;
+}
+
+/* Returns the number of the N indexed tiers in part PART of NPARTS, see
+   tier_tree_find_parents_part. */
+static int64_t part_size(int64_t n, int part, int nParts) {
+    return (n > part) ? (n - part + nParts - 1) / nParts : 0;
+}
+
+/**
+ * @brief Indexes the parents of the tiers in the manager's tier tree and
+ * SOLVABLELIST with all ranks. Collective like build_tier_tree. The manager
+ * sends the sorted names of all tiers to every rank, each rank finds the
+ * parents of its part of them with all of its threads, and the manager
+ * gathers the parts into its parent index. Gathers are limited to 2^31
+ * parents by the int displacements of MPI.
+ */
+static void index_tier_tree(TierTreeEntryList *solvableList, uint64_t nthread) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    double start = MPI_Wtime();
+    int64_t n = 0;
+    char *names = NULL;
+    if (rank == MPI_MANAGER_NODE) names = (char*)tier_tree_index_tiers(solvableList, &n);
+    MPI_Bcast(&n, 1, MPI_INT64_T, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (rank != MPI_MANAGER_NODE) names = (char*)safe_malloc((n ? n : 1) * TIER_STR_LENGTH_MAX);
+    bcast_large(names, n * TIER_STR_LENGTH_MAX, MPI_BYTE, 1);
+    double sent = MPI_Wtime();
+
+    int64_t nPart = part_size(n, rank, size), nParents;
+    int32_t *lengths = (int32_t*)safe_malloc((nPart ? nPart : 1) * sizeof(int32_t));
+    int64_t *parents = tier_tree_find_parents_part(names, n, rank, size,
+                                                   rank == MPI_MANAGER_NODE ? nthread : (uint64_t)omp_get_max_threads(),
+                                                   lengths, &nParents);
+    double findTime = MPI_Wtime() - sent, slowestFind;
+    MPI_Reduce(&findTime, &slowestFind, 1, MPI_DOUBLE, MPI_MAX, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (rank != MPI_MANAGER_NODE) free(names);
+
+    int count = (int)nParents, *counts = NULL, *displs = NULL, *lengthCounts = NULL, *lengthDispls = NULL;
+    int32_t *allLengths = NULL;
+    int64_t *allParents = NULL, total = 0;
+    if (rank == MPI_MANAGER_NODE) {
+        counts = (int*)safe_malloc(size * sizeof(int));
+        displs = (int*)safe_malloc(size * sizeof(int));
+        lengthCounts = (int*)safe_malloc(size * sizeof(int));
+        lengthDispls = (int*)safe_malloc(size * sizeof(int));
+        for (int r = 0, k = 0; r < size; ++r) {
+            lengthCounts[r] = (int)part_size(n, r, size);
+            lengthDispls[r] = k;
+            k += lengthCounts[r];
+        }
+        allLengths = (int32_t*)safe_malloc((n ? n : 1) * sizeof(int32_t));
+    }
+    MPI_Gatherv(lengths, (int)nPart, MPI_INT32_T, allLengths, lengthCounts, lengthDispls, MPI_INT32_T,
+                MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (rank == MPI_MANAGER_NODE) {
+        for (int r = 0; r < size; ++r) {
+            displs[r] = (int)total;
+            total += counts[r];
+        }
+        allParents = (int64_t*)safe_malloc((total ? total : 1) * sizeof(int64_t));
+    }
+    MPI_Gatherv(parents, count, MPI_INT64_T, allParents, counts, displs, MPI_INT64_T,
+                MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    free(lengths);
+    free(parents);
+    if (rank == MPI_MANAGER_NODE) {
+        tier_tree_index_set_parents(size, allLengths, allParents);
+        admitInfos = (tier_admit_info_t*)safe_calloc(n ? n : 1, sizeof(tier_admit_info_t));
+        printf("solve_mpi_manager: indexed the parents of %"PRId64" tiers with %d processes in %f seconds: "
+               "names sent in %f seconds, slowest part %f seconds.\n",
+               n, size, MPI_Wtime() - start, sent - start, slowestFind);
+    }
+    free(allLengths);
+    free(allParents);
+    free(counts);
+    free(displs);
+    free(lengthCounts);
+    free(lengthDispls);
+}
+
+/**
+ * @brief Enables the child tier cache of this worker with a budget of
+ * BUDGET bytes. Collective: the manager calls it with no budget once its
+ * parent index is built, and every worker before asking for its first
+ * tier. Workers that share a node pool their budgets into one cache in
+ * node shared memory, created by the lowest of their ranks, so that a
+ * child tier is decompressed once per node and several workers per node
+ * take no more memory for child tiers than one. A worker alone on its
+ * node, or on one where the shared cache cannot be set up, keeps a cache
+ * of its own.
+ */
+static void init_child_cache(uint64_t budget) {
+    int rank, nodeRank, nodeSize;
+    MPI_Comm node;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_split_type(MPI_COMM_WORLD, rank == MPI_MANAGER_NODE ? MPI_UNDEFINED : MPI_COMM_TYPE_SHARED,
+                        rank, MPI_INFO_NULL, &node);
+    if (node == MPI_COMM_NULL) return;
+    MPI_Comm_rank(node, &nodeRank);
+    MPI_Comm_size(node, &nodeSize);
+    if (nodeSize == 1) {
+        MPI_Comm_free(&node);
+        tier_cache_init(budget);
+        return;
+    }
+
+    uint64_t nodeBudget = 0;
+    MPI_Reduce(&budget, &nodeBudget, 1, MPI_UINT64_T, MPI_SUM, 0, node);
+    char name[MPI_CACHE_NAME_MAX];
+    int shared = 0;
+    if (nodeRank == 0) {
+        snprintf(name, sizeof(name), "/xiangqi-tier-cache-%d-%d", (int)getpid(), rank);
+        shared = nodeBudget && tier_cache_init_shared(name, nodeBudget);
+    }
+    MPI_Bcast(name, sizeof(name), MPI_CHAR, 0, node);
+    MPI_Bcast(&shared, 1, MPI_INT, 0, node);
+    if (nodeRank && shared) shared = tier_cache_init_shared(name, 0);
+    if (!shared) tier_cache_init(budget);
+    if (nodeRank == 0) {
+        printf("Process %d %s a child tier cache of %" PRIu64 " bytes with %d processes on its node.\n",
+               rank, shared ? "shares" : "failed to share", nodeBudget, nodeSize);
+    }
+    MPI_Comm_free(&node);
 }
 
 /* Assumes MPI_Init has already been called. */
-void solve_mpi_manager(uint8_t nPiecesMax, uint64_t nthread, uint64_t mem) {
+void solve_mpi_manager(uint8_t nPiecesMax, uint64_t nthread) {
     gettimeofday(&globalStartTime, NULL); // record start time
-    if (nPiecesMax == 255) {
-        make_triangle();
-        solvableTiersHead = tier_tree_init_from_file("../endgames", mem);
-    } else {
-        solvableTiersHead = tier_tree_init(nPiecesMax, nthread);
+    /* Solvable tiers with the longest chain of ancestors are dispatched first. */
+    tier_queue_init(&solvableTiers, TIER_QUEUE_CRITICAL_PATH);
+    /* Tier sizes are needed to estimate the cost and memory of tiers. */
+    make_triangle();
+    TierTreeEntryList *solvableList = build_tier_tree(nPiecesMax, nthread);
+    index_tier_tree(solvableList, nthread);
+    init_child_cache(0);
+    tier_queue_push_list(&solvableTiers, solvableList);
+
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    parkedWorkers = (int*)safe_calloc(nRanks, sizeof(int));
+    idleSince = (double*)safe_calloc(nRanks, sizeof(double));
+    workers = (worker_info_t*)safe_calloc(nRanks, sizeof(worker_info_t));
+    /* A worker that dies should not take the manager down with it. */
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    resume_from_journal();
+    if (!journal_open(&journal, MPI_JOURNAL_FILENAME)) {
+        printf("solve_mpi_manager: failed to open %s, progress will not survive a restart.\n",
+               MPI_JOURNAL_FILENAME);
     }
-    solvableTiersTail = get_tail(solvableTiersHead);
+    if (oneSided) shared_init();
+    gettimeofday(&intervalEnd, NULL);
+    printf("solve_mpi_manager: started dispatching after %f seconds.\n",
+           get_elapsed_time(globalStartTime, intervalEnd));
 
     manager_solve_all();
-    manager_terminate_workers();
+    bool terminated = manager_terminate_workers();
+    journal_close(&journal);
+    /* Freeing the windows waits for all ranks. */
+    if (oneSided && terminated) shared_destroy();
 
     printf("solve_mpi_manager: finished solving all tiers with less than or equal to %d pieces:\n"
         "Number of canonical tiers solved: %d\n"
         "Number of non-canonical tiers skipped: %d\n"
         "Number of tiers failed due to OOM: %d\n"
+        "Number of retries after OOM: %d\n"
+        "Number of tiers solved by a previous run: %d\n"
+        "Number of processes given up on: %d\n"
         "Total tiers scanned: %d\n",
-        2 + nPiecesMax, solvedTiers, skippedTiers, failedTiers, solvedTiers + skippedTiers + failedTiers);
+        2 + nPiecesMax, solvedTiers, skippedTiers, failedTiers, retriedTiers, resumedTiers, lostWorkers,
+        solvedTiers + skippedTiers + failedTiers);
     print_stat(globalStat);
     printf("\n");
 
     gettimeofday(&globalEndTime, NULL); // record end time
     printf("Elapsed time: %f seconds.\n", get_elapsed_time(globalStartTime, globalEndTime));
     printf("Time wasted on messaging: %f seconds.\n", msgTime);
+    printf("Tiers dispatched: %d, average dispatch latency: %f milliseconds.\n",
+        nDispatches, nDispatches ? 1000.0 * dispatchLatency / nDispatches : 0.0);
+    printf("Tier tree bookkeeping (%s): %f seconds, %.1f microseconds per solved tier.\n",
+        oneSided ? "one-sided" : "manager", bookkeepingTime,
+        solvedTiers ? 1e6 * bookkeepingTime / solvedTiers : 0.0);
+    uint64_t childBytes = cacheStat.bytesRead + cacheStat.bytesSaved;
+    printf("Tiers dispatched to a worker caching their children: %d\n"
+           "Child tier cache: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions.\n"
+           "Child tier bytes read from storage: %"PRIu64", saved by the cache: %"PRIu64" (%.1f%%).\n",
+        nLocalDispatches, cacheStat.hits, cacheStat.misses, cacheStat.evictions,
+        cacheStat.bytesRead, cacheStat.bytesSaved, childBytes ? 100.0 * cacheStat.bytesSaved / childBytes : 0.0);
+    if (!terminated) {
+        /* A process left waiting would hang MPI_Finalize. */
+        printf("solve_mpi_manager: aborting as some processes could not be terminated.\n");
+        fflush(stdout);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 }
 
-/* Assumes MPI_Init has already been called. */
+/* Returns the memory a worker may use: MEM capped at a share of the
+   physical memory of its node, or that share if MEM is 0. */
+static uint64_t worker_mem(uint64_t mem) {
+    uint64_t phys = (uint64_t)sysconf(_SC_PHYS_PAGES) * (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t cap = (uint64_t)(phys * MPI_PHYS_MEM_SHARE);
+    return (!mem || mem > cap) ? cap : mem;
+}
+
+/* Solves the tiers of A concurrently and records in REPORT which of them
+   were solved. Threads are split among the tiers in proportion to tier
+   size as in solve_tier_batch. */
+static void worker_solve_assignment(const worker_assignment_t *a, worker_report_t *report, bool force) {
+    tier_solver_stat_t stats[MPI_BATCH_MAX];
+    if (a->nTiers == 1) {
+        tiersolver_set_mode(a->modes[0]);
+        stats[0] = tiersolver_solve_tier(a->tiers[0], a->mems[0], force);
+        tiersolver_set_mode(TIERSOLVER_MODE_NONE);
+    } else {
+        int nThreads = omp_get_max_threads();
+        uint64_t sizes[MPI_BATCH_MAX], totalSize = 0;
+        for (int i = 0; i < a->nTiers; ++i) {
+            sizes[i] = tier_size(a->tiers[i]);
+            totalSize += sizes[i];
+        }
+        #pragma omp parallel for num_threads(a->nTiers) schedule(dynamic, 1)
+        for (int i = 0; i < a->nTiers; ++i) {
+            omp_set_num_threads(batch_thread_share(nThreads, sizes[i], totalSize));
+            stats[i] = tiersolver_solve_tier(a->tiers[i], a->mems[i], force);
+        }
+    }
+    report->nTiers = a->nTiers;
+    for (int i = 0; i < a->nTiers; ++i) {
+        report->solved[i] = (stats[i].numLegalPos != 0);
+        /* Solve succeeded. Update global statistics. */
+        if (report->solved[i]) update_global_stat(stats[i]);
+    }
+}
+
+static void *worker_job_run(void *arg) {
+    worker_job_t *job = (worker_job_t*)arg;
+    /* Allow the tiers of an assignment to run their own parallel regions. */
+    omp_set_max_active_levels(2);
+    worker_solve_assignment(job->assignment, job->report, job->force);
+    __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* Solves assignment A in a thread of its own while this thread, the only
+   one that talks to MPI, sends the manager a heartbeat every
+   MPI_HEARTBEAT_INTERVAL seconds. */
+static void worker_solve_with_heartbeats(const worker_assignment_t *a, worker_report_t *report, bool force) {
+    worker_job_t job = {a, report, force, 0};
+    pthread_t solver;
+    if (pthread_create(&solver, NULL, worker_job_run, &job)) {
+        worker_job_run(&job);
+        return;
+    }
+    double lastBeat = MPI_Wtime();
+    while (!__atomic_load_n(&job.done, __ATOMIC_ACQUIRE)) {
+        usleep(MPI_WORKER_POLL_US);
+        if (oneSided) {
+            /* Lets the MPI library serve atomics of other workers on this
+               rank's counters. */
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+        }
+        if (MPI_Wtime() - lastBeat >= MPI_HEARTBEAT_INTERVAL) {
+            int32_t beat = 0;
+            MPI_Send(&beat, 1, MPI_INT32_T, MPI_MANAGER_NODE, MPI_HEARTBEAT_TAG, MPI_COMM_WORLD);
+            lastBeat = MPI_Wtime();
+        }
+    }
+    pthread_join(solver, NULL);
+}
+
+/* Assumes MPI_Init has already been called. MEM is capped at the
+   physical memory of the node, and 0 stands for all of it. A share of
+   MEM holds recently solved and loaded tiers for reuse as child tiers,
+   pooled with the other workers on the node. */
 void solve_mpi_worker(uint64_t mem, bool force) {
-    char buf[MPI_MSG_LEN] = "check";
-    char tier[TIER_STR_LENGTH_MAX];
+    worker_report_t report = {0};
+    worker_assignment_t assignment;
     make_triangle();
+    mem = worker_mem(mem);
+    report.mem = mem - (uint64_t)(mem * MPI_CACHE_SHARE);
+    report.nThreads = omp_get_max_threads();
+    build_tier_tree(0, 0);
+    index_tier_tree(NULL, 0);
+    init_child_cache((uint64_t)(mem * MPI_CACHE_SHARE));
+    if (oneSided) shared_init();
 
-    /* Spin forever until a "terminate" message is recieved from the manager node. */
+    /* Spin forever until an empty assignment is recieved from the manager node. */
     while (true) {
-        MPI_Send(buf, MPI_MSG_LEN, MPI_INT8_T, MPI_MANAGER_NODE, MPI_MSG_TAG, MPI_COMM_WORLD);
-        MPI_Recv(buf, MPI_MSG_LEN, MPI_INT8_T, MPI_MANAGER_NODE, MPI_MSG_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-        if (strncmp(buf, "sleep", MPI_MSG_LEN) == 0) {
-            /* No work to do. Wait for one second and check again. */
-            sleep(1);
-            snprintf(buf, MPI_MSG_LEN, "check");
-        } else if (strncmp(buf, "terminate", MPI_MSG_LEN) == 0) {
+        /* Report the results of the previous assignment, if any, and wait
+           until the manager has more tiers or terminates this worker. */
+        report.nCached = tier_cache_list(report.cached, MPI_CACHE_REPORT_MAX);
+        report.nReady = (int32_t)nReadyIds;
+        MPI_Send(&report, sizeof(report), MPI_BYTE, MPI_MANAGER_NODE, MPI_MSG_TAG, MPI_COMM_WORLD);
+        if (nReadyIds) MPI_Send(readyIds, (int)nReadyIds, MPI_INT64_T, MPI_MANAGER_NODE, MPI_READY_TAG, MPI_COMM_WORLD);
+        nReadyIds = 0;
+        wait_recv(&assignment, sizeof(assignment), MPI_BYTE, MPI_MANAGER_NODE, MPI_MSG_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        if (!assignment.nTiers) {
             /* Terminate signal recieved from manager node.
                Send statistics and exit loop. */
             MPI_Send(&globalStat, sizeof(globalStat), MPI_INT8_T, MPI_MANAGER_NODE, MPI_STAT_TAG, MPI_COMM_WORLD);
+            tier_cache_stat_t workerCacheStat = tier_cache_get_stat();
+            MPI_Send(&workerCacheStat, sizeof(workerCacheStat), MPI_BYTE, MPI_MANAGER_NODE, MPI_STAT_TAG, MPI_COMM_WORLD);
             break;
+        }
+        worker_solve_with_heartbeats(&assignment, &report, force);
+        for (int i = 0; oneSided && i < assignment.nTiers; ++i) {
+            if (report.solved[i]) shared_mark_solved(assignment.ids[i]);
+        }
+    }
+    tier_cache_destroy();
+    if (oneSided) shared_destroy();
+}
+
+/* Solves TIER and all of its unsolved descendant tiers one tier at a time,
+   each of them distributed across all ranks. Assumes MPI_Init has already
+   been called and that all ranks call this function with the same
+   arguments. */
+bool solve_mpi_single_tier(const char *tier, uint64_t mem) {
+    int processID;
+    MPI_Comm_rank(MPI_COMM_WORLD, &processID);
+    make_triangle();
+    struct TierListElem *canonical = tier_get_canonical_tier(tier);
+    struct TierArray childTiers = {0};
+    bool ret = false;
+
+    /* Return if the tier has been solved already. The manager checks so
+       that all ranks agree even while the file system catches up. */
+    int solved = (processID == MPI_MANAGER_NODE) && (db_check_tier(canonical->tier) == DB_TIER_OK);
+    MPI_Bcast(&solved, 1, MPI_INT, MPI_MANAGER_NODE, MPI_COMM_WORLD);
+    if (solved) {
+        ret = true;
+        goto _bailout;
+    }
+
+    /* Recursively solve all child tiers. */
+    childTiers = tier_get_child_tier_array(canonical->tier); // If OOM, there is a bug.
+    for (uint8_t i = 0; i < childTiers.size; ++i) {
+        ret = solve_mpi_single_tier(childTiers.tiers[i], mem);
+        if (!ret) goto _bailout;
+    }
+
+    /* Solve the given tier. */
+    tier_solver_stat_t stat = tiersolvermpi_solve_tier(canonical->tier, mem);
+    ret = (stat.numLegalPos != 0);
+    if (processID == MPI_MANAGER_NODE) {
+        if (ret) {
+            printf("New tier %s solved:\n", canonical->tier);
+            print_stat(stat);
+            printf("\n");
         } else {
-            /* Assmues the received string contains a valid tier
-               that is now ready to be solved. */
-            memcpy(tier, buf, TIER_STR_LENGTH_MAX);
-            tier_solver_stat_t stat = tiersolver_solve_tier(tier, mem, force);
-            if (stat.numLegalPos) {
-                /* Solve succeeded. Update global statistics. */
-                update_global_stat(stat);
-            } else {
-                /* Solve failed due to OOM. */
-                snprintf(buf, MPI_MSG_LEN, "!%s", tier);
-            }
+            printf("Failed to solve tier %s: not enough memory\n", canonical->tier);
         }
     }
+
+_bailout:
+    tier_array_destroy(&childTiers);
+    free(canonical);
+    return ret;
 }
@@ -3,7 +3,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-void solve_mpi_manager(uint8_t nPiecesMax, uint64_t nthread, uint64_t mem);
+void solve_mpi_set_one_sided(bool enabled);
+void solve_mpi_manager(uint8_t nPiecesMax, uint64_t nthread);
 void solve_mpi_worker(uint64_t mem, bool force);
+bool solve_mpi_single_tier(const char *tier, uint64_t mem);
 
 #endif // SOLVERMPI_H
@@ -0,0 +1,244 @@
+#include "spill.h"
+#include "db.h"
+#include "misc.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define SPILL_KEPT_FILES_MAX 65536 // Most files kept open by all streams together.
+
+/* Initializes STREAM backed by file FILENAME, which must have been
+   allocated with malloc and is freed by spill_stream_destroy. Any
+   existing file of that name is truncated. */
+void spill_stream_init(spill_stream_t *stream, char *filename, uint64_t capacity, memtrack_t *mem) {
+    stream->filename = filename;
+    stream->fd = -1;
+    stream->buffer = NULL;
+    stream->size = 0;
+    stream->capacity = capacity;
+    stream->nRecords = 0;
+    stream->mem = mem;
+    omp_init_lock(&stream->lock);
+    remove(filename);
+}
+
+static uint64_t bytesWritten = 0;  // Bytes written by all streams of the process.
+static uint64_t nKeptFiles = 0;
+static uint64_t keptFilesMax = 0;
+
+/* Returns how many files streams may keep open, which is half of the
+   process's limit on descriptors after raising it as far as allowed, so
+   that the rest of the process is never starved of descriptors. */
+static uint64_t kept_files_max(void) {
+    uint64_t max = __atomic_load_n(&keptFilesMax, __ATOMIC_RELAXED);
+    if (max) return max;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit)) return 1;
+    rlim_t wanted = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > 2 * SPILL_KEPT_FILES_MAX) ?
+                    2 * SPILL_KEPT_FILES_MAX : limit.rlim_max;
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < wanted) {
+        limit.rlim_cur = wanted;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    max = (limit.rlim_cur == RLIM_INFINITY) ? SPILL_KEPT_FILES_MAX : limit.rlim_cur / 2;
+    if (max > SPILL_KEPT_FILES_MAX) max = SPILL_KEPT_FILES_MAX;
+    if (!max) max = 1;
+    __atomic_store_n(&keptFilesMax, max, __ATOMIC_RELAXED);
+    return max;
+}
+
+/* Returns a descriptor of the file of STREAM open for appending and
+   reading, or -1 on failure. The descriptor is kept in STREAM if there
+   are descriptors to spare, and must be closed by the caller otherwise. */
+static int open_file(spill_stream_t *stream) {
+    if (stream->fd >= 0) return stream->fd;
+    int fd = open(stream->filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return -1;
+    if (__atomic_add_fetch(&nKeptFiles, 1, __ATOMIC_RELAXED) <= kept_files_max()) {
+        stream->fd = fd;
+    } else {
+        __atomic_sub_fetch(&nKeptFiles, 1, __ATOMIC_RELAXED);
+    }
+    return fd;
+}
+
+static void close_file(spill_stream_t *stream) {
+    if (stream->fd < 0) return;
+    close(stream->fd);
+    stream->fd = -1;
+    __atomic_sub_fetch(&nKeptFiles, 1, __ATOMIC_RELAXED);
+}
+
+/* Frees STREAM and removes its file. */
+void spill_stream_destroy(spill_stream_t *stream) {
+    if (!stream->filename) return;
+    close_file(stream);
+    remove(stream->filename);
+    free(stream->filename); stream->filename = NULL;
+    memtrack_free(stream->mem, stream->buffer); stream->buffer = NULL;
+    omp_destroy_lock(&stream->lock);
+}
+
+/* Writes out the buffer of STREAM, which must be locked by the caller. */
+static bool write_buffer(spill_stream_t *stream) {
+    if (!stream->size) return true;
+    int fd = open_file(stream);
+    if (fd < 0) return false;
+    const uint8_t *buf = (const uint8_t*)stream->buffer;
+    uint64_t len = stream->size * sizeof(uint64_t);
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) break;
+        buf += n;
+        len -= n;
+    }
+    if (fd != stream->fd && close(fd)) return false;
+    if (len) return false;
+    __atomic_add_fetch(&bytesWritten, stream->size * sizeof(uint64_t), __ATOMIC_RELAXED);
+    stream->nRecords += stream->size;
+    stream->size = 0;
+    return true;
+}
+
+/* Appends N RECORDS to STREAM. Returns false if OOM or on a write error. */
+bool spill_stream_append(spill_stream_t *stream, const uint64_t *records, uint64_t n) {
+    bool success = true;
+    omp_set_lock(&stream->lock);
+    if (!stream->buffer) {
+        stream->buffer = (uint64_t*)memtrack_malloc(stream->mem, stream->capacity * sizeof(uint64_t));
+        success = (stream->buffer != NULL);
+    }
+    while (success && n) {
+        uint64_t count = stream->capacity - stream->size;
+        if (count > n) count = n;
+        memcpy(stream->buffer + stream->size, records, count * sizeof(uint64_t));
+        stream->size += count;
+        records += count;
+        n -= count;
+        if (stream->size == stream->capacity) success = write_buffer(stream);
+    }
+    omp_unset_lock(&stream->lock);
+    return success;
+}
+
+/* Writes out all buffered records of STREAM and frees its buffer. */
+bool spill_stream_flush(spill_stream_t *stream) {
+    omp_set_lock(&stream->lock);
+    bool success = write_buffer(stream);
+    memtrack_free(stream->mem, stream->buffer); stream->buffer = NULL;
+    omp_unset_lock(&stream->lock);
+    return success;
+}
+
+/* Reads up to N records of flushed STREAM starting at record OFFSET into
+   OUT. Returns the number of records read, which is 0 on a read error. */
+uint64_t spill_stream_read(const spill_stream_t *stream, uint64_t offset, uint64_t *out, uint64_t n) {
+    if (offset >= stream->nRecords) return 0;
+    if (n > stream->nRecords - offset) n = stream->nRecords - offset;
+    int fd = (stream->fd >= 0) ? stream->fd : open(stream->filename, O_RDONLY);
+    if (fd < 0) return 0;
+    uint8_t *buf = (uint8_t*)out;
+    uint64_t len = n * sizeof(uint64_t), pos = offset * sizeof(uint64_t);
+    while (len) {
+        ssize_t r = pread(fd, buf, len, (off_t)pos);
+        if (r <= 0) break;
+        buf += r;
+        len -= r;
+        pos += r;
+    }
+    if (fd != stream->fd) close(fd);
+    return len ? 0 : n;
+}
+
+/* Returns the number of bytes written to spill files by the process so far. */
+uint64_t spill_get_bytes_written(void) {
+    return __atomic_load_n(&bytesWritten, __ATOMIC_RELAXED);
+}
+
+/* Drops all records of STREAM and removes its file. */
+void spill_stream_clear(spill_stream_t *stream) {
+    close_file(stream);
+    remove(stream->filename);
+    stream->nRecords = stream->size = 0;
+}
+
+/* Returns false if OOM, in which case FRONTIER may still be passed to
+   spill_frontier_destroy. Files of FRONTIER are named after TIER and NAME. */
+bool spill_frontier_init(spill_fr_t *frontier, const char *tier, const char *name, uint16_t size,
+                         memtrack_t *mem) {
+    frontier->tier = tier;
+    frontier->name = name;
+    frontier->size = size;
+    frontier->levelsEnd = 0;
+    frontier->mem = mem;
+    frontier->levels = (spill_stream_t**)memtrack_calloc(mem, size, sizeof(spill_stream_t*));
+    if (!frontier->levels) return false;
+    omp_init_lock(&frontier->levelsLock);
+    return true;
+}
+
+void spill_frontier_destroy(spill_fr_t *frontier) {
+    if (!frontier->levels) return;
+    for (uint16_t i = 0; i < frontier->levelsEnd; ++i) {
+        spill_frontier_free(frontier, i);
+    }
+    memtrack_free(frontier->mem, frontier->levels); frontier->levels = NULL;
+    omp_destroy_lock(&frontier->levelsLock);
+}
+
+bool spill_frontier_add(spill_fr_t *frontier, uint64_t hash, uint16_t rmt, uint16_t seg) {
+    spill_stream_t *level = __atomic_load_n(&frontier->levels[rmt], __ATOMIC_ACQUIRE);
+    if (!level) {
+        /* First position at this remoteness, create the stream. */
+        omp_set_lock(&frontier->levelsLock);
+        level = frontier->levels[rmt];
+        if (!level) {
+            level = (spill_stream_t*)memtrack_malloc(frontier->mem, sizeof(spill_stream_t));
+            if (level) {
+                char name[32];
+                sprintf(name, "spill.%s.%d", frontier->name, rmt);
+                spill_stream_init(level, db_get_scratch_filename(frontier->tier, name),
+                                  SPILL_LEVEL_BUFFER_RECORDS, frontier->mem);
+                __atomic_store_n(&frontier->levels[rmt], level, __ATOMIC_RELEASE);
+                if (rmt >= frontier->levelsEnd) frontier->levelsEnd = rmt + 1;
+            }
+        }
+        omp_unset_lock(&frontier->levelsLock);
+        if (!level) return false;
+    }
+    uint64_t record = ((uint64_t)seg << SPILL_SEG_SHIFT) | hash;
+    return spill_stream_append(level, &record, 1);
+}
+
+/* Writes out the buffered positions of all levels of FRONTIER. */
+bool spill_frontier_flush(spill_fr_t *frontier) {
+    bool success = true;
+    for (uint16_t i = 0; i < frontier->levelsEnd; ++i) {
+        if (frontier->levels[i]) success &= spill_stream_flush(frontier->levels[i]);
+    }
+    return success;
+}
+
+/* Returns the number of positions in level RMT of FRONTIER, which must
+   have been flushed. */
+uint64_t spill_frontier_size(const spill_fr_t *frontier, uint16_t rmt) {
+    return frontier->levels[rmt] ? frontier->levels[rmt]->nRecords : 0;
+}
+
+uint64_t spill_frontier_read(const spill_fr_t *frontier, uint16_t rmt, uint64_t offset,
+                             uint64_t *records, uint64_t n) {
+    if (!frontier->levels[rmt]) return 0;
+    return spill_stream_read(frontier->levels[rmt], offset, records, n);
+}
+
+/* Removes level RMT of FRONTIER. */
+void spill_frontier_free(spill_fr_t *frontier, uint16_t rmt) {
+    if (!frontier->levels[rmt]) return;
+    spill_stream_destroy(frontier->levels[rmt]);
+    memtrack_free(frontier->mem, frontier->levels[rmt]);
+    frontier->levels[rmt] = NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef SPILL_H
+#define SPILL_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "memtrack.h"
+
+/* An append-only file of 64-bit records. Appended records are collected
+   in a buffer of CAPACITY records, which is allocated on the first append
+   and written out when it is full or when the stream is flushed. The file
+   stays open from its first write until the stream is cleared or
+   destroyed, as long as the process has descriptors to spare, and is
+   opened for each write or read otherwise, so any number of streams may
+   exist at the same time. Appends are thread-safe. */
+typedef struct SpillStream {
+    char *filename;
+    int fd;               // Descriptor of the file if kept open, -1 otherwise.
+    uint64_t *buffer;
+    uint64_t size;        // Number of records in BUFFER.
+    uint64_t capacity;
+    uint64_t nRecords;    // Number of records in the file, excluding BUFFER.
+    omp_lock_t lock;
+    memtrack_t *mem;
+} spill_stream_t;
+
+void spill_stream_init(spill_stream_t *stream, char *filename, uint64_t capacity, memtrack_t *mem);
+void spill_stream_destroy(spill_stream_t *stream);
+
+bool spill_stream_append(spill_stream_t *stream, const uint64_t *records, uint64_t n);
+bool spill_stream_flush(spill_stream_t *stream);
+uint64_t spill_stream_read(const spill_stream_t *stream, uint64_t offset, uint64_t *out, uint64_t n);
+void spill_stream_clear(spill_stream_t *stream);
+uint64_t spill_get_bytes_written(void);
+
+/* Frontier of one outcome kept on disk as one stream per remoteness
+   level, the on-disk counterpart of fr_t. Each record holds the hash of
+   a position and the segment it belongs to. Streams of levels that have
+   never been added to do not exist. All levels at or above LEVELSEND have
+   always been empty. All memory is counted towards account MEM. */
+typedef struct SpillFrontier {
+    const char *tier;
+    const char *name;
+    uint16_t size;
+    uint16_t levelsEnd;
+    spill_stream_t **levels;
+    omp_lock_t levelsLock;
+    memtrack_t *mem;
+} spill_fr_t;
+
+#define SPILL_SEG_SHIFT 48
+#define SPILL_LEVEL_BUFFER_RECORDS 1024 // 8 KiB of buffered records per frontier level.
+
+static inline uint64_t spill_record_hash(uint64_t record) {
+    return record & ((1ULL << SPILL_SEG_SHIFT) - 1);
+}
+
+static inline uint16_t spill_record_seg(uint64_t record) {
+    return (uint16_t)(record >> SPILL_SEG_SHIFT);
+}
+
+bool spill_frontier_init(spill_fr_t *frontier, const char *tier, const char *name, uint16_t size,
+                         memtrack_t *mem);
+void spill_frontier_destroy(spill_fr_t *frontier);
+
+bool spill_frontier_add(spill_fr_t *frontier, uint64_t hash, uint16_t rmt, uint16_t seg);
+bool spill_frontier_flush(spill_fr_t *frontier);
+uint64_t spill_frontier_size(const spill_fr_t *frontier, uint16_t rmt);
+uint64_t spill_frontier_read(const spill_fr_t *frontier, uint16_t rmt, uint64_t offset,
+                             uint64_t *records, uint64_t n);
+void spill_frontier_free(spill_fr_t *frontier, uint16_t rmt);
+
+#endif // SPILL_H
@@ -111,7 +111,7 @@ void db_test_query_forever(void) {
         printf("[rmt(%"PRIu64") in tier %s: %d]\n", hash, tier, db_get_value(tier, hash));
         printf("game_num_child_pos(%"PRIu64"): %d\n", hash, game_num_child_pos(tier, hash, &board));
 
-        pos_array_t parents = game_get_parents(tier, hash, tier, (tier_change_t){INVALID_IDX, 0, INVALID_IDX, 0}, &board);
+        pos_array_t parents = game_get_parents(tier, hash, tier, (tier_change_t){INVALID_IDX, 0, INVALID_IDX, 0}, &board, NULL);
         printf("parent positions in the same tier: ");
         for (int8_t i = 0; i < parents.size; ++i) {
             printf("[%"PRIu64"] ", parents.array[i]);
@@ -1,5 +1,7 @@
 #include "tier_test.h"
 #include "../tiertree.h"
+#include <inttypes.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -27,3 +29,59 @@ void tier_test_sanity(void) {
     tier_scan_driver(8, test_tier_def);
     printf("test_tier::tier_test_sanity: passed.\n");
 }
+
+/* Returns true if all canonical children of TIER are marked solved. */
+static bool children_solved(const char *tier) {
+    struct TierArray children = tier_get_child_tier_array(tier);
+    bool ret = true;
+    for (uint8_t i = 0; i < children.size && ret; ++i) {
+        struct TierListElem *canonical = tier_get_canonical_tier(children.tiers[i]);
+        ret = tier_tree_index_solved(tier_tree_index_find(canonical->tier));
+        free(canonical);
+    }
+    tier_array_destroy(&children);
+    return ret;
+}
+
+/* Solves the tier tree of tiers with at most NPIECESMAX pieces in name
+   only, marking tiers solved in the parent index as they become solvable,
+   and checks that every canonical tier becomes solvable exactly once and
+   only once all of its children are solved. */
+void tier_test_parent_index(uint8_t nPiecesMax) {
+    TierTreeEntryList *solvable = tier_tree_init(nPiecesMax, 1);
+    tier_tree_index_parents(solvable, 1);
+    int64_t nCanonical = 0, nSolved = 0;
+    for (int64_t id = 0; id < tier_tree_parent_index()->nTiers; ++id) {
+        nCanonical += tier_is_canonical_tier(tier_tree_indexed_entry(id)->tier);
+    }
+    while (solvable) {
+        tier_tree_entry_t *entry = solvable;
+        solvable = solvable->next;
+        if (tier_is_canonical_tier(entry->tier)) {
+            if (tier_tree_index_solved(entry->id) || !children_solved(entry->tier)) {
+                printf("test_tier::tier_test_parent_index: [%s] became solvable too early or twice.\n", entry->tier);
+                exit(1);
+            }
+            TierTreeEntryList *parents = tier_tree_mark_solved(entry->id);
+            if (tier_tree_mark_solved(entry->id)) {
+                printf("test_tier::tier_test_parent_index: [%s] was marked solved twice.\n", entry->tier);
+                exit(1);
+            }
+            ++nSolved;
+            while (parents) {
+                tier_tree_entry_t *next = parents->next;
+                parents->next = solvable;
+                solvable = parents;
+                parents = next;
+            }
+        }
+        free(entry);
+    }
+    tier_tree_destroy();
+    if (nSolved != nCanonical) {
+        printf("test_tier::tier_test_parent_index: %"PRId64" of %"PRId64" canonical tiers became solvable.\n",
+               nSolved, nCanonical);
+        exit(1);
+    }
+    printf("test_tier::tier_test_parent_index: passed.\n");
+}
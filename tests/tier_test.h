@@ -1,6 +1,9 @@
 #ifndef TIER_TEST_H
 #define TIER_TEST_H
 
+#include <stdint.h>
+
 void tier_test_sanity(void);
+void tier_test_parent_index(uint8_t nPiecesMax);
 
 #endif // TIER_TEST_H
@@ -1,8 +1,25 @@
 #include "tiersolver_test.h"
 #include "../tiersolver.h"
+#include "../memtrack.h"
+#include "../spill.h"
+#include "../tier.h"
+#include "../tiercache.h"
+#include <fcntl.h>
 #include <inttypes.h>
+#include <linux/perf_event.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
+
+static double get_elapsed_time(struct timeval start, struct timeval end) {
+    double elapsed_time = (end.tv_sec - start.tv_sec) * 1000000.0; // convert seconds to microseconds
+    elapsed_time += (end.tv_usec - start.tv_usec); // add microseconds
+    return elapsed_time / 1000000.0; // convert back to seconds
+}
 
 void tiersolver_test_solve_single_tier(const char *tier) {
     struct timeval start_time, end_time;
@@ -23,4 +40,383 @@ void tiersolver_test_solve_single_tier(const char *tier) {
     printf("longest win for black is %"PRIu64" steps at position %"PRIu64"\n", stat.longestNumStepsToBlackWin, stat.longestPosToBlackWin);
 
     printf("Elapsed time: %f seconds\n", elapsed_time);
+
+    tier_mem_stat_t memStat;
+    if (db_load_mem_stat(tier, &memStat)) {
+        printf("Solver mode %"PRIu64", peak memory %"PRIu64" bytes\n", memStat.mode, memStat.peak);
+        for (int step = 0; step < DB_NUM_SOLVER_STEPS; ++step) {
+            printf("  step %d: %"PRIu64" bytes\n", step, memStat.stepPeaks[step]);
+        }
+    }
+}
+
+/**
+ * @brief Re-solves each of the NTIERS TIERS NRUNS times and reports the
+ * average time and throughput per tier. Meant for batches of small tiers,
+ * where per-tier overhead rather than the number of positions dominates.
+ * Assumes all child tiers of TIERS have already been solved.
+ */
+void tiersolver_test_benchmark_tiers(const char **tiers, int nTiers, int nRuns) {
+    struct timeval start_time, end_time;
+    double total = 0.0;
+    uint64_t totalSize = 0;
+
+    for (int i = 0; i < nTiers; ++i) {
+        uint64_t size = tier_size(tiers[i]);
+        gettimeofday(&start_time, NULL);
+        for (int run = 0; run < nRuns; ++run) {
+            tiersolver_solve_tier(tiers[i], 90ULL << 30, true);
+        }
+        gettimeofday(&end_time, NULL);
+        double elapsed = get_elapsed_time(start_time, end_time) / nRuns;
+        printf("Tier %s: %"PRIu64" positions, %f seconds, %.0f positions/second\n",
+               tiers[i], size, elapsed, size / elapsed);
+        total += elapsed;
+        totalSize += size;
+    }
+    printf("Batch of %d tiers: %"PRIu64" positions, %f seconds per batch, "
+           "%.0f positions/second\n", nTiers, totalSize, total, totalSize / total);
+}
+
+/* Adds the page allocation counters of all NUMA nodes to LOCAL and REMOTE.
+   A page is counted as remote if it was allocated on a node other than
+   that of the allocating thread. */
+static void read_numastat(uint64_t *local, uint64_t *remote) {
+    char path[64], key[32];
+    uint64_t value;
+    *local = *remote = 0;
+    for (int node = 0; ; ++node) {
+        sprintf(path, "/sys/devices/system/node/node%d/numastat", node);
+        FILE *fp = fopen(path, "r");
+        if (!fp) break;
+        while (fscanf(fp, "%31s %"SCNu64, key, &value) == 2) {
+            if (!strcmp(key, "local_node")) *local += value;
+            else if (!strcmp(key, "other_node")) *remote += value;
+        }
+        fclose(fp);
+    }
+}
+
+/**
+ * @brief Re-solves TIER NRUNS times under each placement of the solver
+ * arrays, with and without huge page advice, and reports the average
+ * time per run and the number of pages allocated on local and remote
+ * NUMA nodes. Pin threads with OMP_PROC_BIND and OMP_PLACES to make the
+ * comparison meaningful. Per-step timings of the last run are in the
+ * telemetry record of TIER. Assumes all child tiers of TIER have
+ * already been solved.
+ */
+void tiersolver_test_benchmark_placement(const char *tier, int nRuns) {
+    static const char *names[] = {"first-touch", "interleave", "calloc"};
+    struct timeval start_time, end_time;
+    uint64_t pageSize = sysconf(_SC_PAGESIZE);
+
+    for (int placement = TIERSOLVER_PLACE_FIRST_TOUCH; placement <= TIERSOLVER_PLACE_CALLOC; ++placement) {
+        for (int hugePages = 0; hugePages <= 1; ++hugePages) {
+            uint64_t local0, remote0, local1, remote1;
+            tiersolver_set_placement(placement, hugePages);
+            read_numastat(&local0, &remote0);
+            gettimeofday(&start_time, NULL);
+            for (int run = 0; run < nRuns; ++run) {
+                tiersolver_solve_tier(tier, 90ULL << 30, true);
+            }
+            gettimeofday(&end_time, NULL);
+            read_numastat(&local1, &remote1);
+            printf("Tier %s, %s%s: %f seconds, %"PRIu64" MiB local and %"PRIu64" MiB remote "
+                   "pages allocated per run\n", tier, names[placement], hugePages ? " + huge pages" : "",
+                   get_elapsed_time(start_time, end_time) / nRuns,
+                   (local1 - local0) * pageSize / nRuns >> 20, (remote1 - remote0) * pageSize / nRuns >> 20);
+        }
+    }
+    tiersolver_set_placement(TIERSOLVER_PLACE_FIRST_TOUCH, false);
+}
+
+/* Opens a counter of last-level cache misses of this process and of all
+   threads it creates from now on, or returns -1 if not permitted. */
+static int open_llc_miss_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t read_counter(int fd) {
+    uint64_t count = 0;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+    return count;
+}
+
+/**
+ * @brief Re-solves TIER NRUNS times with direct and with blocked parent
+ * propagation and reports the average time per run, the number of
+ * last-level cache misses per run, and whether both produce the same
+ * values. The throughput of step 4 of the last run is in the telemetry
+ * record of TIER. Must be called before any OpenMP threads
+ * are created, as cache misses are only counted for threads created after
+ * the counter is opened. Assumes all child tiers of TIER have already
+ * been solved.
+ */
+void tiersolver_test_benchmark_propagation(const char *tier, int nRuns) {
+    static const char *names[] = {"direct", "blocked"};
+    struct timeval start_time, end_time;
+    uint64_t size = tier_size(tier);
+    uint16_t *expected = NULL;
+    int fd = open_llc_miss_counter();
+    if (fd < 0) printf("tiersolver_test_benchmark_propagation: LLC miss counter not available\n");
+
+    for (int propagation = TIERSOLVER_PROPAGATE_DIRECT; propagation <= TIERSOLVER_PROPAGATE_BLOCKED; ++propagation) {
+        tiersolver_set_propagation(propagation);
+        uint64_t misses = read_counter(fd);
+        gettimeofday(&start_time, NULL);
+        for (int run = 0; run < nRuns; ++run) {
+            tiersolver_solve_tier(tier, 90ULL << 30, true);
+        }
+        gettimeofday(&end_time, NULL);
+        misses = read_counter(fd) - misses;
+        printf("Tier %s, %s: %f seconds, %"PRIu64" LLC misses per run\n", tier, names[propagation],
+               get_elapsed_time(start_time, end_time) / nRuns, misses / nRuns);
+
+        uint16_t *values = db_load_tier(tier, size);
+        if (!expected) {
+            expected = values;
+            continue;
+        }
+        if (!values || memcmp(expected, values, size * sizeof(uint16_t))) {
+            printf("tiersolver_test_benchmark_propagation: tier %s, %s FAILED\n", tier, names[propagation]);
+        }
+        free(values);
+    }
+    tiersolver_set_propagation(TIERSOLVER_PROPAGATE_DIRECT);
+    free(expected);
+    if (fd >= 0) close(fd);
+}
+
+/**
+ * @brief Re-solves TIER NRUNS times with frontier segments processed in
+ * insertion order and in hash order, and reports the average time per run
+ * and whether both produce the same values. The fraction of unhash steps
+ * saved by each order is in the telemetry record of TIER after each run.
+ * Assumes all child tiers of TIER have already been solved.
+ */
+void tiersolver_test_benchmark_frontier_order(const char *tier, int nRuns) {
+    struct timeval start_time, end_time;
+    uint64_t size = tier_size(tier);
+    uint16_t *expected = NULL;
+
+    for (int sorted = 0; sorted <= 1; ++sorted) {
+        tiersolver_set_sorted_frontier(sorted);
+        gettimeofday(&start_time, NULL);
+        for (int run = 0; run < nRuns; ++run) {
+            tiersolver_solve_tier(tier, 90ULL << 30, true);
+        }
+        gettimeofday(&end_time, NULL);
+        printf("Tier %s, %s frontier: %f seconds\n", tier, sorted ? "sorted" : "unsorted",
+               get_elapsed_time(start_time, end_time) / nRuns);
+
+        uint16_t *values = db_load_tier(tier, size);
+        if (!expected) {
+            expected = values;
+            continue;
+        }
+        if (!values || memcmp(expected, values, size * sizeof(uint16_t))) {
+            printf("tiersolver_test_benchmark_frontier_order: tier %s FAILED\n", tier);
+        }
+        free(values);
+    }
+    tiersolver_set_sorted_frontier(false);
+    free(expected);
+}
+
+/* Removes the tier, lookup and stat files of TIER, so that the next solve
+   of TIER writes them anew instead of finding an intact tier file and
+   keeping it. */
+void tiersolver_test_remove_tier_files(const char *tier) {
+    const char *exts[] = {"gz", "lookup", "stat"};
+    for (int i = 0; i < 3; ++i) {
+        char *filename = db_get_scratch_filename(tier, exts[i]);
+        remove(filename);
+        free(filename);
+    }
+}
+
+/* Solves TIER in memory and returns its values as saved, or NULL if OOM.
+   Sets *STAT to the statistics of the solve. The values and statistics
+   are the reference that the other ways of solving TIER must reproduce. */
+uint16_t *tiersolver_test_solve_reference(const char *tier, tier_solver_stat_t *stat) {
+    *stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    return db_load_tier(tier, tier_size(tier));
+}
+
+/* Returns true if the tier file of TIER holds REFVALUES and STAT matches
+   REFSTAT. Otherwise prints why, prefixed by LABEL, and returns false.
+   The files of TIER must have been removed before the solve under test,
+   or the tier file read here is the reference one. */
+bool tiersolver_test_expect_same_result(const char *tier, const uint16_t *refValues, tier_solver_stat_t refStat,
+                                        tier_solver_stat_t stat, const char *label) {
+    uint64_t size = tier_size(tier);
+    uint16_t *values = db_load_tier(tier, size);
+    bool same = false;
+    if (!refValues || !values) {
+        printf("%s: OOM\n", label);
+    } else if (memcmp(refValues, values, size * sizeof(uint16_t))) {
+        printf("%s: tier %s FAILED: values differ\n", label, tier);
+    } else if (stat.numLegalPos != refStat.numLegalPos || stat.numWin != refStat.numWin ||
+               stat.numLose != refStat.numLose ||
+               stat.longestNumStepsToRedWin != refStat.longestNumStepsToRedWin ||
+               stat.longestNumStepsToBlackWin != refStat.longestNumStepsToBlackWin) {
+        printf("%s: tier %s FAILED: statistics differ\n", label, tier);
+    } else {
+        same = true;
+    }
+    free(values);
+    return same;
+}
+
+/**
+ * @brief Solves TIER once without interruption and once stopped after its
+ * first checkpoint and then resumed from it, saving checkpoints in DIR.
+ * Reports whether both runs produce the same values and statistics.
+ * Assumes all child tiers of TIER have already been solved.
+ */
+void tiersolver_test_checkpoint_resume(const char *tier, const char *dir) {
+    tier_solver_stat_t expectedStat;
+    uint16_t *expected = tiersolver_test_solve_reference(tier, &expectedStat);
+
+    /* Stop at the first remoteness level boundary, then resume. */
+    tiersolver_test_remove_tier_files(tier);
+    tiersolver_set_checkpoint(dir, 0.0);
+    tiersolver_request_stop();
+    tier_solver_stat_t stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    bool stopped = !stat.numLegalPos;
+    tiersolver_set_checkpoint(dir, 0.0);
+    stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    tiersolver_set_checkpoint(NULL, 0.0);
+
+    if (!stopped) {
+        printf("tiersolver_test_checkpoint_resume: tier %s FAILED: it was not stopped\n", tier);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolver_test_checkpoint_resume")) {
+        printf("tiersolver_test_checkpoint_resume: tier %s passed\n", tier);
+    }
+    free(expected);
+}
+
+/* Runs TIER out of memory by budgeting the whole process below what the
+   solver arrays take, then checks that the solver fails cleanly without
+   leaking tracked memory and that the tier solves normally afterwards. */
+void tiersolver_test_memory_budget(const char *tier) {
+    tier_solver_stat_t expectedStat;
+    uint16_t *expected = tiersolver_test_solve_reference(tier, &expectedStat);
+
+    uint64_t liveBefore = memtrack_live(memtrack_node());
+    memtrack_set_limit(memtrack_node(), liveBefore + tier_size(tier));
+    tier_solver_stat_t stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    memtrack_set_limit(memtrack_node(), 0);
+    bool failedCleanly = !stat.numLegalPos && memtrack_live(memtrack_node()) == liveBefore;
+
+    tiersolver_test_remove_tier_files(tier);
+    stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    if (!failedCleanly) {
+        printf("tiersolver_test_memory_budget: tier %s FAILED: OOM was not handled cleanly\n", tier);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolver_test_memory_budget")) {
+        printf("tiersolver_test_memory_budget: tier %s passed\n", tier);
+    }
+    free(expected);
+}
+
+/* Solves TIER in spill mode with the smallest budget that admits it, so
+   that the tier is split into as many partitions as possible, and checks
+   that the tier file and statistics match those of normal mode and that
+   positions were actually spilled to disk. TIER should span several
+   partitions of 2^16 positions, such as 000011000010_3_2. */
+void tiersolver_test_spill(const char *tier) {
+    uint64_t size = tier_size(tier), requiredMem;
+    if (size <= 1ULL << 16) {
+        printf("tiersolver_test_spill: tier %s FAILED: %" PRIu64 " positions fit in one partition\n",
+               tier, size);
+        return;
+    }
+    tier_solver_stat_t expectedStat;
+    uint16_t *expected = tiersolver_test_solve_reference(tier, &expectedStat);
+
+    tiersolver_set_mode(TIERSOLVER_MODE_SPILL);
+    tiersolver_admit(tier, 90ULL << 30, &requiredMem);
+    uint64_t spilledBefore = spill_get_bytes_written();
+    tiersolver_test_remove_tier_files(tier);
+    tier_solver_stat_t stat = tiersolver_solve_tier(tier, requiredMem, true);
+    uint64_t spilled = spill_get_bytes_written() - spilledBefore;
+    tiersolver_set_mode(TIERSOLVER_MODE_NONE);
+    if (!spilled) {
+        printf("tiersolver_test_spill: tier %s FAILED: nothing was spilled\n", tier);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolver_test_spill")) {
+        printf("tiersolver_test_spill: tier %s passed with %" PRIu64 " bytes, %" PRIu64 " bytes spilled\n",
+               tier, requiredMem, spilled);
+    }
+    free(expected);
+}
+
+/* Solves TIER twice with the child tier cache enabled, so that the second
+   solve reads its child tiers from the cache, and checks that the tier
+   file and statistics match those of solving without the cache. */
+void tiersolver_test_child_cache(const char *tier) {
+    tier_solver_stat_t expectedStat;
+    uint16_t *expected = tiersolver_test_solve_reference(tier, &expectedStat);
+
+    tier_cache_init(8ULL << 30);
+    tiersolver_solve_tier(tier, 90ULL << 30, true);
+    tier_cache_stat_t before = tier_cache_get_stat();
+    tiersolver_test_remove_tier_files(tier);
+    tier_solver_stat_t stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    tier_cache_stat_t after = tier_cache_get_stat();
+    tier_cache_destroy();
+    if (after.hits == before.hits) {
+        printf("tiersolver_test_child_cache: tier %s FAILED: no child tier was read from the cache\n", tier);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolver_test_child_cache")) {
+        printf("tiersolver_test_child_cache: tier %s passed with %" PRIu64 " cache hits saving %"
+               PRIu64 " bytes\n", tier, after.hits - before.hits, after.bytesSaved - before.bytesSaved);
+    }
+    free(expected);
+}
+
+/* Like tiersolver_test_child_cache, but with the cache in node shared
+   memory, and also checks that the last process to detach from the cache
+   removes its shared memory objects. */
+void tiersolver_test_shared_child_cache(const char *tier) {
+    tier_solver_stat_t expectedStat;
+    uint16_t *expected = tiersolver_test_solve_reference(tier, &expectedStat);
+    char name[64];
+    snprintf(name, sizeof(name), "/xiangqi-test-cache-%d", (int)getpid());
+
+    if (!tier_cache_init_shared(name, 8ULL << 30)) {
+        printf("tiersolver_test_shared_child_cache: failed to create %s\n", name);
+        free(expected);
+        return;
+    }
+    tiersolver_solve_tier(tier, 90ULL << 30, true);
+    tier_cache_stat_t before = tier_cache_get_stat();
+    tiersolver_test_remove_tier_files(tier);
+    tier_solver_stat_t stat = tiersolver_solve_tier(tier, 90ULL << 30, true);
+    tier_cache_stat_t after = tier_cache_get_stat();
+    tier_cache_destroy();
+    int leftover = shm_open(name, O_RDONLY, 0);
+    if (leftover >= 0) close(leftover);
+    if (after.hits == before.hits) {
+        printf("tiersolver_test_shared_child_cache: tier %s FAILED: no child tier was read from the cache\n",
+               tier);
+    } else if (leftover >= 0) {
+        printf("tiersolver_test_shared_child_cache: tier %s FAILED: %s was not removed\n", tier, name);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolver_test_shared_child_cache")) {
+        printf("tiersolver_test_shared_child_cache: tier %s passed with %" PRIu64 " cache hits saving %"
+               PRIu64 " bytes\n", tier, after.hits - before.hits, after.bytesSaved - before.bytesSaved);
+    }
+    free(expected);
 }
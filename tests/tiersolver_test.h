@@ -1,6 +1,23 @@
 #ifndef TIERSOLVER_TEST_H
 #define TIERSOLVER_TEST_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "../db.h"
 
 void tiersolver_test_solve_single_tier(const char *tier);
+void tiersolver_test_benchmark_tiers(const char **tiers, int nTiers, int nRuns);
+void tiersolver_test_benchmark_placement(const char *tier, int nRuns);
+void tiersolver_test_benchmark_propagation(const char *tier, int nRuns);
+void tiersolver_test_benchmark_frontier_order(const char *tier, int nRuns);
+void tiersolver_test_checkpoint_resume(const char *tier, const char *dir);
+void tiersolver_test_memory_budget(const char *tier);
+void tiersolver_test_spill(const char *tier);
+void tiersolver_test_child_cache(const char *tier);
+void tiersolver_test_shared_child_cache(const char *tier);
+
+void tiersolver_test_remove_tier_files(const char *tier);
+uint16_t *tiersolver_test_solve_reference(const char *tier, tier_solver_stat_t *stat);
+bool tiersolver_test_expect_same_result(const char *tier, const uint16_t *refValues, tier_solver_stat_t refStat,
+                                        tier_solver_stat_t stat, const char *label);
 
 #endif // TIERSOLVER_TEST_H
@@ -0,0 +1,41 @@
+#include "tiersolvermpi_test.h"
+#include "tiersolver_test.h"
+#include "../tiersolvermpi.h"
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Solves TIER with tiersolver_solve_tier on rank 0, then once more
+ * with tiersolvermpi_solve_tier on all ranks of MPI_COMM_WORLD with MEM
+ * bytes each, and reports on rank 0 whether the distributed solve saves
+ * the same tier file and statistics. Must be called by at least 2 ranks.
+ * Assumes MPI_Init has already been called and all child tiers of TIER
+ * have already been solved.
+ */
+void tiersolvermpi_test_solve_tier(const char *tier, uint64_t mem) {
+    int rank, nRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    if (nRanks < 2) {
+        if (!rank) printf("tiersolvermpi_test_solve_tier: tier %s FAILED: needs at least 2 ranks\n", tier);
+        return;
+    }
+    tier_solver_stat_t expectedStat = {0};
+    uint16_t *expected = NULL;
+    if (!rank) {
+        expected = tiersolver_test_solve_reference(tier, &expectedStat);
+        tiersolver_test_remove_tier_files(tier);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    tier_solver_stat_t stat = tiersolvermpi_solve_tier(tier, mem);
+    if (rank) return;
+    if (!stat.numLegalPos) {
+        printf("tiersolvermpi_test_solve_tier: tier %s FAILED: the distributed solve failed\n", tier);
+    } else if (tiersolver_test_expect_same_result(tier, expected, expectedStat, stat,
+                                                  "tiersolvermpi_test_solve_tier")) {
+        printf("tiersolvermpi_test_solve_tier: tier %s passed on %d ranks\n", tier, nRanks);
+    }
+    free(expected);
+}
@@ -0,0 +1,7 @@
+#ifndef TIERSOLVERMPI_TEST_H
+#define TIERSOLVERMPI_TEST_H
+#include <stdint.h>
+
+void tiersolvermpi_test_solve_tier(const char *tier, uint64_t mem);
+
+#endif // TIERSOLVERMPI_TEST_H
@@ -0,0 +1,637 @@
+#include "memtrack.h"
+#include "tiercache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TIER_CACHE_SHARED_SLOTS 4096   // Most tiers a node shared cache holds at once.
+#define TIER_CACHE_SHARED_PROCS 128    // Most processes attached to a node shared cache at once.
+#define TIER_CACHE_NAME_MAX 64         // Longest name of a node shared cache, including the NUL.
+#define TIER_CACHE_OBJECT_NAME_MAX 96
+
+/* Decompressed values of a tier in the order of its tier file. Entries
+   in use by a solver are pinned and never evicted. */
+typedef struct TierCacheEntry {
+    struct TierCacheEntry *next;
+    char tier[TIER_STR_LENGTH_MAX];
+    uint16_t *values;
+    uint64_t tierSize;
+    uint64_t fileBytes; // Size of the tier file.
+    int layout;         // Layout of the tier file, see enum db_tier_layout.
+    int pins;
+} tier_cache_entry_t;
+
+/* Entries from most to least recently used. The cache is shared by all
+   tiers solved by the process, and all of its memory, including values
+   being read for it, is counted towards CACHEMEM. */
+static tier_cache_entry_t *entries = NULL;
+static memtrack_t cacheMem;
+static bool enabled = false;
+static tier_cache_stat_t stat;
+
+/* A tier in a cache shared by the processes of a node. Its values live in
+   a POSIX shared memory object of their own, which every process maps
+   read-only while using them. A slot is taken as soon as a process starts
+   reading values for the cache, and holds the tier once they are inserted. */
+typedef struct TierCacheSlot {
+    char tier[TIER_STR_LENGTH_MAX];
+    uint64_t object;    // Id of the object holding the values, 0 if the slot is free.
+    uint64_t tierSize;
+    uint64_t fileBytes; // Size of the tier file.
+    uint64_t lastUse;   // Value of the table clock when last acquired or inserted.
+    int32_t layout;     // Layout of the tier file, see enum db_tier_layout.
+    int32_t reader;     // 1 + index of the process reading the values, 0 once they are inserted.
+    int32_t pins;       // Solvers of all processes of the node using the values.
+    uint16_t procPins[TIER_CACHE_SHARED_PROCS]; // Share of PINS held by each attached process.
+} tier_cache_slot_t;
+
+/* Index of a node shared cache, itself kept in a POSIX shared memory
+   object. Any process that runs out of room evicts the least recently
+   used tiers that no process has pinned. The lock is robust, so that a
+   process dying while holding it does not hang the rest of the node, and
+   the pins and reservations of dead processes are reclaimed by pid. */
+typedef struct TierCacheTable {
+    pthread_mutex_t lock;
+    uint64_t budget;
+    uint64_t used;          // Bytes of cached values and of values being read for the cache.
+    uint64_t clock;
+    uint64_t nextObject;
+    int32_t nAttached;      // Processes attached. The last one to detach removes all objects.
+    pid_t pids[TIER_CACHE_SHARED_PROCS]; // Pid of each attached process, 0 if the entry is free.
+    tier_cache_slot_t slots[TIER_CACHE_SHARED_SLOTS];
+} tier_cache_table_t;
+
+/* Shared values mapped into this process, either pinned values of TIER
+   or, if TIER is empty, writable values being read for the cache. */
+typedef struct TierCacheMapping {
+    struct TierCacheMapping *next;
+    char tier[TIER_STR_LENGTH_MAX];
+    uint16_t *values;
+    uint64_t object;
+    uint64_t bytes;
+    tier_cache_slot_t *slot; // Slot taken for writable values.
+    int refs;
+} tier_cache_mapping_t;
+
+/* Set instead of ENTRIES if the cache is shared by the node. */
+static tier_cache_table_t *table = NULL;
+static int procIndex;       // Index of this process in the pids of TABLE.
+static char tableName[TIER_CACHE_NAME_MAX];
+static tier_cache_mapping_t *mappings = NULL;
+
+static void object_name(char *name, uint64_t object) {
+    snprintf(name, TIER_CACHE_OBJECT_NAME_MAX, "%s-%" PRIu64, tableName, object);
+}
+
+static void unlink_object(uint64_t object) {
+    char name[TIER_CACHE_OBJECT_NAME_MAX];
+    object_name(name, object);
+    shm_unlink(name);
+}
+
+/* Maps BYTES bytes of OBJECT into this process, creating the object if
+   WRITABLE is true and mapping it read-only otherwise. Returns NULL on
+   failure. Room is allocated up front, so that a full shared memory file
+   system fails here rather than with SIGBUS on first write. */
+static uint16_t *map_object(uint64_t object, uint64_t bytes, bool writable) {
+    char name[TIER_CACHE_OBJECT_NAME_MAX];
+    object_name(name, object);
+    int fd = shm_open(name, writable ? O_CREAT | O_EXCL | O_RDWR : O_RDONLY, 0600);
+    if (fd < 0) return NULL;
+    if (writable && posix_fallocate(fd, 0, (off_t)bytes)) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    void *addr = mmap(NULL, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        if (writable) shm_unlink(name);
+        return NULL;
+    }
+    return (uint16_t*)addr;
+}
+
+/* Releases the pins and the reservations of process PROC and detaches it.
+   Must be called with the table locked. */
+static void drop_process(int proc) {
+    for (int i = 0; i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        tier_cache_slot_t *slot = table->slots + i;
+        slot->pins -= slot->procPins[proc];
+        slot->procPins[proc] = 0;
+        if (slot->object && slot->reader == proc + 1) {
+            unlink_object(slot->object);
+            table->used -= slot->tierSize * sizeof(uint16_t);
+            slot->object = 0;
+            slot->reader = 0;
+        }
+    }
+    table->pids[proc] = 0;
+    --table->nAttached;
+}
+
+/* Drops every attached process that no longer exists. Returns true if
+   there was any. Must be called with the table locked. */
+static bool reclaim_dead_processes(void) {
+    bool reclaimed = false;
+    for (int i = 0; i < TIER_CACHE_SHARED_PROCS; ++i) {
+        if (table->pids[i] && kill(table->pids[i], 0) && errno == ESRCH) {
+            printf("tier_cache: reclaiming the child tier cache pins of dead process %d\n",
+                   (int)table->pids[i]);
+            drop_process(i);
+            reclaimed = true;
+        }
+    }
+    return reclaimed;
+}
+
+static void table_lock(void) {
+    if (pthread_mutex_lock(&table->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&table->lock);
+        reclaim_dead_processes();
+    }
+}
+
+static void table_unlock(void) {
+    pthread_mutex_unlock(&table->lock);
+}
+
+/* Returns the slot of TIER, or NULL if TIER is not cached. Must be called
+   with the table locked. */
+static tier_cache_slot_t *find_slot(const char *tier) {
+    for (int i = 0; i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        tier_cache_slot_t *slot = table->slots + i;
+        if (slot->object && !slot->reader && !strncmp(slot->tier, tier, TIER_STR_LENGTH_MAX)) return slot;
+    }
+    return NULL;
+}
+
+static tier_cache_slot_t *free_slot(void) {
+    for (int i = 0; i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        if (!table->slots[i].object) return table->slots + i;
+    }
+    return NULL;
+}
+
+/* Removes the least recently used tier that is not pinned by any process.
+   Returns false if there is none. Must be called with the table locked. */
+static bool evict_one_shared(void) {
+    tier_cache_slot_t *victim = NULL;
+    for (int i = 0; i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        tier_cache_slot_t *slot = table->slots + i;
+        if (slot->object && !slot->reader && !slot->pins && (!victim || slot->lastUse < victim->lastUse)) {
+            victim = slot;
+        }
+    }
+    if (!victim) return false;
+    unlink_object(victim->object);
+    table->used -= victim->tierSize * sizeof(uint16_t);
+    victim->object = 0;
+    ++stat.evictions;
+    return true;
+}
+
+/* Evicts tiers until a slot and BYTES bytes of the budget are free, and
+   if that is not enough and RECLAIM is true, reclaims what dead processes
+   hold and tries again. Returns the free slot, or NULL if there is no room.
+   Must be called with the table locked. */
+static tier_cache_slot_t *make_room(uint64_t bytes, bool reclaim) {
+    while (table->used + bytes > table->budget && evict_one_shared()) {}
+    tier_cache_slot_t *slot = free_slot();
+    if (!slot && evict_one_shared()) slot = free_slot();
+    if (slot && table->used + bytes <= table->budget) return slot;
+    return (reclaim && reclaim_dead_processes()) ? make_room(bytes, false) : NULL;
+}
+
+/* Returns the mapping of pinned TIER, or of writable VALUES if TIER is
+   NULL, and unlinks it from the list if UNLINK is true. Must be called
+   inside the critical section. */
+static tier_cache_mapping_t *find_mapping(const char *tier, const uint16_t *values, bool unlink) {
+    tier_cache_mapping_t **walker = &mappings;
+    while (*walker && (tier ? strncmp((*walker)->tier, tier, TIER_STR_LENGTH_MAX) || !(*walker)->refs
+                            : (*walker)->values != values)) {
+        walker = &(*walker)->next;
+    }
+    tier_cache_mapping_t *mapping = *walker;
+    if (mapping && unlink) *walker = mapping->next;
+    return mapping;
+}
+
+/* Enables the cache with a budget of BUDGET bytes, or disables it if
+   BUDGET is 0. */
+void tier_cache_init(uint64_t budget) {
+    memtrack_init(&cacheMem, memtrack_node());
+    memtrack_set_limit(&cacheMem, budget);
+    enabled = (budget != 0);
+}
+
+/**
+ * @brief Enables a cache shared by the processes of a node through POSIX
+ * shared memory objects whose names start with NAME. The cache is created
+ * with a budget of BUDGET bytes for the whole node if BUDGET is not 0, and
+ * attached to otherwise, which must only happen once its creator has
+ * returned. Child tiers are then decompressed once per node and mapped
+ * read-only by every process solving their parents. Returns false on
+ * failure, in which case the cache stays disabled.
+ */
+bool tier_cache_init_shared(const char *name, uint64_t budget) {
+    bool create = (budget != 0);
+    snprintf(tableName, sizeof(tableName), "%s", name);
+    int fd = shm_open(tableName, create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+    if (fd < 0) return false;
+    if (create && ftruncate(fd, sizeof(tier_cache_table_t))) {
+        close(fd);
+        shm_unlink(tableName);
+        return false;
+    }
+    void *addr = mmap(NULL, sizeof(tier_cache_table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        if (create) shm_unlink(tableName);
+        return false;
+    }
+    table = (tier_cache_table_t*)addr;
+    if (create) {
+        /* The object is zero-filled, which leaves every slot free. */
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&table->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        table->budget = budget;
+        table->nextObject = 1;
+    }
+    table_lock();
+    procIndex = 0;
+    while (procIndex < TIER_CACHE_SHARED_PROCS && table->pids[procIndex]) ++procIndex;
+    if (procIndex == TIER_CACHE_SHARED_PROCS && reclaim_dead_processes()) {
+        procIndex = 0;
+        while (table->pids[procIndex]) ++procIndex;
+    }
+    bool attached = (procIndex < TIER_CACHE_SHARED_PROCS);
+    if (attached) {
+        table->pids[procIndex] = getpid();
+        ++table->nAttached;
+    }
+    table_unlock();
+    if (!attached) {
+        munmap(table, sizeof(tier_cache_table_t));
+        table = NULL;
+        if (create) shm_unlink(tableName);
+        return false;
+    }
+    enabled = true;
+    return true;
+}
+
+/* Detaches from the node shared cache, removing it if this process is
+   the last one attached. Must be called inside the critical section. */
+static void destroy_shared(void) {
+    table_lock();
+    reclaim_dead_processes();
+    drop_process(procIndex);
+    bool last = (table->nAttached == 0);
+    for (int i = 0; last && i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        if (table->slots[i].object) unlink_object(table->slots[i].object);
+    }
+    table_unlock();
+    while (mappings) {
+        tier_cache_mapping_t *next = mappings->next;
+        munmap(mappings->values, mappings->bytes);
+        free(mappings);
+        mappings = next;
+    }
+    munmap(table, sizeof(tier_cache_table_t));
+    table = NULL;
+    if (last) shm_unlink(tableName);
+}
+
+void tier_cache_destroy(void) {
+    #pragma omp critical(tier_cache)
+    {
+        if (table) destroy_shared();
+        while (entries) {
+            tier_cache_entry_t *next = entries->next;
+            memtrack_free(&cacheMem, entries->values);
+            free(entries);
+            entries = next;
+        }
+    }
+    enabled = false;
+}
+
+/* Returns the entry of TIER and moves it to the front, or returns NULL
+   if TIER is not cached. Must be called inside the critical section. */
+static tier_cache_entry_t *find_and_touch(const char *tier) {
+    tier_cache_entry_t **walker = &entries;
+    while (*walker && strncmp((*walker)->tier, tier, TIER_STR_LENGTH_MAX)) {
+        walker = &(*walker)->next;
+    }
+    tier_cache_entry_t *entry = *walker;
+    if (entry) {
+        *walker = entry->next;
+        entry->next = entries;
+        entries = entry;
+    }
+    return entry;
+}
+
+/* Frees the least recently used entry that is not pinned. Returns false
+   if there is none. Must be called inside the critical section. */
+static bool evict_one(void) {
+    tier_cache_entry_t **victim = NULL;
+    for (tier_cache_entry_t **walker = &entries; *walker; walker = &(*walker)->next) {
+        if (!(*walker)->pins) victim = walker;
+    }
+    if (!victim) return false;
+    tier_cache_entry_t *entry = *victim;
+    *victim = entry->next;
+    memtrack_free(&cacheMem, entry->values);
+    free(entry);
+    ++stat.evictions;
+    return true;
+}
+
+/* Pins TIER in the node shared cache and returns its values, mapping them
+   into this process unless another solver of the process already has.
+   Sets *LAYOUT and *FILEBYTES as tier_cache_acquire does. Must be called
+   inside the critical section. */
+static const uint16_t *acquire_shared(const char *tier, int *layout, uint64_t *fileBytes) {
+    table_lock();
+    tier_cache_slot_t *slot = find_slot(tier);
+    if (slot) {
+        ++slot->pins;
+        ++slot->procPins[procIndex];
+        slot->lastUse = ++table->clock;
+        *layout = slot->layout;
+        *fileBytes = slot->fileBytes;
+    }
+    uint64_t object = slot ? slot->object : 0;
+    uint64_t bytes = slot ? slot->tierSize * sizeof(uint16_t) : 0;
+    table_unlock();
+    if (!slot) return NULL;
+
+    tier_cache_mapping_t *mapping = find_mapping(tier, NULL, false);
+    if (!mapping) {
+        mapping = (tier_cache_mapping_t*)calloc(1, sizeof(tier_cache_mapping_t));
+        uint16_t *values = mapping ? map_object(object, bytes, false) : NULL;
+        if (!values) {
+            free(mapping);
+            table_lock();
+            --slot->pins; // A pinned slot is never reused.
+            --slot->procPins[procIndex];
+            table_unlock();
+            return NULL;
+        }
+        memcpy(mapping->tier, tier, TIER_STR_LENGTH_MAX);
+        mapping->values = values;
+        mapping->object = object;
+        mapping->bytes = bytes;
+        mapping->next = mappings;
+        mappings = mapping;
+    }
+    ++mapping->refs;
+    return mapping->values;
+}
+
+static void release_shared(const char *tier) {
+    tier_cache_mapping_t *mapping = find_mapping(tier, NULL, false);
+    if (!mapping) return;
+    table_lock();
+    tier_cache_slot_t *slot = find_slot(tier);
+    if (slot) {
+        --slot->pins;
+        --slot->procPins[procIndex];
+    }
+    table_unlock();
+    if (--mapping->refs == 0) {
+        find_mapping(NULL, mapping->values, true);
+        munmap(mapping->values, mapping->bytes);
+        free(mapping);
+    }
+}
+
+/**
+ * @brief Returns the cached values of TIER and pins them until released
+ * with tier_cache_release, or returns NULL if TIER is not cached. On a
+ * hit, sets *LAYOUT and *FILEBYTES to the layout and size of the tier
+ * file the values were inserted with, so that the file need not be opened.
+ */
+const uint16_t *tier_cache_acquire(const char *tier, int *layout, uint64_t *fileBytes) {
+    const uint16_t *values = NULL;
+    if (!enabled) return NULL;
+    #pragma omp critical(tier_cache)
+    if (table) {
+        values = acquire_shared(tier, layout, fileBytes);
+    } else {
+        tier_cache_entry_t *entry = find_and_touch(tier);
+        if (entry) {
+            ++entry->pins;
+            values = entry->values;
+            *layout = entry->layout;
+            *fileBytes = entry->fileBytes;
+        }
+    }
+    return values;
+}
+
+void tier_cache_release(const char *tier) {
+    #pragma omp critical(tier_cache)
+    if (table) {
+        release_shared(tier);
+    } else {
+        tier_cache_entry_t *entry = find_and_touch(tier);
+        if (entry) --entry->pins;
+    }
+}
+
+/* Reserves a slot and room in the node shared cache for the values of a
+   tier of TIERSIZE positions and maps a new object for them. Must be called
+   inside the critical section. */
+static uint16_t *alloc_shared(uint64_t tierSize) {
+    uint64_t bytes = tierSize * sizeof(uint16_t);
+    tier_cache_mapping_t *mapping = (tier_cache_mapping_t*)calloc(1, sizeof(tier_cache_mapping_t));
+    if (!mapping) return NULL;
+    table_lock();
+    tier_cache_slot_t *slot = make_room(bytes, true);
+    if (slot) {
+        table->used += bytes;
+        slot->object = table->nextObject++;
+        slot->tierSize = tierSize;
+        slot->reader = procIndex + 1;
+        mapping->object = slot->object;
+        mapping->slot = slot;
+    }
+    table_unlock();
+    if (slot) mapping->values = map_object(mapping->object, bytes, true);
+    if (!mapping->values) {
+        if (slot) {
+            table_lock();
+            table->used -= bytes;
+            slot->object = 0;
+            slot->reader = 0;
+            table_unlock();
+        }
+        free(mapping);
+        return NULL;
+    }
+    mapping->bytes = bytes;
+    mapping->next = mappings;
+    mappings = mapping;
+    return mapping->values;
+}
+
+/* Discards writable VALUES allocated by alloc_shared, or, if TIER is not
+   NULL, hands them over to the node shared cache as the values of TIER
+   in the slot reserved for them, unless TIER is cached already. */
+static void insert_shared(const char *tier, uint16_t *values, int layout, uint64_t fileBytes) {
+    tier_cache_mapping_t *mapping = find_mapping(NULL, values, true);
+    if (!mapping) return;
+    munmap(mapping->values, mapping->bytes);
+    table_lock();
+    tier_cache_slot_t *slot = mapping->slot;
+    bool keep = tier && !find_slot(tier);
+    if (keep) {
+        memcpy(slot->tier, tier, TIER_STR_LENGTH_MAX);
+        slot->fileBytes = fileBytes;
+        slot->layout = layout;
+        slot->lastUse = ++table->clock;
+    } else {
+        table->used -= mapping->bytes;
+        slot->object = 0;
+    }
+    slot->reader = 0;
+    table_unlock();
+    if (!keep) unlink_object(mapping->object);
+    free(mapping);
+}
+
+/**
+ * @brief Allocates room for the values of a tier of TIERSIZE positions
+ * to be inserted into the cache, evicting least recently used tiers as
+ * needed. Returns NULL if the cache is disabled or the tier does not fit.
+ */
+uint16_t *tier_cache_alloc(uint64_t tierSize) {
+    uint16_t *values = NULL;
+    if (!enabled) return NULL;
+    #pragma omp critical(tier_cache)
+    if (table) {
+        values = alloc_shared(tierSize);
+    } else {
+        do {
+            values = (uint16_t*)memtrack_malloc(&cacheMem, tierSize * sizeof(uint16_t));
+        } while (!values && evict_one());
+    }
+    return values;
+}
+
+/* Frees VALUES allocated by tier_cache_alloc that are not inserted. */
+void tier_cache_free(uint16_t *values) {
+    #pragma omp critical(tier_cache)
+    if (table) {
+        insert_shared(NULL, values, 0, 0);
+    } else {
+        memtrack_free(&cacheMem, values);
+    }
+}
+
+/* Inserts VALUES of TIER, allocated by tier_cache_alloc, into the cache,
+   which takes ownership of them. LAYOUT and FILEBYTES are the layout and
+   size of the tier file the values were read from or saved to. */
+void tier_cache_insert(const char *tier, uint16_t *values, uint64_t tierSize, int layout,
+                       uint64_t fileBytes) {
+    tier_cache_entry_t *entry = table ? NULL : (tier_cache_entry_t*)calloc(1, sizeof(tier_cache_entry_t));
+    #pragma omp critical(tier_cache)
+    {
+        if (table) {
+            insert_shared(tier, values, layout, fileBytes);
+        } else if (!entry || find_and_touch(tier)) {
+            /* Cached by another solver in the meantime, or OOM. */
+            memtrack_free(&cacheMem, values);
+            free(entry);
+        } else {
+            memcpy(entry->tier, tier, TIER_STR_LENGTH_MAX);
+            entry->values = values;
+            entry->tierSize = tierSize;
+            entry->fileBytes = fileBytes;
+            entry->layout = layout;
+            entry->next = entries;
+            entries = entry;
+        }
+    }
+}
+
+/* Inserts a copy of VALUES of TIER into the cache if it fits. */
+void tier_cache_insert_copy(const char *tier, const uint16_t *values, uint64_t tierSize, int layout,
+                            uint64_t fileBytes) {
+    uint16_t *copy = tier_cache_alloc(tierSize);
+    if (!copy) return;
+    memcpy(copy, values, tierSize * sizeof(uint16_t));
+    tier_cache_insert(tier, copy, tierSize, layout, fileBytes);
+}
+
+/* Counts a child tier file of BYTES bytes as served from the cache if
+   HIT is true, or as read from storage otherwise. */
+void tier_cache_record_read(bool hit, uint64_t bytes) {
+    #pragma omp critical(tier_cache)
+    {
+        if (hit) {
+            ++stat.hits;
+            stat.bytesSaved += bytes;
+        } else {
+            ++stat.misses;
+            stat.bytesRead += bytes;
+        }
+    }
+}
+
+tier_cache_stat_t tier_cache_get_stat(void) {
+    tier_cache_stat_t ret;
+    #pragma omp critical(tier_cache)
+    ret = stat;
+    return ret;
+}
+
+static int compare_last_use_desc(const void *a, const void *b) {
+    uint64_t x = (*(const tier_cache_slot_t* const*)a)->lastUse;
+    uint64_t y = (*(const tier_cache_slot_t* const*)b)->lastUse;
+    return (x < y) - (x > y);
+}
+
+/* Must be called inside the critical section. */
+static int list_shared(char (*tiers)[TIER_STR_LENGTH_MAX], int max) {
+    const tier_cache_slot_t *used[TIER_CACHE_SHARED_SLOTS];
+    int nUsed = 0, n = 0;
+    table_lock();
+    for (int i = 0; i < TIER_CACHE_SHARED_SLOTS; ++i) {
+        if (table->slots[i].object && !table->slots[i].reader) used[nUsed++] = table->slots + i;
+    }
+    qsort(used, nUsed, sizeof(used[0]), compare_last_use_desc);
+    for (; n < max && n < nUsed; ++n) memcpy(tiers[n], used[n]->tier, TIER_STR_LENGTH_MAX);
+    table_unlock();
+    return n;
+}
+
+/* Stores the names of at most MAX cached tiers, most recently used first,
+   in TIERS and returns their number. A node shared cache lists the tiers
+   cached by every process of the node. */
+int tier_cache_list(char (*tiers)[TIER_STR_LENGTH_MAX], int max) {
+    int n = 0;
+    #pragma omp critical(tier_cache)
+    if (table) {
+        n = list_shared(tiers, max);
+    } else {
+        for (tier_cache_entry_t *walker = entries; walker && n < max; walker = walker->next) {
+            memcpy(tiers[n++], walker->tier, TIER_STR_LENGTH_MAX);
+        }
+    }
+    return n;
+}
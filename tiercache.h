@@ -0,0 +1,35 @@
+#ifndef TIERCACHE_H
+#define TIERCACHE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "tier.h"
+
+/* Counters of child tier reads. Bytes are those of the compressed tier
+   files, which is what would otherwise be read from shared storage. */
+typedef struct TierCacheStat {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t bytesRead;     // Bytes of child tier files read from storage.
+    uint64_t bytesSaved;    // Bytes of child tier files served from the cache instead.
+} tier_cache_stat_t;
+
+void tier_cache_init(uint64_t budget);
+bool tier_cache_init_shared(const char *name, uint64_t budget);
+void tier_cache_destroy(void);
+
+const uint16_t *tier_cache_acquire(const char *tier, int *layout, uint64_t *fileBytes);
+void tier_cache_release(const char *tier);
+
+uint16_t *tier_cache_alloc(uint64_t tierSize);
+void tier_cache_free(uint16_t *values);
+void tier_cache_insert(const char *tier, uint16_t *values, uint64_t tierSize, int layout,
+                       uint64_t fileBytes);
+void tier_cache_insert_copy(const char *tier, const uint16_t *values, uint64_t tierSize, int layout,
+                            uint64_t fileBytes);
+
+void tier_cache_record_read(bool hit, uint64_t bytes);
+tier_cache_stat_t tier_cache_get_stat(void);
+int tier_cache_list(char (*tiers)[TIER_STR_LENGTH_MAX], int max);
+
+#endif // TIERCACHE_H
@@ -0,0 +1,149 @@
+#include "db.h"
+#include "tier.h"
+#include "tierqueue.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Solving a tier takes roughly a fixed setup cost plus a cost proportional
+   to its size. Both are in thread-seconds and only their ratio matters for
+   the order of tiers. They are used for tiers that have not been solved
+   before. Tiers solved before use the time recorded in their telemetry. */
+#define DEFAULT_TIER_SECONDS 0.05
+#define DEFAULT_POSITION_SECONDS 1e-5
+#define QUEUE_INITIAL_CAPACITY 1024
+
+void tier_queue_init(tier_queue_t *queue, int policy) {
+    queue->heap = NULL;
+    queue->size = queue->capacity = 0;
+    queue->nPushed = 0;
+    queue->policy = policy;
+}
+
+/* Frees QUEUE and all entries left in it. */
+void tier_queue_destroy(tier_queue_t *queue) {
+    for (int64_t i = 0; i < queue->size; ++i) free(queue->heap[i].entry);
+    free(queue->heap); queue->heap = NULL;
+    queue->size = queue->capacity = 0;
+}
+
+/* Returns true if item A should be solved before item B. */
+static bool before(const tier_queue_item_t *a, const tier_queue_item_t *b) {
+    if (a->priority != b->priority) return a->priority > b->priority;
+    return a->seq < b->seq;
+}
+
+static void swap_items(tier_queue_item_t *a, tier_queue_item_t *b) {
+    tier_queue_item_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/**
+ * @brief Returns the estimated thread-seconds needed to solve TIER, as
+ * measured if TIER has been solved before.
+ */
+double tier_queue_cost(const char *tier) {
+    double seconds;
+    int nThreads;
+    if (db_load_solve_time(tier, &seconds, &nThreads)) return seconds * nThreads;
+    return DEFAULT_TIER_SECONDS + tier_size(tier) * DEFAULT_POSITION_SECONDS;
+}
+
+/**
+ * @brief Returns the estimated thread-seconds needed to solve ENTRY and
+ * its longest chain of unsolved ancestors, which no number of workers can
+ * shorten. Ancestors are found in the parent index if ENTRY is indexed,
+ * or in the tier tree otherwise, and the estimate of each of them is
+ * computed once and kept in its entry.
+ */
+double tier_queue_critical_path(tier_tree_entry_t *entry) {
+    if (entry->criticalPath) return entry->criticalPath;
+    double longest = 0.0;
+    if (entry->id >= 0) {
+        const tier_parent_index_t *index = tier_tree_parent_index();
+        for (int64_t i = index->offsets[entry->id]; i < index->offsets[entry->id + 1]; ++i) {
+            tier_tree_entry_t *parent = tier_tree_indexed_entry(index->parents[i]);
+            if (!parent) continue; // Solved.
+            double path = tier_queue_critical_path(parent);
+            if (path > longest) longest = path;
+        }
+        entry->criticalPath = tier_queue_cost(entry->tier) + longest;
+        return entry->criticalPath;
+    }
+    TierList *parentTiers = tier_get_parent_tier_list(entry->tier);
+    for (struct TierListElem *walker = parentTiers; walker; walker = walker->next) {
+        struct TierListElem *canonical = tier_get_canonical_tier(walker->tier);
+        tier_tree_entry_t *parent = tier_tree_find(canonical->tier);
+        free(canonical);
+        if (!parent) continue; // Not being solved.
+        double path = tier_queue_critical_path(parent);
+        if (path > longest) longest = path;
+    }
+    tier_list_destroy(parentTiers);
+    entry->criticalPath = tier_queue_cost(entry->tier) + longest;
+    return entry->criticalPath;
+}
+
+void tier_queue_push(tier_queue_t *queue, tier_tree_entry_t *entry) {
+    if (queue->size == queue->capacity) {
+        int64_t capacity = queue->capacity ? queue->capacity * 2 : QUEUE_INITIAL_CAPACITY;
+        tier_queue_item_t *heap = (tier_queue_item_t*)realloc(queue->heap, capacity * sizeof(tier_queue_item_t));
+        if (!heap) {
+            printf("tier_queue_push: OOM\n");
+            exit(1);
+        }
+        queue->heap = heap;
+        queue->capacity = capacity;
+    }
+    entry->next = NULL;
+    int64_t i = queue->size++;
+    queue->heap[i].entry = entry;
+    queue->heap[i].seq = queue->nPushed++;
+    /* Non-canonical tiers are never solved, so they come out first to be
+       skipped right away. */
+    if (queue->policy == TIER_QUEUE_FIFO) {
+        queue->heap[i].priority = 0.0;
+    } else if (!tier_is_canonical_tier(entry->tier)) {
+        queue->heap[i].priority = INFINITY;
+    } else {
+        queue->heap[i].priority = tier_queue_critical_path(entry);
+    }
+
+    while (i && before(&queue->heap[i], &queue->heap[(i - 1) / 2])) {
+        swap_items(&queue->heap[i], &queue->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+/* Pushes all entries of LIST in list order. */
+void tier_queue_push_list(tier_queue_t *queue, TierTreeEntryList *list) {
+    while (list) {
+        tier_tree_entry_t *next = list->next;
+        tier_queue_push(queue, list);
+        list = next;
+    }
+}
+
+/* Returns the entry to be solved next, or NULL if QUEUE is empty. */
+tier_tree_entry_t *tier_queue_peek(const tier_queue_t *queue) {
+    return queue->size ? queue->heap[0].entry : NULL;
+}
+
+/* Removes and returns the entry to be solved next, or NULL if QUEUE is
+   empty. The caller is responsible for freeing the entry. */
+tier_tree_entry_t *tier_queue_pop(tier_queue_t *queue) {
+    if (!queue->size) return NULL;
+    tier_tree_entry_t *ret = queue->heap[0].entry;
+    queue->heap[0] = queue->heap[--queue->size];
+    int64_t i = 0;
+    while (true) {
+        int64_t first = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < queue->size && before(&queue->heap[left], &queue->heap[first])) first = left;
+        if (right < queue->size && before(&queue->heap[right], &queue->heap[first])) first = right;
+        if (first == i) break;
+        swap_items(&queue->heap[i], &queue->heap[first]);
+        i = first;
+    }
+    return ret;
+}
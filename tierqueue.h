@@ -0,0 +1,39 @@
+#ifndef TIERQUEUE_H
+#define TIERQUEUE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "tiertree.h"
+
+enum tier_queue_policy {
+    TIER_QUEUE_FIFO = 0,        // Tiers are solved in the order they become solvable.
+    TIER_QUEUE_CRITICAL_PATH    // Tiers with the longest remaining critical path are solved first.
+};
+
+/* Solvable tiers waiting to be solved, kept in a binary heap. Tiers with
+   equal priority come out in the order they were pushed. */
+typedef struct TierQueueItem {
+    tier_tree_entry_t *entry;
+    double priority;
+    uint64_t seq;
+} tier_queue_item_t;
+
+typedef struct TierQueue {
+    tier_queue_item_t *heap;
+    int64_t size;
+    int64_t capacity;
+    uint64_t nPushed;
+    int policy;
+} tier_queue_t;
+
+void tier_queue_init(tier_queue_t *queue, int policy);
+void tier_queue_destroy(tier_queue_t *queue);
+
+void tier_queue_push(tier_queue_t *queue, tier_tree_entry_t *entry);
+void tier_queue_push_list(tier_queue_t *queue, TierTreeEntryList *list);
+tier_tree_entry_t *tier_queue_peek(const tier_queue_t *queue);
+tier_tree_entry_t *tier_queue_pop(tier_queue_t *queue);
+
+double tier_queue_cost(const char *tier);
+double tier_queue_critical_path(tier_tree_entry_t *entry);
+
+#endif // TIERQUEUE_H
@@ -2,14 +2,28 @@
 #include "db.h"
 #include "frontier.h"
 #include "game.h"
+#include "memtrack.h"
 #include "misc.h"
+#include "spill.h"
 #include "tier.h"
+#include "tiercache.h"
 #include "tiersolver.h"
+#include <linux/mempolicy.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <assert.h>
+#include <fcntl.h>
 #include <malloc.h>
 #include <omp.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 /**
 0: RESERVED – UNREACHEABLE POSITION
@@ -28,105 +42,242 @@
 
 #define FR_SIZE (((UINT16_MAX)-1)>>1)
 #define RESERVED_VALUE 0 // Refer to the value table.
+#define CHECKPOINT_MAGIC "XQCKPT03"
+#define CHECKPOINT_MAGIC_LENGTH 8
+#define HUGE_PAGE_SIZE (2ULL << 20)
+#define PARENT_PARTITION_BITS 18          // 2^18 positions take 768 KiB of solver arrays.
+#define BLOCKED_ROUND_ENTRIES (1ULL << 16) // Frontier positions per thread per round.
+#define BLOCKED_PARENTS_PER_POS 16        // Assumed average when estimating memory.
+#define PREFETCH_DISTANCE 16
+#define POSITION_CHUNK_SIZE 1024          // Positions handed out at a time by per-position loops.
+#define CLASSIFY_CHUNK_SIZE 4096          // Child values classified at a time in step 1.
+#define HEAP_TRIM_MIN_PEAK (64ULL << 20) // Heap is trimmed after tiers that used at least this much.
+#define SPILL_PARTITION_BITS_MIN 16       // 2^16 positions take 192 KiB of solver arrays.
+#define SPILL_PARTITIONS_MAX 4096
+#define SPILL_UPDATE_BUFFER_RECORDS 1024  // 8 KiB of buffered parent updates per stream.
+#define SPILL_READ_RECORDS (1ULL << 13)   // Frontier records read from disk at a time.
+#define SPILL_BUFFERED_LEVELS 64          // Assumed number of frontier levels buffered at once.
 
-static const char *kTier = NULL;       // Tier being solved.
-static tier_solver_stat_t stat;        // Tier solver statistics.
-static fr_t winFR, loseFR;             // Win and lose frontiers.
-static uint64_t **winDivider = NULL;   // Holds the number of positions from each child tier in loseFR (heap).
-static uint64_t **loseDivider = NULL;  // Holds the number of positions from each child tier in winFR (heap).
-struct TierArray childTiers;           // Array of child tiers (heap).
-static uint8_t *nUndChild = NULL;      // Number of undecided child positions array (heap).
-static omp_lock_t nUndChildLock;       // Lock for the above array.
-static uint16_t *values = NULL;        // Remoteness value array (heap).
-static uint64_t tierSize;              // Number of positions in TIER.
-static board_t board;                  // Reuse this board for all children/parent generation.
+/* Per-step timings and throughput counters of solving a tier. */
+typedef struct TierTelemetry {
+    double stepSeconds[DB_NUM_SOLVER_STEPS];
+    uint64_t childPositions;      // Positions scanned in child tiers in step 1.
+    uint64_t bytesRead;           // Bytes read from child tier files in step 1.
+    uint64_t bytesWritten;        // Bytes written to the tier and stat files in step 6.
+    uint64_t step4Positions;      // Frontier positions processed in step 4.
+    uint64_t parents;             // Parent positions generated in step 4.
+    uint64_t lockWaitNs;          // Time spent waiting for locks by all threads.
+    uint64_t unhashSteps;         // Unhash steps needed in step 4.
+    uint64_t unhashStepsReused;   // Unhash steps skipped by reusing the previous board.
+    thread_load_t step3Load;      // Busy and idle time of the threads in step 3.
+    thread_load_t step4Load;      // Busy and idle time of the threads in step 4.
+    uint64_t heapBytes;           // Heap size of the process after step 5.
+    uint64_t heapFreeBytes;       // Free heap memory not returned to the system after step 5.
+    uint16_t nLevels;             // Number of remoteness levels recorded below.
+    uint16_t levelsCapacity;
+    uint64_t *loseSizes;          // Number of losing positions at each remoteness.
+    uint64_t *winSizes;           // Number of winning positions at each remoteness.
+} tier_telemetry_t;
+
+/* State kept by each thread while processing frontier positions. */
+typedef struct ThreadState {
+    uint64_t parents;
+    uint64_t lockWaitNs;
+    double busy;
+    double idle;
+    unhash_cache_t cache;
+} thread_state_t;
+
+/* Parent positions generated by one thread in blocked propagation. */
+typedef struct ParentBuffer {
+    uint64_t *raw;                // Indices of parents in the order they were generated.
+    uint64_t *sorted;             // The same parents grouped by partition.
+    uint64_t size;                // Number of parents in the current round.
+    uint64_t capacity;            // Capacity of both RAW and SORTED.
+    uint64_t *offsets;            // Start of each partition in SORTED, followed by SIZE.
+} parent_buffer_t;
+
+/* Solver context. All state of a tier being solved lives here so that
+   several tiers can be solved concurrently by different threads. */
+typedef struct TierSolver {
+    const char *tier;             // Tier being solved.
+    tier_solver_stat_t stat;      // Tier solver statistics.
+    fr_t winFR, loseFR;           // Win and lose frontiers, one segment per child tier plus one for TIER.
+    struct TierArray childTiers;  // Array of child tiers (heap).
+    uint8_t *nUndChild;           // Number of undecided child positions array (heap).
+    omp_lock_t nUndChildLock;     // Lock for the above array.
+    uint16_t *values;             // Remoteness value array (heap).
+    uint64_t tierSize;            // Number of positions in TIER.
+    board_t board;                // Reuse this board for all children/parent generation.
+    uint16_t startRmt;            // Remoteness at which step 4 starts, nonzero if resumed.
+    double lastCheckpoint;        // Time of the last checkpoint, from omp_get_wtime.
+    int mode;                     // Solver mode chosen by admission control.
+    uint16_t ownLevelsEnd;        // Compact mode only, see below.
+    memtrack_t mem;               // Account of all memory used to solve TIER.
+    tier_mem_stat_t memStat;      // Measured memory usage of each step.
+    tier_telemetry_t telemetry;   // Timings and counters, saved as JSON.
+    double stepStart;             // Start time of the current step, from omp_get_wtime.
+    parent_buffer_t *parentBuffers; // Blocked propagation and spill mode only, one per thread.
+    int nParentBuffers;
+    uint8_t partitionBits;        // Parents are grouped by index ranges of 2^PARTITIONBITS positions.
+    uint64_t nPartitions;         // Number of such index ranges.
+    spill_fr_t spillWinFR, spillLoseFR; // Spill mode only, frontiers on disk.
+    spill_stream_t *updates;      // Spill mode only, see below.
+    uint64_t *records;            // Spill mode only, frontier records read from disk.
+    int arraysFd;                 // Spill mode only, scratch file of the solver arrays.
+    char *arraysFilename;
+} tier_solver_t;
+
+/* In compact mode, positions of TIER are not added to the frontiers.
+   Instead, the positions of TIER at each remoteness level are found by
+   scanning the values array, which trades one pass over the array per
+   level for the 16 bytes per position that the frontier segment of TIER
+   may take. All levels of TIER at or above OWNLEVELSEND are empty. */
+
+/* In spill mode, the frontiers live on disk and the solver arrays are
+   split into NPARTITIONS partitions by index, of which only one is in
+   memory at a time. VALUES and NUNDCHILD hold the current partition and
+   all partitions are kept in a scratch file. The parents generated from
+   each remoteness level are appended to two update streams per partition,
+   UPDATES[2P] from losing and UPDATES[2P+1] from winning positions, and
+   the partitions are then loaded and updated one by one. As all updates
+   of a level reach a partition before it is loaded, each partition is
+   read and written once per level, and positions are decided in the same
+   order as in the other modes. */
+
+/* Checkpoint options, shared by all tiers being solved. */
+static char *checkpointDir = NULL;           // Checkpoints are disabled if NULL.
+static double checkpointInterval = 0.0;      // Seconds between periodic checkpoints.
+static volatile sig_atomic_t stopRequested;  // Set by tiersolver_request_stop.
+static int arrayPlacement = TIERSOLVER_PLACE_FIRST_TOUCH;
+static bool arrayHugePages = false;
+static int parentPropagation = TIERSOLVER_PROPAGATE_DIRECT;
+static bool sortFrontier = false;
+static int forcedMode = TIERSOLVER_MODE_NONE;     // Admission control chooses the mode if NONE.
+
+/* Adds position HASH of TIER, decided at remoteness RMT, to FRONTIER
+   unless the solver runs in compact mode. In spill mode, the position
+   is added to the on-disk counterpart of FRONTIER instead. */
+static bool add_own_pos(tier_solver_t *ts, fr_t *frontier, uint64_t hash, uint16_t rmt) {
+    if (ts->mode == TIERSOLVER_MODE_SPILL) {
+        spill_fr_t *spilled = (frontier == &ts->winFR) ? &ts->spillWinFR : &ts->spillLoseFR;
+        return spill_frontier_add(spilled, hash, rmt, ts->childTiers.size);
+    }
+    if (ts->mode == TIERSOLVER_MODE_COMPACT) {
+        /* All positions added at the same time have the same remoteness. */
+        if (rmt >= ts->ownLevelsEnd) __atomic_store_n(&ts->ownLevelsEnd, rmt + 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    return frontier_add(frontier, hash, rmt, ts->childTiers.size);
+}
 
 /**
- * @brief Initializes solver frontiers.
- * @note Terminates the program if memory allocation fails.
+ * @brief Initializes solver frontiers with one segment for each child
+ * tier and one segment for the tier being solved, which comes last.
+ * @return false if OOM.
  */
-static void init_FR(void) {
-    frontier_init(&winFR, FR_SIZE);
-    frontier_init(&loseFR, FR_SIZE);
+static bool init_FR(tier_solver_t *ts, uint8_t nChildTiers) {
+    if (ts->mode == TIERSOLVER_MODE_SPILL) {
+        /* Spilled records pack the hash below the segment. */
+        assert(ts->tierSize < (1ULL << SPILL_SEG_SHIFT));
+        return spill_frontier_init(&ts->spillWinFR, ts->tier, "win", FR_SIZE, &ts->mem) &&
+               spill_frontier_init(&ts->spillLoseFR, ts->tier, "lose", FR_SIZE, &ts->mem);
+    }
+    return frontier_init(&ts->winFR, FR_SIZE, nChildTiers + 1, &ts->mem) &&
+           frontier_init(&ts->loseFR, FR_SIZE, nChildTiers + 1, &ts->mem);
 }
 
-static void destroy_FR(void) {
-    frontier_destroy(&winFR);
-    frontier_destroy(&loseFR);
+static void destroy_FR(tier_solver_t *ts) {
+    frontier_destroy(&ts->winFR);
+    frontier_destroy(&ts->loseFR);
+    spill_frontier_destroy(&ts->spillWinFR);
+    spill_frontier_destroy(&ts->spillLoseFR);
 }
 
 static void init_solver_stat(tier_solver_stat_t *stat) {
     memset(stat, 0, sizeof(*stat));
 }
 
-static void init_dividers(uint8_t nChildTiers) {
-    if (!nChildTiers) return;
-    winDivider = (uint64_t**)safe_malloc(FR_SIZE*sizeof(uint64_t*));
-    loseDivider = (uint64_t**)safe_malloc(FR_SIZE*sizeof(uint64_t*));
-    for (uint16_t rmt = 0; rmt < FR_SIZE; ++rmt) {
-        winDivider[rmt] = (uint64_t*)safe_calloc(nChildTiers, sizeof(uint64_t));
-        loseDivider[rmt] = (uint64_t*)safe_calloc(nChildTiers, sizeof(uint64_t));
-    }
-}
-
-static void destroy_dividers() {
-    /* Both arrays should be freed at the same time. */
-    if (!winDivider) return;
-    for (uint16_t i = 0; i < FR_SIZE; ++i) {
-        free(winDivider[i]);
-        free(loseDivider[i]);
-    }
-    free(winDivider); winDivider = NULL;
-    free(loseDivider); loseDivider = NULL;
-}
-
-static bool check_and_load_frontier(uint8_t childIdx, uint64_t hash, uint16_t val) {
+static bool check_and_load_frontier(tier_solver_t *ts, uint8_t childIdx, uint64_t hash, uint16_t val) {
     if (!val || val == DRAW_VALUE) return true;
     if (val < DRAW_VALUE) {
         /* LOSE */
         uint16_t rmt = val - 1;
-        if (!frontier_add(&loseFR, hash, rmt)) return false;
-        #pragma omp atomic
-        ++loseDivider[rmt][childIdx];
+        if (ts->mode == TIERSOLVER_MODE_SPILL) return spill_frontier_add(&ts->spillLoseFR, hash, rmt, childIdx);
+        if (!frontier_add(&ts->loseFR, hash, rmt, childIdx)) return false;
     } else {
         /* WIN */
         uint16_t rmt = UINT16_MAX - val;
-        if (!frontier_add(&winFR, hash, rmt)) return false;
-        #pragma omp atomic
-        ++winDivider[rmt][childIdx];
+        if (ts->mode == TIERSOLVER_MODE_SPILL) return spill_frontier_add(&ts->spillWinFR, hash, rmt, childIdx);
+        if (!frontier_add(&ts->winFR, hash, rmt, childIdx)) return false;
     }
     return true;
 }
 
-static void accumulate_dividers(uint8_t nChildTiers) {
-    #pragma omp parallel for
-    for (uint16_t rmt = 0; rmt < FR_SIZE; ++rmt) {
-        for (uint8_t childIdx = 1; childIdx < nChildTiers; ++childIdx) {
-            winDivider[rmt][childIdx] += winDivider[rmt][childIdx - 1];
-            loseDivider[rmt][childIdx] += loseDivider[rmt][childIdx - 1];
-        }
+/* Solver arrays are indexed in turn-split layout, so that all parents of
+   a frontier position, which have the opposite side to move, lie in the
+   same half of each array. Tier files are saved in the same layout. */
+static inline uint64_t pos_index(const tier_solver_t *ts, uint64_t hash) {
+    return db_layout_index(DB_LAYOUT_TURN_SPLIT, ts->tierSize, hash);
+}
+
+static inline uint64_t pos_hash(const tier_solver_t *ts, uint64_t idx) {
+    return db_layout_hash(DB_LAYOUT_TURN_SPLIT, ts->tierSize, idx);
+}
+
+/* Returns the number of positions in partition P and sets *BASE to the
+   index of its first position. */
+static uint64_t partition_range(const tier_solver_t *ts, uint64_t p, uint64_t *base) {
+    uint64_t partitionSize = 1ULL << ts->partitionBits;
+    *base = p << ts->partitionBits;
+    return (ts->tierSize - *base < partitionSize) ? ts->tierSize - *base : partitionSize;
+}
+
+static bool transfer_bytes(int fd, void *buf, uint64_t len, uint64_t offset, bool store) {
+    uint8_t *bytes = (uint8_t*)buf;
+    while (len) {
+        ssize_t n = store ? pwrite(fd, bytes, len, (off_t)offset) : pread(fd, bytes, len, (off_t)offset);
+        if (n <= 0) return false;
+        bytes += n;
+        len -= n;
+        offset += n;
     }
+    return true;
 }
 
-static bool process_lose_pos(uint16_t childRmt, const char *childPosTier,
-                             uint64_t childPosHash,
-                             tier_change_t change, board_t *board) {
+/* Loads partition P of the solver arrays from the scratch file of TS into
+   VALUES and NUNDCHILD, or stores it there if STORE is true. NUNDCHILD is
+   skipped if VALUESONLY is true. Returns false on an I/O error. */
+static bool transfer_partition(tier_solver_t *ts, uint64_t p, bool store, bool valuesOnly) {
+    uint64_t base, n = partition_range(ts, p, &base);
+    if (!transfer_bytes(ts->arraysFd, ts->values, n * sizeof(uint16_t), base * sizeof(uint16_t), store)) {
+        return false;
+    }
+    return valuesOnly || transfer_bytes(ts->arraysFd, ts->nUndChild, n,
+                                        ts->tierSize * sizeof(uint16_t) + base, store);
+}
+
+static bool process_lose_pos(tier_solver_t *ts, uint16_t childRmt, const char *childPosTier,
+                             uint64_t childPosHash, tier_change_t change, board_t *board,
+                             thread_state_t *state) {
     uint8_t remChildren;
-    pos_array_t parents = game_get_parents(childPosTier, childPosHash, kTier, change, board);
+    pos_array_t parents = game_get_parents(childPosTier, childPosHash, ts->tier, change, board, &state->cache);
     if (parents.size == ILLEGAL_POSITION_ARRAY_SIZE) { // OOM.
         free(parents.array); parents.array = NULL;
         return false;
     }
+    state->parents += parents.size;
     for (uint8_t i = 0; i < parents.size; ++i) {
-        omp_set_lock(&nUndChildLock);
-        remChildren = nUndChild[parents.array[i]];
-        nUndChild[parents.array[i]] = 0;
-        omp_unset_lock(&nUndChildLock);
+        uint64_t idx = pos_index(ts, parents.array[i]);
+        state->lockWaitNs += set_lock_timed(&ts->nUndChildLock);
+        remChildren = ts->nUndChild[idx];
+        ts->nUndChild[idx] = 0;
+        omp_unset_lock(&ts->nUndChildLock);
         if (!remChildren) continue;
 
         /* All parents are win in (childRmt + 1) positions. */
-        values[parents.array[i]] = UINT16_MAX - childRmt - 1; // Refer to the value table.
-        if (!frontier_add(&winFR, parents.array[i], childRmt + 1)) { // OOM.
+        ts->values[idx] = UINT16_MAX - childRmt - 1; // Refer to the value table.
+        if (!add_own_pos(ts, &ts->winFR, parents.array[i], childRmt + 1)) { // OOM.
             free(parents.array); parents.array = NULL;
             return false;
         }
@@ -135,29 +286,31 @@ static bool process_lose_pos(uint16_t childRmt, const char *childPosTier,
     return true;
 }
 
-static bool process_win_pos(uint16_t childRmt, const char *childPosTier,
-                            uint64_t childPosHash,
-                            tier_change_t change, board_t *board) {
+static bool process_win_pos(tier_solver_t *ts, uint16_t childRmt, const char *childPosTier,
+                            uint64_t childPosHash, tier_change_t change, board_t *board,
+                            thread_state_t *state) {
     uint8_t remChildren;
-    pos_array_t parents = game_get_parents(childPosTier, childPosHash, kTier, change, board);
+    pos_array_t parents = game_get_parents(childPosTier, childPosHash, ts->tier, change, board, &state->cache);
     if (parents.size == ILLEGAL_POSITION_ARRAY_SIZE) { // OOM.
         free(parents.array); parents.array = NULL;
         return false;
     }
+    state->parents += parents.size;
     for (uint8_t i = 0; i < parents.size; ++i) {
-        omp_set_lock(&nUndChildLock);
-        if (!nUndChild[parents.array[i]]) {
-            omp_unset_lock(&nUndChildLock);
+        uint64_t idx = pos_index(ts, parents.array[i]);
+        state->lockWaitNs += set_lock_timed(&ts->nUndChildLock);
+        if (!ts->nUndChild[idx]) {
+            omp_unset_lock(&ts->nUndChildLock);
             continue;
         }
-        remChildren = --nUndChild[parents.array[i]];
-        omp_unset_lock(&nUndChildLock);
+        remChildren = --ts->nUndChild[idx];
+        omp_unset_lock(&ts->nUndChildLock);
 
         /* If this child position is the last undecided child of parent position,
            mark parent as lose in (childRmt + 1). */
         if (!remChildren) {
-            values[parents.array[i]] = childRmt + 2; // Refer to the value table.
-            if (!frontier_add(&loseFR, parents.array[i], childRmt + 1)) { // OOM.
+            ts->values[idx] = childRmt + 2; // Refer to the value table.
+            if (!add_own_pos(ts, &ts->loseFR, parents.array[i], childRmt + 1)) { // OOM.
                 free(parents.array); parents.array = NULL;
                 return false;
             }
@@ -167,217 +320,1331 @@ static bool process_win_pos(uint16_t childRmt, const char *childPosTier,
     return true;
 }
 
-static bool solve_tier_step_0_initialize(const char *tier, uint64_t mem) {    
-    uint64_t tierRequiredMem = tier_required_mem(tier);
+/* Returns the peak memory needed to solve a tier of SIZE positions in
+   spill mode with partitions of 2^BITS positions. Besides one partition
+   of the solver arrays, this covers the buffers of the update streams of
+   all partitions and of the frontier levels being written, the parents
+   generated from one read of frontier records, and the child blocks of
+   step 1, for NTHREADS threads. Step 6 compresses one partition, or one
+   block of the tier file if partitions are smaller, at a time. */
+static uint64_t spill_mem(uint64_t size, uint8_t bits, uint64_t nThreads) {
+    uint64_t partitionSize = (size < (1ULL << bits)) ? size : 1ULL << bits;
+    uint64_t nPartitions = ((size - 1) >> bits) + 1;
+    uint64_t chunkSize = (partitionSize < DB_TIER_BLOCK_VALUES) ? DB_TIER_BLOCK_VALUES : partitionSize;
+    uint64_t buffers = nThreads * 3 * (1ULL << 20);
+    uint64_t levels = 2 * FR_SIZE * sizeof(spill_stream_t*) +
+                      2 * SPILL_BUFFERED_LEVELS * (SPILL_LEVEL_BUFFER_RECORDS * sizeof(uint64_t) +
+                                                   sizeof(spill_stream_t));
+    uint64_t updates = 2 * nPartitions * (SPILL_UPDATE_BUFFER_RECORDS * sizeof(uint64_t) + sizeof(spill_stream_t));
+    /* Parent buffers may be up to twice as large as needed after doubling. */
+    uint64_t parents = nThreads * (2 * sizeof(uint64_t) * BLOCKED_ROUND_ENTRIES +
+                                   sizeof(uint64_t) * (nPartitions + 1)) +
+                       2 * 2 * sizeof(uint64_t) * SPILL_READ_RECORDS * BLOCKED_PARENTS_PER_POS +
+                       sizeof(uint64_t) * SPILL_READ_RECORDS;
+    uint64_t load = buffers + levels;
+    uint64_t solve = 3 * partitionSize + levels + updates + parents;
+    uint64_t save = 3 * sizeof(uint16_t) * chunkSize + buffers;
+    if (solve < load) solve = load;
+    return (solve > save) ? solve : save;
+}
 
-    /* Zero-initialize solver statistics. */
-    init_solver_stat(&stat);
+/* Returns the number of bits of the partitions of a tier of SIZE
+   positions solved in spill mode by NTHREADS threads within MEM bytes.
+   Partitions are made as large as MEM allows, so that fewer of them are
+   read and written per remoteness level. */
+static uint8_t spill_partition_bits(uint64_t size, uint64_t mem, uint64_t nThreads) {
+    uint8_t bits = SPILL_PARTITION_BITS_MIN;
+    while (((size - 1) >> bits) + 1 > SPILL_PARTITIONS_MAX) ++bits;
+    while ((1ULL << bits) < size && spill_mem(size, bits + 1, nThreads) <= mem) ++bits;
+    return bits;
+}
+
+static bool solve_tier_step_0_initialize(tier_solver_t *ts, const char *tier, uint64_t mem) {
+    uint64_t tierRequiredMem;
+
+    /* Zero-initialize solver context and statistics. */
+    memset(ts, 0, sizeof(*ts));
+    ts->arraysFd = -1;
+    ts->stepStart = omp_get_wtime();
+    init_solver_stat(&ts->stat);
+    omp_init_lock(&ts->nUndChildLock);
+    memtrack_init(&ts->mem, memtrack_node());
+    /* All solver working memory is allocated through TS->MEM, so the
+       budget makes allocations fail cleanly instead of overcommitting. */
+    memtrack_set_limit(&ts->mem, mem);
+    ts->mode = tiersolver_admit(tier, mem, &tierRequiredMem);
+    ts->memStat.mode = ts->mode;
     /* OOM anticipated. */
-    if (!tierRequiredMem || tierRequiredMem > mem) {
+    if (ts->mode == TIERSOLVER_MODE_NONE) {
         printf("tiersolver_solve_tier: early termination due to OOM. Expect to "
                "use %zd bytes of memory, but only %zd bytes are available.\n",
                tierRequiredMem, mem);
         return false;
     }
 
-    init_FR(); // If OOM, there is a bug.
-    kTier = tier;
-    tierSize = tier_size(tier);
-    omp_init_lock(&nUndChildLock);
-    game_init_board(&board);
+    ts->tier = tier;
+    ts->tierSize = tier_size(tier);
+    ts->partitionBits = PARENT_PARTITION_BITS;
+    if (ts->mode == TIERSOLVER_MODE_SPILL) {
+        ts->partitionBits = spill_partition_bits(ts->tierSize, mem, omp_get_max_threads());
+        printf("tiersolver_solve_tier: solving tier %s out of core in partitions "
+               "of %" PRIu64 " positions.\n", tier, (uint64_t)1 << ts->partitionBits);
+    }
+    ts->nPartitions = ((ts->tierSize - 1) >> ts->partitionBits) + 1;
+    game_init_board(&ts->board);
     return true;
 }
 
-static bool solve_tier_step_1_0_load_canonical_helper(uint8_t childIdx) {
-    bool success = true, loadFRSuccess = true;
-    uint64_t childTierSize = tier_size(childTiers.tiers[childIdx]);
-    values = db_load_tier(childTiers.tiers[childIdx], childTierSize);
-    if (!values) return false; // OOM.
+/* A child tier as it is stored on disk, together with a reader for it.
+   The reader is only opened if the tier is not cached, in which case only
+   its block geometry and layout are set. */
+typedef struct ChildTierSource {
+    struct TierListElem *stored; // Canonical tier under which the child is stored.
+    bool canonical;              // True if the child tier is itself canonical.
+    tier_reader_t reader;
+    uint64_t fileBytes;          // Size of the stored tier file.
+    uint64_t firstBlock;         // Index of the child's first block among all child blocks.
+    const uint16_t *cached;      // Values of the stored tier if cached, NULL otherwise.
+    uint16_t *caching;           // Copy of the values being read for the cache, or NULL.
+} child_source_t;
 
-    /* Scan child tier and load winning/losing positions into frontier. */
-    #pragma omp parallel for
-    for (uint64_t hash = 0; hash < childTierSize; ++hash) {
-        loadFRSuccess = check_and_load_frontier(childIdx, hash, values[hash]);
-        #pragma omp atomic
-        success &= loadFRSuccess;
+/* Closes the first N of SOURCES. Child tiers read in full are inserted
+   into the cache if LOADED is true. */
+static void destroy_child_sources(tier_solver_t *ts, child_source_t *sources, uint8_t n, bool loaded) {
+    for (uint8_t i = 0; i < n; ++i) {
+        if (sources[i].reader.offsets) db_close_tier_reader(&sources[i].reader);
+        if (sources[i].cached) tier_cache_release(sources[i].stored->tier);
+        if (sources[i].caching && loaded) {
+            tier_cache_insert(sources[i].stored->tier, sources[i].caching, sources[i].reader.tierSize,
+                              sources[i].reader.layout, sources[i].fileBytes);
+        } else if (sources[i].caching) {
+            tier_cache_free(sources[i].caching);
+        }
+        free(sources[i].stored);
     }
-    free(values); values = NULL;
-    return success;
+    memtrack_free(&ts->mem, sources);
+}
+
+/**
+ * @brief Opens all child tiers for block-wise reading and returns an array
+ * of child sources, or NULL if OOM. Sets *NBLOCKS to the total number of
+ * blocks and *MAXBLOCKSIZE to the size of the largest block in values.
+ * Child tiers found in the tier cache are read from there, and the others
+ * are copied into it as they are read if it has room.
+ */
+static child_source_t *init_child_sources(tier_solver_t *ts, uint64_t *nBlocks,
+                                          uint64_t *maxBlockSize) {
+    child_source_t *sources = (child_source_t*)memtrack_calloc(&ts->mem, ts->childTiers.size,
+                                                               sizeof(child_source_t));
+    if (!sources) return NULL;
+    *nBlocks = *maxBlockSize = 0;
+    for (uint8_t childIdx = 0; childIdx < ts->childTiers.size; ++childIdx) {
+        child_source_t *src = sources + childIdx;
+        src->stored = tier_get_canonical_tier(ts->childTiers.tiers[childIdx]);
+        if (!src->stored) {
+            destroy_child_sources(ts, sources, childIdx + 1, false);
+            return NULL;
+        }
+        uint64_t childSize = tier_size(src->stored->tier);
+        src->cached = tier_cache_acquire(src->stored->tier, &src->reader.layout, &src->fileBytes);
+        if (src->cached) {
+            /* Cached values are sliced into blocks without touching the file. */
+            src->reader.tierSize = childSize;
+            src->reader.blockSize = DB_TIER_BLOCK_VALUES;
+            src->reader.nBlocks = (childSize + DB_TIER_BLOCK_VALUES - 1) / DB_TIER_BLOCK_VALUES;
+        } else if (db_open_tier_reader(&src->reader, src->stored->tier, childSize, &ts->mem)) {
+            src->fileBytes = src->reader.offsets[src->reader.nBlocks] - src->reader.offsets[0];
+            ts->telemetry.bytesRead += src->fileBytes;
+            src->caching = tier_cache_alloc(childSize);
+        } else {
+            destroy_child_sources(ts, sources, childIdx + 1, false);
+            return NULL;
+        }
+        tier_cache_record_read(src->cached != NULL, src->fileBytes);
+        src->canonical = !strncmp(src->stored->tier, ts->childTiers.tiers[childIdx], TIER_STR_LENGTH_MAX);
+        src->firstBlock = *nBlocks;
+        *nBlocks += src->reader.nBlocks;
+        ts->telemetry.childPositions += childSize;
+        if (src->reader.blockSize > *maxBlockSize) *maxBlockSize = src->reader.blockSize;
+    }
+    return sources;
 }
 
-static bool solve_tier_step_1_1_load_noncanonical_helper(uint8_t childIdx) {
-    bool success = true, loadFRSuccess = true;
-    struct TierListElem *canonicalTier = tier_get_canonical_tier(childTiers.tiers[childIdx]);
-    if (!canonicalTier) return false; // OOM.
-    uint64_t childTierSize = tier_size(canonicalTier->tier);
-    values = db_load_tier(canonicalTier->tier, childTierSize);
-    if (!values) return false; // OOM.
+/* Stores the offsets of the decided values, which are neither reserved
+   nor draws, among the SIZE values of BLOCK in OFFSETS and returns their
+   number. SIZE must not exceed CLASSIFY_CHUNK_SIZE. */
+static uint16_t find_decided_scalar(const uint16_t *block, uint16_t size, uint16_t *offsets) {
+    uint16_t n = 0;
+    for (uint16_t j = 0; j < size; ++j) {
+        offsets[n] = j;
+        n += (block[j] && block[j] != DRAW_VALUE);
+    }
+    return n;
+}
 
-    /* Scan child tier and load winning/losing positions into frontier. */
-    #pragma omp parallel for firstprivate(board)
-    for (uint64_t hash = 0; hash < childTierSize; ++hash) {
-        /* No need to convert hash if position does not need to be loaded. */
-        if (!values[hash] || values[hash] == DRAW_VALUE) continue;
+#if defined(__x86_64__)
+/* Same as find_decided_scalar, classifying 16 values per instruction. */
+__attribute__((target("avx2")))
+static uint16_t find_decided_avx2(const uint16_t *block, uint16_t size, uint16_t *offsets) {
+    const __m256i reserved = _mm256_setzero_si256();
+    const __m256i draw = _mm256_set1_epi16((short)DRAW_VALUE);
+    uint16_t n = 0, j = 0;
+    for (; j + 16 <= size; j += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(block + j));
+        __m256i skip = _mm256_or_si256(_mm256_cmpeq_epi16(v, reserved), _mm256_cmpeq_epi16(v, draw));
+        /* Two mask bits per value, keep the lower one of each. */
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(skip) & 0x55555555U;
+        while (mask) {
+            offsets[n++] = j + (__builtin_ctz(mask) >> 1);
+            mask &= mask - 1;
+        }
+    }
+    uint16_t tail = find_decided_scalar(block + j, size - j, offsets + n);
+    for (uint16_t k = n; k < n + tail; ++k) offsets[k] += j;
+    return n + tail;
+}
+#endif
 
-        uint64_t noncanonicalHash = game_get_noncanonical_hash(
-            canonicalTier->tier, hash, childTiers.tiers[childIdx], &board);
-        loadFRSuccess = check_and_load_frontier(childIdx, noncanonicalHash, values[hash]);
-        #pragma omp atomic
-        success &= loadFRSuccess;
+static uint16_t find_decided(const uint16_t *block, uint16_t size, uint16_t *offsets) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return find_decided_avx2(block, size, offsets);
+#endif
+    return find_decided_scalar(block, size, offsets);
+}
+
+/**
+ * @brief Inserts the winning/losing positions of BLOCK, the I-th block
+ * of child tier CHILDIDX, into the child tier's frontier segments. If the
+ * child tier is not canonical, hashes are converted from the stored
+ * canonical tier to the child tier.
+ */
+static bool load_child_block(tier_solver_t *ts, const child_source_t *src, uint8_t childIdx, uint64_t i,
+                             const uint16_t *block, uint64_t size, board_t *board) {
+    bool success = true;
+    uint16_t offsets[CLASSIFY_CHUNK_SIZE];
+    uint64_t begin = i * src->reader.blockSize;
+    for (uint64_t chunk = 0; chunk < size; chunk += CLASSIFY_CHUNK_SIZE) {
+        /* Most child positions are reserved or draws and need not be loaded,
+           so decided values are picked out before converting any hash. */
+        uint16_t chunkSize = (size - chunk < CLASSIFY_CHUNK_SIZE) ? size - chunk : CLASSIFY_CHUNK_SIZE;
+        uint16_t nDecided = find_decided(block + chunk, chunkSize, offsets);
+        for (uint16_t k = 0; k < nDecided; ++k) {
+            uint64_t j = chunk + offsets[k];
+            uint64_t hash = db_layout_hash(src->reader.layout, src->reader.tierSize, begin + j);
+            if (!src->canonical) {
+                hash = game_get_noncanonical_hash(src->stored->tier, hash,
+                                                  ts->childTiers.tiers[childIdx], board);
+            }
+            success &= check_and_load_frontier(ts, childIdx, hash, block[j]);
+        }
     }
-    free(canonicalTier); canonicalTier = NULL;
-    free(values); values = NULL;
     return success;
 }
 
-static bool solve_tier_step_1_load_children(void) {
+static bool solve_tier_step_1_load_children(tier_solver_t *ts) {
     /* STEP 1: LOAD ALL WINNING/LOSING POSITIONS FROM
        ALL CHILD TIERS INTO FRONTIER. */
     bool success = true;
+    uint64_t nBlocks, maxBlockSize;
+
+    ts->childTiers = tier_get_child_tier_array(ts->tier); // If OOM, there is a bug.
+    if (!init_FR(ts, ts->childTiers.size)) return false; // OOM.
+    if (!ts->childTiers.size) return true;
+    child_source_t *sources = init_child_sources(ts, &nBlocks, &maxBlockSize);
+    if (!sources) return false; // OOM.
 
-    childTiers = tier_get_child_tier_array(kTier); // If OOM, there is a bug.
-    init_dividers(childTiers.size); // If OOM, there is a bug.
+    /* Each child tier fills its own frontier segments, so the blocks of
+       all child tiers can be streamed in and inserted concurrently. */
+    #pragma omp parallel
+    {
+        bool loadFRSuccess = true;
+        uint16_t *block = NULL;
+        uint8_t childIdx = 0;
+        board_t localBoard;
+        game_init_board(&localBoard);
 
-    /* Child tiers must be processed in series, otherwise the frontier
-       dividers wouldn't work. */
-    for (uint8_t childIdx = 0; childIdx < childTiers.size; ++childIdx) {
-        /* Load child tier from disk */
-        bool childIsCanonical = tier_is_canonical_tier(childTiers.tiers[childIdx]);
-        if (childIsCanonical) success = solve_tier_step_1_0_load_canonical_helper(childIdx);
-        else success = solve_tier_step_1_1_load_noncanonical_helper(childIdx);
-        if (!success) return false;
+        #pragma omp for schedule(dynamic)
+        for (uint64_t i = 0; i < nBlocks; ++i) {
+            if (!loadFRSuccess) continue;
+            /* Find the child tier that owns block I. */
+            while (childIdx + 1 < ts->childTiers.size && sources[childIdx + 1].firstBlock <= i) ++childIdx;
+            while (sources[childIdx].firstBlock > i) --childIdx;
+            const child_source_t *src = sources + childIdx;
+            uint64_t begin = (i - src->firstBlock) * src->reader.blockSize;
+            const uint16_t *values;
+            uint64_t size;
+
+            if (src->cached) {
+                values = src->cached + begin;
+                size = (src->reader.tierSize - begin < src->reader.blockSize) ?
+                       src->reader.tierSize - begin : src->reader.blockSize;
+            } else {
+                if (!block) block = (uint16_t*)memtrack_malloc(&ts->mem, maxBlockSize * sizeof(uint16_t));
+                size = block ? db_read_tier_block(&src->reader, i - src->firstBlock, block) : 0;
+                if (size && src->caching) memcpy(src->caching + begin, block, size * sizeof(uint16_t));
+                values = block;
+            }
+            if (!size) { // OOM.
+                loadFRSuccess = false;
+                continue;
+            }
+            loadFRSuccess = load_child_block(ts, src, childIdx, i - src->firstBlock,
+                                             values, size, &localBoard);
+        }
+        memtrack_free(&ts->mem, block);
+        #pragma omp atomic
+        success &= loadFRSuccess;
     }
-    return true;
+    destroy_child_sources(ts, sources, ts->childTiers.size, success);
+    return success;
 }
 
-static bool solve_tier_step_2_setup_solver_arrays(void) {
+/* Applies the NUMA policy and huge page advice set by tiersolver_set_placement
+   to the whole pages inside the block ARRAY of SIZE bytes. Must be called
+   before any page of ARRAY is touched. Failures are ignored as both are
+   only hints, e.g. on kernels without NUMA or transparent huge pages. */
+static void advise_solver_array(void *array, uint64_t size) {
+    uint64_t align = arrayHugePages ? HUGE_PAGE_SIZE : (uint64_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)array + align - 1) & ~(uintptr_t)(align - 1);
+    uintptr_t end = ((uintptr_t)array + size) & ~(uintptr_t)(align - 1);
+    if (end <= begin) return;
+
+    if (arrayHugePages) madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+    if (arrayPlacement == TIERSOLVER_PLACE_INTERLEAVE) {
+        /* Nodes that do not exist or are not allowed are masked out by the kernel. */
+        unsigned long allNodes = ~0UL;
+        syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE, &allNodes,
+                sizeof(allNodes) * 8, 0);
+    }
+}
+
+/* Sets up one partition of the solver arrays, the update streams of all
+   partitions and the scratch file that holds the solver arrays. Also
+   writes out the child positions buffered by the frontiers in step 1. */
+static bool setup_spilled_arrays(tier_solver_t *ts) {
+    uint64_t base, partitionSize = partition_range(ts, 0, &base);
+    ts->values = (uint16_t*)memtrack_malloc(&ts->mem, partitionSize * sizeof(uint16_t));
+    ts->nUndChild = (uint8_t*)memtrack_malloc(&ts->mem, partitionSize * sizeof(uint8_t));
+    ts->records = (uint64_t*)memtrack_malloc(&ts->mem, SPILL_READ_RECORDS * sizeof(uint64_t));
+    ts->updates = (spill_stream_t*)memtrack_calloc(&ts->mem, 2 * ts->nPartitions, sizeof(spill_stream_t));
+    if (!ts->values || !ts->nUndChild || !ts->records || !ts->updates) return false;
+    for (uint64_t i = 0; i < 2 * ts->nPartitions; ++i) {
+        char name[48];
+        sprintf(name, "spill.update.%" PRIu64 ".%s", i >> 1, (i & 1) ? "win" : "lose");
+        spill_stream_init(&ts->updates[i], db_get_scratch_filename(ts->tier, name),
+                          SPILL_UPDATE_BUFFER_RECORDS, &ts->mem);
+    }
+    ts->arraysFilename = db_get_scratch_filename(ts->tier, "spill.arrays");
+    ts->arraysFd = open(ts->arraysFilename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ts->arraysFd < 0) return false;
+    return spill_frontier_flush(&ts->spillWinFR) && spill_frontier_flush(&ts->spillLoseFR);
+}
+
+static bool solve_tier_step_2_setup_solver_arrays(tier_solver_t *ts) {
     /* STEP 2: SET UP SOLVER ARRAYS. */
-    values = (uint16_t*)calloc(tierSize, sizeof(uint16_t));
-    nUndChild = (uint8_t*)calloc(tierSize, sizeof(uint8_t));
-    return values && nUndChild;
+    if (ts->mode == TIERSOLVER_MODE_SPILL) return setup_spilled_arrays(ts);
+    if (arrayPlacement == TIERSOLVER_PLACE_CALLOC) {
+        /* Large blocks are mapped by calloc without being touched,
+           so the advice still applies to them. */
+        ts->values = (uint16_t*)memtrack_calloc(&ts->mem, ts->tierSize, sizeof(uint16_t));
+        ts->nUndChild = (uint8_t*)memtrack_calloc(&ts->mem, ts->tierSize, sizeof(uint8_t));
+        if (!ts->values || !ts->nUndChild) return false;
+        advise_solver_array(ts->values, ts->tierSize * sizeof(uint16_t));
+        advise_solver_array(ts->nUndChild, ts->tierSize * sizeof(uint8_t));
+        return true;
+    }
+    ts->values = (uint16_t*)memtrack_malloc(&ts->mem, ts->tierSize * sizeof(uint16_t));
+    ts->nUndChild = (uint8_t*)memtrack_malloc(&ts->mem, ts->tierSize * sizeof(uint8_t));
+    if (!ts->values || !ts->nUndChild) return false;
+    advise_solver_array(ts->values, ts->tierSize * sizeof(uint16_t));
+    advise_solver_array(ts->nUndChild, ts->tierSize * sizeof(uint8_t));
+
+    /* Zero both arrays with the same static schedule as step 5 so that
+       under first-touch placement each thread's range of positions is
+       allocated on the NUMA node of the thread that later scans it.
+       Step 3 hands out positions dynamically instead, as its cost per
+       position is dominated by move generation rather than memory. */
+    #pragma omp parallel for schedule(static)
+    for (uint64_t idx = 0; idx < ts->tierSize; ++idx) {
+        ts->values[idx] = 0;
+        ts->nUndChild[idx] = 0;
+    }
+    return true;
 }
 
-static bool solve_tier_step_3_scan_tier(void) {
+/* Scans the N positions of TIER starting at index BASE, whose entries of
+   the solver arrays are at the start of VALUES and NUNDCHILD. Must be
+   called by all threads of the enclosing parallel region. Returns false
+   on the calling thread if it ran out of memory. */
+static bool scan_positions(tier_solver_t *ts, uint64_t base, uint64_t n, board_t *board) {
+    bool success = true;
+
+    /* Illegal hashes are rejected right after unhashing while legal
+       positions go through full move generation, so positions are
+       handed out in small chunks to whichever thread is free. */
+    #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) nowait
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t hash = pos_hash(ts, base + i);
+        ts->nUndChild[i] = game_num_child_pos(ts->tier, hash, board);
+        success &= (ts->nUndChild[i] != ILLEGAL_NUM_CHILD_POS_OOM);
+        /* If no children, position is primitive lose. Add it to frontier. */
+        if (!ts->nUndChild[i]) {
+            ts->values[i] = 1;
+            success &= add_own_pos(ts, &ts->loseFR, hash, 0);
+        }
+    }
+    return success;
+}
+
+static bool solve_tier_step_3_scan_tier(tier_solver_t *ts) {
     /* STEP 3: COUNT NUMBER OF CHILDREN OF ALL POSITIONS IN
      * CURRENT TIER AND LOAD PRIMITIVE POSITIONS INTO FRONTIER. */
+    const bool spill = (ts->mode == TIERSOLVER_MODE_SPILL);
+    board_t board = ts->board;
     bool success = true;
 
-    #pragma omp parallel for firstprivate(board)
-    for (uint64_t hash = 0; hash < tierSize; ++hash) {
-        nUndChild[hash] = game_num_child_pos(kTier, hash, &board);
-        success &= (nUndChild[hash] != ILLEGAL_NUM_CHILD_POS_OOM);
-        /* If no children, position is primitive lose. Add it to frontier. */
-        if (!nUndChild[hash]) {
-            values[hash] = 1;
-            success &= frontier_add(&loseFR, hash, 0);
+    #pragma omp parallel firstprivate(board)
+    {
+        double start = omp_get_wtime(), busy = 0.0, idle = 0.0;
+        bool scanSuccess = true;
+        if (!spill) {
+            scanSuccess = scan_positions(ts, 0, ts->tierSize, &board);
+        } else {
+            /* In spill mode, each partition is scanned and then stored. */
+            for (uint64_t p = 0; p < ts->nPartitions; ++p) {
+                uint64_t base, n = partition_range(ts, p, &base);
+                #pragma omp single
+                {
+                    memset(ts->values, 0, n * sizeof(uint16_t));
+                    memset(ts->nUndChild, 0, n * sizeof(uint8_t));
+                }
+                scanSuccess &= scan_positions(ts, base, n, &board);
+                load_barrier(start, &busy, &idle);
+                start = omp_get_wtime();
+                #pragma omp single
+                scanSuccess &= transfer_partition(ts, p, true, false);
+            }
         }
+        if (!scanSuccess) {
+            #pragma omp atomic write
+            success = false;
+        }
+        load_barrier(start, &busy, &idle);
+        thread_load_add(&ts->telemetry.step3Load, busy, idle);
     }
     return success;
 }
 
-static uint8_t update_child_idx(uint8_t childIdx, uint64_t **divider, uint16_t rmt, uint64_t i) {
-    while (childIdx < childTiers.size) {
-        if (i < divider[rmt][childIdx]) break;
-        ++childIdx;
+/**
+ * @brief Enables checkpointing of tiers being solved into directory DIR,
+ * or disables it if DIR is NULL. While a tier is in step 4, its state is
+ * saved at the first remoteness level boundary at least INTERVAL seconds
+ * after the previous checkpoint. Also clears any pending stop request.
+ */
+void tiersolver_set_checkpoint(const char *dir, double interval) {
+    free(checkpointDir);
+    checkpointDir = dir ? strdup(dir) : NULL;
+    checkpointInterval = interval;
+    stopRequested = 0;
+}
+
+/**
+ * @brief Sets how the values and number-of-undecided-children arrays of
+ * tiers solved from now on are placed in memory. PLACEMENT is one of
+ * enum tiersolver_placement. If HUGEPAGES is true, the arrays are also
+ * advised to be backed by transparent huge pages.
+ */
+void tiersolver_set_placement(int placement, bool hugePages) {
+    arrayPlacement = placement;
+    arrayHugePages = hugePages;
+}
+
+/**
+ * @brief Sets how parents of frontier positions are updated in step 4 of
+ * tiers solved from now on. PROPAGATION is one of enum
+ * tiersolver_propagation.
+ */
+void tiersolver_set_propagation(int propagation) {
+    parentPropagation = propagation;
+}
+
+/**
+ * @brief Sets whether each segment of each frontier level is sorted by
+ * hash before it is processed in step 4 of tiers solved from now on.
+ */
+void tiersolver_set_sorted_frontier(bool sorted) {
+    sortFrontier = sorted;
+}
+
+/**
+ * @brief Restricts tiers solved from now on to solver MODE, one of enum
+ * tiersolver_mode, which must still fit into the memory budget. Passing
+ * TIERSOLVER_MODE_NONE lets admission control choose the mode again.
+ */
+void tiersolver_set_mode(int mode) {
+    forcedMode = mode;
+}
+
+/**
+ * @brief Asks all tiers being solved to write a final checkpoint at the
+ * next remoteness level boundary and stop. Tiers that have not reached
+ * step 4 stop without a checkpoint, and no further tiers are started.
+ * Ignored if checkpointing is disabled. This function is async-signal-safe and meant to be called
+ * from a signal handler.
+ */
+void tiersolver_request_stop(void) {
+    stopRequested = 1;
+}
+
+/* Returns true if solving was stopped by tiersolver_request_stop. */
+bool tiersolver_stop_requested(void) {
+    return checkpointDir && stopRequested;
+}
+
+static char *get_checkpoint_filename(const char *tier, bool tmp) {
+    char *filename = (char*)safe_malloc(strlen(checkpointDir) + TIER_STR_LENGTH_MAX + 16);
+    sprintf(filename, "%s/%s.ckpt%s", checkpointDir, tier, tmp ? ".tmp" : "");
+    return filename;
+}
+
+static bool write_frontier_checkpoint(FILE *fp, const fr_t *frontier, uint16_t startRmt) {
+    uint64_t levelsEnd = frontier->levelsEnd;
+    if (fwrite(&levelsEnd, sizeof(uint64_t), 1, fp) != 1) return false;
+    for (uint16_t rmt = startRmt; rmt < levelsEnd; ++rmt) {
+        const fr_level_t *level = frontier->levels[rmt];
+        for (uint16_t seg = 0; seg < frontier->nSegments; ++seg) {
+            uint64_t size = level ? level->sizes[seg] : 0;
+            if (fwrite(&size, sizeof(uint64_t), 1, fp) != 1) return false;
+            if (size && fwrite(level->buckets[seg], sizeof(uint64_t), size, fp) != size) return false;
+        }
     }
-    return childIdx;
+    return true;
 }
 
-static bool solve_tier_step_4_push_frontier_up(void) {
-    /* STEP 4: PUSH FRONTIER UP. */
+static bool read_frontier_checkpoint(FILE *fp, fr_t *frontier, uint16_t startRmt) {
+    uint64_t levelsEnd, size, hash;
+    if (fread(&levelsEnd, sizeof(uint64_t), 1, fp) != 1 || levelsEnd > frontier->size) return false;
+    for (uint16_t rmt = startRmt; rmt < levelsEnd; ++rmt) {
+        for (uint16_t seg = 0; seg < frontier->nSegments; ++seg) {
+            if (fread(&size, sizeof(uint64_t), 1, fp) != 1) return false;
+            for (uint64_t i = 0; i < size; ++i) {
+                if (fread(&hash, sizeof(uint64_t), 1, fp) != 1) return false;
+                if (!frontier_add(frontier, hash, rmt, seg)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Saves the state of TS before processing remoteness level RMT.
+ * The checkpoint is written to a temporary file which is synced to disk
+ * and then renamed over the previous checkpoint, so that a crash at any
+ * point leaves either the old or the new checkpoint intact.
+ * @return true on success, false otherwise.
+ */
+static bool save_checkpoint(tier_solver_t *ts, uint16_t rmt) {
+    char *tmpFilename = get_checkpoint_filename(ts->tier, true);
+    char *filename = get_checkpoint_filename(ts->tier, false);
+    uint64_t header[5] = {ts->tierSize, ts->childTiers.size + 1ULL, rmt, ts->mode, ts->ownLevelsEnd};
+    bool success = false;
+
+    mkdir(checkpointDir, 0777);
+    FILE *fp = fopen(tmpFilename, "wb");
+    if (!fp) goto _bailout;
+    success = fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGIC_LENGTH, fp) == CHECKPOINT_MAGIC_LENGTH &&
+              fwrite(header, sizeof(uint64_t), 5, fp) == 5 &&
+              fwrite(&ts->stat, sizeof(ts->stat), 1, fp) == 1 &&
+              fwrite(ts->values, sizeof(uint16_t), ts->tierSize, fp) == ts->tierSize &&
+              fwrite(ts->nUndChild, sizeof(uint8_t), ts->tierSize, fp) == ts->tierSize &&
+              write_frontier_checkpoint(fp, &ts->loseFR, rmt) &&
+              write_frontier_checkpoint(fp, &ts->winFR, rmt) &&
+              fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGIC_LENGTH, fp) == CHECKPOINT_MAGIC_LENGTH &&
+              !fflush(fp) && !fsync(fileno(fp));
+    success &= !fclose(fp);
+    success = success && !rename(tmpFilename, filename);
+
+_bailout:
+    if (!success) {
+        printf("save_checkpoint: failed to save checkpoint for tier %s "
+               "at remoteness %d\n", ts->tier, rmt);
+        remove(tmpFilename);
+    } else {
+        printf("save_checkpoint: saved checkpoint for tier %s at remoteness %d\n",
+               ts->tier, rmt);
+    }
+    free(tmpFilename);
+    free(filename);
+    return success;
+}
+
+static void reset_solver_data(tier_solver_t *ts) {
+    destroy_FR(ts);
+    tier_array_destroy(&ts->childTiers);
+    memtrack_free(&ts->mem, ts->nUndChild); ts->nUndChild = NULL;
+    memtrack_free(&ts->mem, ts->values); ts->values = NULL;
+    init_solver_stat(&ts->stat);
+}
+
+/**
+ * @brief Restores the state of TS from its checkpoint if one exists.
+ * Replaces steps 1 to 3 of the solver.
+ * @return true if TS was restored, false if there is no usable checkpoint,
+ * in which case TS is left as it was after step 0.
+ */
+static bool load_checkpoint(tier_solver_t *ts) {
+    /* Spill mode does not checkpoint. */
+    if (!checkpointDir || ts->mode == TIERSOLVER_MODE_SPILL) return false;
+    char *filename = get_checkpoint_filename(ts->tier, false);
+    FILE *fp = fopen(filename, "rb");
+    free(filename);
+    if (!fp) return false;
+
+    char magic[CHECKPOINT_MAGIC_LENGTH];
+    uint64_t header[5];
+    ts->childTiers = tier_get_child_tier_array(ts->tier); // If OOM, there is a bug.
+    bool success = init_FR(ts, ts->childTiers.size) &&
+                   fread(magic, 1, CHECKPOINT_MAGIC_LENGTH, fp) == CHECKPOINT_MAGIC_LENGTH &&
+                   !memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH) &&
+                   fread(header, sizeof(uint64_t), 5, fp) == 5 &&
+                   header[0] == ts->tierSize &&
+                   header[1] == ts->childTiers.size + 1ULL &&
+                   header[2] < FR_SIZE &&
+                   header[3] == (uint64_t)ts->mode &&
+                   header[4] <= FR_SIZE &&
+                   fread(&ts->stat, sizeof(ts->stat), 1, fp) == 1 &&
+                   solve_tier_step_2_setup_solver_arrays(ts) &&
+                   fread(ts->values, sizeof(uint16_t), ts->tierSize, fp) == ts->tierSize &&
+                   fread(ts->nUndChild, sizeof(uint8_t), ts->tierSize, fp) == ts->tierSize &&
+                   read_frontier_checkpoint(fp, &ts->loseFR, header[2]) &&
+                   read_frontier_checkpoint(fp, &ts->winFR, header[2]) &&
+                   fread(magic, 1, CHECKPOINT_MAGIC_LENGTH, fp) == CHECKPOINT_MAGIC_LENGTH &&
+                   !memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH);
+    fclose(fp);
+    if (!success) {
+        printf("load_checkpoint: ignoring unusable checkpoint for tier %s\n", ts->tier);
+        reset_solver_data(ts);
+        return false;
+    }
+    ts->startRmt = header[2];
+    ts->ownLevelsEnd = header[4];
+    printf("load_checkpoint: resuming tier %s at remoteness %d\n", ts->tier, ts->startRmt);
+    return true;
+}
+
+static void remove_checkpoint(const char *tier) {
+    if (!checkpointDir) return;
+    char *filename = get_checkpoint_filename(tier, false);
+    remove(filename);
+    free(filename);
+}
+
+/**
+ * @brief Writes a checkpoint of TS before remoteness level RMT if one is
+ * due, either periodically or because a stop was requested.
+ * @return true if the solver should stop.
+ */
+static bool checkpoint_level_boundary(tier_solver_t *ts, uint16_t rmt) {
+    if (!checkpointDir) return false;
+    bool stop = stopRequested;
+    if (stop || omp_get_wtime() - ts->lastCheckpoint >= checkpointInterval) {
+        save_checkpoint(ts, rmt);
+        ts->lastCheckpoint = omp_get_wtime();
+    }
+    return stop;
+}
+
+static const char *segment_tier(const tier_solver_t *ts, uint16_t seg) {
+    return (seg < ts->childTiers.size) ? ts->childTiers.tiers[seg] : ts->tier;
+}
+
+static tier_change_t segment_change(const tier_solver_t *ts, uint16_t seg) {
     const tier_change_t noChange = {INVALID_IDX, -1, INVALID_IDX, -1};
+    return (seg < ts->childTiers.size) ? ts->childTiers.changes[seg] : noChange;
+}
+
+/* Records the number of losing and winning positions at remoteness RMT.
+   Telemetry is best-effort and stops recording levels if OOM. */
+static void record_level_sizes(tier_solver_t *ts, uint16_t rmt, uint64_t nLose, uint64_t nWin) {
+    tier_telemetry_t *t = &ts->telemetry;
+    if (rmt >= t->levelsCapacity) {
+        uint16_t capacity = t->levelsCapacity ? t->levelsCapacity : 64;
+        while (capacity <= rmt) capacity <<= 1;
+        uint64_t *loseSizes = (uint64_t*)memtrack_realloc(&ts->mem, t->loseSizes, capacity * sizeof(uint64_t));
+        if (loseSizes) t->loseSizes = loseSizes;
+        uint64_t *winSizes = (uint64_t*)memtrack_realloc(&ts->mem, t->winSizes, capacity * sizeof(uint64_t));
+        if (winSizes) t->winSizes = winSizes;
+        if (!loseSizes || !winSizes) return;
+        memset(t->loseSizes + t->levelsCapacity, 0, (capacity - t->levelsCapacity) * sizeof(uint64_t));
+        memset(t->winSizes + t->levelsCapacity, 0, (capacity - t->levelsCapacity) * sizeof(uint64_t));
+        t->levelsCapacity = capacity;
+    }
+    t->loseSizes[rmt] = nLose;
+    t->winSizes[rmt] = nWin;
+    t->nLevels = rmt + 1;
+    t->step4Positions += nLose + nWin;
+}
+
+static void update_win_stat(tier_solver_t *ts, uint64_t hash, uint16_t rmt) {
+    bool blackTurn = game_is_black_turn(hash);
+    if (blackTurn && ts->stat.longestNumStepsToBlackWin < rmt) {
+        ts->stat.longestNumStepsToBlackWin = rmt;
+        ts->stat.longestPosToBlackWin = hash;
+    } else if (!blackTurn && ts->stat.longestNumStepsToRedWin < rmt) {
+        ts->stat.longestNumStepsToRedWin = rmt;
+        ts->stat.longestPosToRedWin = hash;
+    }
+}
+
+/* In blocked propagation, the frontier of each remoteness level is processed
+   in rounds. In each round, every thread first generates the parents of its
+   share of frontier positions into its own buffer and radix-partitions them
+   by index range. After a barrier, each partition is updated by a single
+   thread from the buffers of all threads, so the part of the solver arrays
+   being updated stays in cache and no lock is needed. */
+
+static void destroy_parent_buffers(tier_solver_t *ts) {
+    for (int i = 0; i < ts->nParentBuffers; ++i) {
+        memtrack_free(&ts->mem, ts->parentBuffers[i].raw);
+        memtrack_free(&ts->mem, ts->parentBuffers[i].sorted);
+        memtrack_free(&ts->mem, ts->parentBuffers[i].offsets);
+    }
+    memtrack_free(&ts->mem, ts->parentBuffers);
+    ts->parentBuffers = NULL;
+    ts->nParentBuffers = 0;
+}
+
+static bool init_parent_buffers(tier_solver_t *ts, int nThreads) {
+    ts->parentBuffers = (parent_buffer_t*)memtrack_calloc(&ts->mem, nThreads, sizeof(parent_buffer_t));
+    if (!ts->parentBuffers) return false;
+    ts->nParentBuffers = nThreads;
+    for (int i = 0; i < nThreads; ++i) {
+        ts->parentBuffers[i].offsets = (uint64_t*)memtrack_calloc(
+            &ts->mem, ts->nPartitions + 1, sizeof(uint64_t));
+        if (!ts->parentBuffers[i].offsets) return false;
+    }
+    return true;
+}
+
+/* Appends the indices of the parents of position CHILDPOSHASH in
+   CHILDPOSTIER to BUF. */
+static bool buffer_parents(tier_solver_t *ts, parent_buffer_t *buf, const char *childPosTier,
+                           uint64_t childPosHash, tier_change_t change, board_t *board,
+                           thread_state_t *state) {
+    pos_array_t parents = game_get_parents(childPosTier, childPosHash, ts->tier, change, board, &state->cache);
+    if (parents.size == ILLEGAL_POSITION_ARRAY_SIZE) { // OOM.
+        free(parents.array); parents.array = NULL;
+        return false;
+    }
+    state->parents += parents.size;
+    if (buf->size + parents.size > buf->capacity) {
+        uint64_t capacity = buf->capacity ? buf->capacity << 1 : BLOCKED_ROUND_ENTRIES;
+        while (capacity < buf->size + parents.size) capacity <<= 1;
+        uint64_t *raw = (uint64_t*)memtrack_realloc(&ts->mem, buf->raw, capacity * sizeof(uint64_t));
+        if (!raw) { // OOM.
+            free(parents.array); parents.array = NULL;
+            return false;
+        }
+        buf->raw = raw;
+        buf->capacity = capacity;
+    }
+    for (uint8_t i = 0; i < parents.size; ++i) {
+        buf->raw[buf->size++] = pos_index(ts, parents.array[i]);
+    }
+    free(parents.array); parents.array = NULL;
+    return true;
+}
+
+/* Groups the parents in BUF by partition. If OOM, drops all parents in
+   BUF so that the buffer is still consistent and returns false. */
+static bool partition_parents(tier_solver_t *ts, parent_buffer_t *buf) {
+    uint64_t *offsets = buf->offsets;
+    memset(offsets, 0, (ts->nPartitions + 1) * sizeof(uint64_t));
+    if (!buf->size) return true;
+    uint64_t *sorted = (uint64_t*)memtrack_realloc(&ts->mem, buf->sorted, buf->capacity * sizeof(uint64_t));
+    if (!sorted) {
+        buf->size = 0;
+        return false;
+    }
+    buf->sorted = sorted;
+
+    /* Count, then scatter, then shift the advanced offsets back by one. */
+    for (uint64_t i = 0; i < buf->size; ++i) {
+        ++offsets[(buf->raw[i] >> ts->partitionBits) + 1];
+    }
+    for (uint64_t p = 1; p <= ts->nPartitions; ++p) offsets[p] += offsets[p - 1];
+    for (uint64_t i = 0; i < buf->size; ++i) {
+        sorted[offsets[buf->raw[i] >> ts->partitionBits]++] = buf->raw[i];
+    }
+    memmove(offsets + 1, offsets, ts->nPartitions * sizeof(uint64_t));
+    offsets[0] = 0;
+    return true;
+}
+
+/* Applies the parents in partition P of all threads' buffers. All parents
+   of positions that lose in RMT win in RMT+1. Parents of positions that
+   win in RMT lose in RMT+1 once their last undecided child is decided.
+   The calling thread must be the only one updating partition P. */
+static bool apply_parent_partition(tier_solver_t *ts, uint64_t p, uint16_t rmt, bool lose) {
     bool success = true;
-    uint8_t childIdx = 0;
-
-    accumulate_dividers(childTiers.size);
-    /* Remotenesses must be processed in series. */
-    for (uint16_t rmt = 0; rmt < FR_SIZE; ++rmt) {
-        /* Process loseFR. */
-        childIdx = 0;
-        #pragma omp parallel for firstprivate(board, childIdx)
-        for (uint64_t i = 0; i < loseFR.sizes[rmt]; ++i) {
-            childIdx = update_child_idx(childIdx, loseDivider, rmt, i);
-            if (childIdx < childTiers.size) {
-                success &= process_lose_pos(rmt, childTiers.tiers[childIdx], loseFR.buckets[rmt][i],
-                                            childTiers.changes[childIdx], &board);
-            } else {
-                success &= process_lose_pos(rmt, kTier, loseFR.buckets[rmt][i], noChange, &board);
+    for (int t = 0; t < ts->nParentBuffers; ++t) {
+        const parent_buffer_t *buf = &ts->parentBuffers[t];
+        uint64_t begin = buf->offsets[p], end = buf->offsets[p + 1];
+        for (uint64_t k = begin; k < end; ++k) {
+            if (k + PREFETCH_DISTANCE < end) {
+                __builtin_prefetch(ts->nUndChild + buf->sorted[k + PREFETCH_DISTANCE], 1);
+                __builtin_prefetch(ts->values + buf->sorted[k + PREFETCH_DISTANCE], 1);
+            }
+            uint64_t idx = buf->sorted[k];
+            if (!ts->nUndChild[idx]) continue;
+            if (lose) {
+                ts->nUndChild[idx] = 0;
+                ts->values[idx] = UINT16_MAX - rmt - 1; // Refer to the value table.
+                success &= add_own_pos(ts, &ts->winFR, pos_hash(ts, idx), rmt + 1);
+            } else if (!--ts->nUndChild[idx]) {
+                ts->values[idx] = rmt + 2; // Refer to the value table.
+                success &= add_own_pos(ts, &ts->loseFR, pos_hash(ts, idx), rmt + 1);
             }
         }
-        frontier_free(&loseFR, rmt);
-
-        /* Process winFR. */
-        childIdx = 0;
-        #pragma omp parallel for firstprivate(board, childIdx)
-        for (uint64_t i = 0; i < winFR.sizes[rmt]; ++i) {
-            childIdx = update_child_idx(childIdx, winDivider, rmt, i);
-            if (childIdx < childTiers.size) {
-                success &= process_win_pos(rmt, childTiers.tiers[childIdx], winFR.buckets[rmt][i],
-                                           childTiers.changes[childIdx], &board);
+    }
+    return success;
+}
+
+/* Processes the N positions of frontier LEVEL at remoteness RMT, which lose
+   in RMT if LOSE is true and win in RMT otherwise, in blocked rounds. Must
+   be called by all threads of the enclosing parallel region. Returns false
+   on the calling thread if it ran out of memory. */
+static bool push_frontier_blocked(tier_solver_t *ts, uint16_t rmt, bool lose, uint64_t n,
+                                  const uint64_t *offsets, const fr_level_t *level,
+                                  board_t *board, thread_state_t *state) {
+    const uint16_t nSegments = ts->childTiers.size + 1;
+    const uint64_t roundSize = BLOCKED_ROUND_ENTRIES * (uint64_t)omp_get_num_threads();
+    parent_buffer_t *buf = &ts->parentBuffers[omp_get_thread_num()];
+    bool success = true;
+
+    for (uint64_t begin = 0; begin < n; begin += roundSize) {
+        uint64_t end = (n - begin < roundSize) ? n : begin + roundSize;
+        uint16_t seg = nSegments;
+        double start = omp_get_wtime();
+        buf->size = 0;
+        #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) nowait
+        for (uint64_t i = begin; i < end; ++i) {
+            if (seg == nSegments || i < offsets[seg] || i >= offsets[seg + 1]) {
+                seg = frontier_find_segment(offsets, nSegments, i);
+            }
+            uint64_t hash = level->buckets[seg][i - offsets[seg]];
+            success &= buffer_parents(ts, buf, segment_tier(ts, seg), hash,
+                                      segment_change(ts, seg), board, state);
+            if (!lose && seg == ts->childTiers.size) update_win_stat(ts, hash, rmt);
+        }
+        success &= partition_parents(ts, buf);
+        load_barrier(start, &state->busy, &state->idle);
+        start = omp_get_wtime();
+        #pragma omp for schedule(dynamic, 16) nowait
+        for (uint64_t p = 0; p < ts->nPartitions; ++p) {
+            success &= apply_parent_partition(ts, p, rmt, lose);
+        }
+        load_barrier(start, &state->busy, &state->idle);
+    }
+    return success;
+}
+
+/* Applies the updates of partition P generated from remoteness level RMT,
+   first those from losing and then those from winning positions, as the
+   other modes do. Positions decided here are added to level RMT+1 of the
+   spill frontiers. Must be called by all threads of the team, which
+   apply the records of each read in parallel and share SUCCESS and
+   COUNT. */
+static void apply_spilled_updates(tier_solver_t *ts, uint64_t p, uint16_t rmt, bool *success, uint64_t *count) {
+    uint64_t base;
+    partition_range(ts, p, &base);
+    #pragma omp single
+    {
+        if (!spill_stream_flush(&ts->updates[2 * p]) || !spill_stream_flush(&ts->updates[2 * p + 1])) {
+            *success = false;
+        } else if (ts->updates[2 * p].nRecords || ts->updates[2 * p + 1].nRecords) {
+            *success = transfer_partition(ts, p, false, false);
+        }
+    }
+    if (!*success || (!ts->updates[2 * p].nRecords && !ts->updates[2 * p + 1].nRecords)) return;
+
+    for (int k = 0; k < 2; ++k) {
+        spill_stream_t *stream = &ts->updates[2 * p + k];
+        for (uint64_t offset = 0; offset < stream->nRecords; offset += SPILL_READ_RECORDS) {
+            #pragma omp single
+            {
+                *count = spill_stream_read(stream, offset, ts->records, SPILL_READ_RECORDS);
+                if (!*count) *success = false;
+            }
+            bool applySuccess = true;
+            #pragma omp for schedule(static)
+            for (uint64_t j = 0; j < *count; ++j) {
+                uint64_t idx = ts->records[j], i = idx - base;
+                if (!k) {
+                    if (!__atomic_exchange_n(&ts->nUndChild[i], 0, __ATOMIC_RELAXED)) continue;
+                    ts->values[i] = UINT16_MAX - rmt - 1; // Refer to the value table.
+                    applySuccess &= add_own_pos(ts, &ts->winFR, pos_hash(ts, idx), rmt + 1);
+                } else {
+                    uint8_t remaining = __atomic_load_n(&ts->nUndChild[i], __ATOMIC_RELAXED);
+                    while (remaining && !__atomic_compare_exchange_n(&ts->nUndChild[i], &remaining, remaining - 1,
+                                                                     false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+                    if (remaining != 1) continue;
+                    ts->values[i] = rmt + 2; // Refer to the value table.
+                    applySuccess &= add_own_pos(ts, &ts->loseFR, pos_hash(ts, idx), rmt + 1);
+                }
+            }
+            if (!applySuccess) {
+                #pragma omp atomic write
+                *success = false;
+            }
+        }
+        #pragma omp barrier // No thread may still test the loop condition.
+        #pragma omp single
+        spill_stream_clear(stream);
+    }
+    #pragma omp single
+    if (*success) *success = transfer_partition(ts, p, true, false);
+}
+
+/* Step 4 in spill mode. Each level is read from disk in rounds of
+   SPILL_READ_RECORDS positions whose parents are generated in parallel,
+   grouped by partition and appended to the update streams. Once both
+   levels of a remoteness have been read, the partitions are updated. */
+static bool push_frontier_spilled(tier_solver_t *ts) {
+    if (!init_parent_buffers(ts, omp_get_max_threads())) { // OOM.
+        destroy_parent_buffers(ts);
+        return false;
+    }
+    uint64_t count = 0, nLose = 0, nWin = 0;
+    bool success = true, done = false;
+
+    board_t board = ts->board;
+    #pragma omp parallel firstprivate(board)
+    {
+        thread_state_t state = {0};
+        game_init_unhash_cache(&state.cache);
+        parent_buffer_t *buf = &ts->parentBuffers[omp_get_thread_num()];
+        for (uint16_t rmt = 0; !done; ++rmt) {
+            for (int lose = 1; lose >= 0; --lose) {
+                spill_fr_t *frontier = lose ? &ts->spillLoseFR : &ts->spillWinFR;
+                uint64_t *n = lose ? &nLose : &nWin; // Not changed again before the next level.
+                #pragma omp single
+                {
+                    if (!spill_frontier_flush(frontier)) success = false;
+                    *n = spill_frontier_size(frontier, rmt);
+                }
+                for (uint64_t offset = 0; offset < *n; offset += SPILL_READ_RECORDS) {
+                    #pragma omp single
+                    {
+                        count = spill_frontier_read(frontier, rmt, offset, ts->records, SPILL_READ_RECORDS);
+                        if (!count) success = false;
+                    }
+                    double start = omp_get_wtime();
+                    bool bufferSuccess = true;
+                    buf->size = 0;
+                    #pragma omp for schedule(dynamic, 64) nowait
+                    for (uint64_t i = 0; i < count; ++i) {
+                        uint16_t seg = spill_record_seg(ts->records[i]);
+                        uint64_t hash = spill_record_hash(ts->records[i]);
+                        bufferSuccess &= buffer_parents(ts, buf, segment_tier(ts, seg), hash,
+                                                        segment_change(ts, seg), &board, &state);
+                        if (!lose && seg == ts->childTiers.size) update_win_stat(ts, hash, rmt);
+                    }
+                    bufferSuccess &= partition_parents(ts, buf);
+                    for (uint64_t p = 0; p < ts->nPartitions; ++p) {
+                        uint64_t begin = buf->offsets[p], end = buf->offsets[p + 1];
+                        if (begin == end) continue;
+                        bufferSuccess &= spill_stream_append(&ts->updates[2 * p + !lose], buf->sorted + begin,
+                                                             end - begin);
+                    }
+                    if (!bufferSuccess) {
+                        #pragma omp atomic write
+                        success = false;
+                    }
+                    load_barrier(start, &state.busy, &state.idle);
+                }
+            }
+
+            for (uint64_t p = 0; p < ts->nPartitions && success; ++p) {
+                apply_spilled_updates(ts, p, rmt, &success, &count);
+            }
+            #pragma omp single
+            {
+                spill_frontier_free(&ts->spillLoseFR, rmt);
+                spill_frontier_free(&ts->spillWinFR, rmt);
+                record_level_sizes(ts, rmt, nLose, nWin);
+                done = !success || rmt + 1 >= FR_SIZE ||
+                       (rmt + 1 >= ts->spillLoseFR.levelsEnd && rmt + 1 >= ts->spillWinFR.levelsEnd);
+            }
+        }
+        #pragma omp atomic
+        ts->telemetry.parents += state.parents;
+        #pragma omp atomic
+        ts->telemetry.unhashSteps += state.cache.nSteps;
+        #pragma omp atomic
+        ts->telemetry.unhashStepsReused += state.cache.nStepsReused;
+        thread_load_add(&ts->telemetry.step4Load, state.busy, state.idle);
+    }
+    destroy_parent_buffers(ts);
+    if (!success) return false;
+    destroy_FR(ts);
+    tier_array_destroy(&ts->childTiers);
+    return true;
+}
+
+static bool solve_tier_step_4_push_frontier_up(tier_solver_t *ts) {
+    /* STEP 4: PUSH FRONTIER UP. */
+    if (ts->mode == TIERSOLVER_MODE_SPILL) return push_frontier_spilled(ts);
+    const uint16_t nSegments = ts->childTiers.size + 1;
+    const bool compact = (ts->mode == TIERSOLVER_MODE_COMPACT);
+    const bool blocked = (parentPropagation == TIERSOLVER_PROPAGATE_BLOCKED);
+    const tier_change_t noChange = segment_change(ts, ts->childTiers.size);
+    uint64_t *offsets = (uint64_t*)memtrack_malloc(&ts->mem, (nSegments + 1) * sizeof(uint64_t));
+    if (!offsets) return false; // OOM.
+    if (blocked && !init_parent_buffers(ts, omp_get_max_threads())) { // OOM.
+        destroy_parent_buffers(ts);
+        memtrack_free(&ts->mem, offsets);
+        return false;
+    }
+    const fr_level_t *level = NULL;
+    uint64_t n = 0, nLose = 0, nWin = 0;
+    bool success = true, done = false, stopped = false;
+
+    /* Remotenesses must be processed in series. All levels are processed
+       inside one parallel region, which only synchronizes at barriers
+       between levels instead of forking and joining twice per level.
+       Each level is iterated as one range per segment, so the segment of
+       a position only needs to be looked up when a thread crosses a
+       segment boundary. If segments are sorted first, consecutive
+       positions of a thread share most of their unhash steps. */
+    board_t board = ts->board;
+    ts->lastCheckpoint = omp_get_wtime();
+    #pragma omp parallel firstprivate(board)
+    {
+        thread_state_t state = {0};
+        game_init_unhash_cache(&state.cache);
+        for (uint16_t rmt = ts->startRmt; !done; ++rmt) {
+            uint16_t seg = nSegments; // Not yet looked up.
+
+            /* Process loseFR. */
+            #pragma omp single
+            {
+                n = nLose = frontier_get_ranges(&ts->loseFR, rmt, offsets);
+                level = ts->loseFR.levels[rmt];
+            }
+            if (sortFrontier && n) {
+                #pragma omp for schedule(dynamic)
+                for (uint16_t s = 0; s < nSegments; ++s) frontier_sort(&ts->loseFR, rmt, s);
+            }
+            if (blocked) {
+                if (!push_frontier_blocked(ts, rmt, true, n, offsets, level, &board, &state)) {
+                    #pragma omp atomic write
+                    success = false;
+                }
+                #pragma omp barrier
             } else {
-                success &= process_win_pos(rmt, kTier, winFR.buckets[rmt][i], noChange, &board);
-                
-                /* Update statistics. */
-                bool blackTurn = game_is_black_turn(winFR.buckets[rmt][i]);
-                if (blackTurn && stat.longestNumStepsToBlackWin < rmt) {
-                    stat.longestNumStepsToBlackWin = rmt;
-                    stat.longestPosToBlackWin = winFR.buckets[rmt][i];
-                } else if (!blackTurn && stat.longestNumStepsToRedWin < rmt) {
-                    stat.longestNumStepsToRedWin = rmt;
-                    stat.longestPosToRedWin = winFR.buckets[rmt][i];
+                double start = omp_get_wtime();
+                #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) reduction(&&:success) nowait
+                for (uint64_t i = 0; i < n; ++i) {
+                    if (seg == nSegments || i < offsets[seg] || i >= offsets[seg + 1]) {
+                        seg = frontier_find_segment(offsets, nSegments, i);
+                    }
+                    success &= process_lose_pos(ts, rmt, segment_tier(ts, seg), level->buckets[seg][i - offsets[seg]],
+                                                segment_change(ts, seg), &board, &state);
+                }
+                load_barrier(start, &state.busy, &state.idle);
+            }
+            if (compact) {
+                /* Positions of TIER that lose in RMT. Parents found here are
+                   wins and can never match the value being scanned for. */
+                double start = omp_get_wtime();
+                #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) reduction(&&:success) reduction(+:nLose) nowait
+                for (uint64_t idx = 0; idx < ts->tierSize; ++idx) {
+                    if (ts->values[idx] != rmt + 1) continue; // Refer to the value table.
+                    success &= process_lose_pos(ts, rmt, ts->tier, pos_hash(ts, idx), noChange, &board, &state);
+                    ++nLose;
                 }
+                load_barrier(start, &state.busy, &state.idle);
+            }
+
+            /* Process winFR. */
+            #pragma omp single
+            {
+                frontier_free(&ts->loseFR, rmt);
+                n = nWin = frontier_get_ranges(&ts->winFR, rmt, offsets);
+                level = ts->winFR.levels[rmt];
+            }
+            if (sortFrontier && n) {
+                #pragma omp for schedule(dynamic)
+                for (uint16_t s = 0; s < nSegments; ++s) frontier_sort(&ts->winFR, rmt, s);
+            }
+            seg = nSegments;
+            if (blocked) {
+                if (!push_frontier_blocked(ts, rmt, false, n, offsets, level, &board, &state)) {
+                    #pragma omp atomic write
+                    success = false;
+                }
+                #pragma omp barrier
+            } else {
+                double start = omp_get_wtime();
+                #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) reduction(&&:success) nowait
+                for (uint64_t i = 0; i < n; ++i) {
+                    if (seg == nSegments || i < offsets[seg] || i >= offsets[seg + 1]) {
+                        seg = frontier_find_segment(offsets, nSegments, i);
+                    }
+                    uint64_t hash = level->buckets[seg][i - offsets[seg]];
+                    success &= process_win_pos(ts, rmt, segment_tier(ts, seg), hash, segment_change(ts, seg),
+                                               &board, &state);
+                    if (seg == ts->childTiers.size) update_win_stat(ts, hash, rmt);
+                }
+                load_barrier(start, &state.busy, &state.idle);
+            }
+            if (compact) {
+                /* Positions of TIER that win in RMT. */
+                double start = omp_get_wtime();
+                #pragma omp for schedule(dynamic, POSITION_CHUNK_SIZE) reduction(&&:success) reduction(+:nWin) nowait
+                for (uint64_t idx = 0; idx < ts->tierSize; ++idx) {
+                    if (ts->values[idx] != UINT16_MAX - rmt) continue; // Refer to the value table.
+                    uint64_t hash = pos_hash(ts, idx);
+                    success &= process_win_pos(ts, rmt, ts->tier, hash, noChange, &board, &state);
+                    update_win_stat(ts, hash, rmt);
+                    ++nWin;
+                }
+                load_barrier(start, &state.busy, &state.idle);
+            }
+
+            /* Stop after the highest remoteness that has ever been populated.
+               Positions found at this level land in level RMT+1, which raises
+               levelsEnd before the check below. */
+            #pragma omp single
+            {
+                frontier_free(&ts->winFR, rmt);
+                record_level_sizes(ts, rmt, nLose, nWin);
+                done = !success || rmt + 1 >= FR_SIZE ||
+                       (rmt + 1 >= ts->loseFR.levelsEnd && rmt + 1 >= ts->winFR.levelsEnd &&
+                        rmt + 1 >= ts->ownLevelsEnd);
+                if (!done) done = stopped = checkpoint_level_boundary(ts, rmt + 1);
             }
         }
-        frontier_free(&winFR, rmt);
-        if (!success) return false;
+        #pragma omp atomic
+        ts->telemetry.parents += state.parents;
+        #pragma omp atomic
+        ts->telemetry.lockWaitNs += state.lockWaitNs;
+        #pragma omp atomic
+        ts->telemetry.unhashSteps += state.cache.nSteps;
+        #pragma omp atomic
+        ts->telemetry.unhashStepsReused += state.cache.nStepsReused;
+        thread_load_add(&ts->telemetry.step4Load, state.busy, state.idle);
     }
-    destroy_FR();
-    destroy_dividers();
-    tier_array_destroy(&childTiers);
+    memtrack_free(&ts->mem, offsets);
+    destroy_parent_buffers(ts);
+    if (!success || stopped) return false;
+    ts->telemetry.lockWaitNs += ts->loseFR.lockWaitNs + ts->winFR.lockWaitNs;
+    destroy_FR(ts);
+    tier_array_destroy(&ts->childTiers);
     return true;
 }
 
-static void solve_tier_step_5_mark_draw_positions(void) {
+/* Marks the undecided positions among the first N entries of the solver
+   arrays as draws and adds them to the statistics. */
+static void mark_draw_positions(tier_solver_t *ts, uint64_t n) {
+    uint64_t numLegalPos = 0, numLose = 0, numWin = 0;
+
+    /* Branch-free so that each thread's range is swept with vector
+       instructions. Statistics are reduced per thread. */
+    #pragma omp parallel for simd schedule(static) reduction(+:numLegalPos, numLose, numWin)
+    for (uint64_t i = 0; i < n; ++i) {
+        uint8_t nUndChild = ts->nUndChild[i];
+        uint16_t value = ts->values[i];
+        bool legal = (nUndChild != ILLEGAL_NUM_CHILD_POS);
+        bool draw = legal && nUndChild;
+        ts->values[i] = draw ? DRAW_VALUE : value;
+        numLegalPos += legal;
+        numLose += (legal && !nUndChild && value < DRAW_VALUE);
+        numWin += (legal && !nUndChild && value >= DRAW_VALUE);
+    }
+    ts->stat.numLegalPos += numLegalPos;
+    ts->stat.numLose += numLose;
+    ts->stat.numWin += numWin;
+}
+
+static bool solve_tier_step_5_mark_draw_positions(tier_solver_t *ts) {
     /* STEP 5: MARK DRAW POSITIONS AND UPDATE STATISTICS. */
-    #pragma omp parallel for
-    for (uint64_t i = 0; i < tierSize; ++i) {
-        if (nUndChild[i] == ILLEGAL_NUM_CHILD_POS) continue;
-        if (nUndChild[i]) {
-            values[i] = DRAW_VALUE;
-            #pragma omp atomic
-            ++stat.numLegalPos;
-        } else if (values[i] < DRAW_VALUE) {
-            #pragma omp atomic
-            ++stat.numLose;
-            #pragma omp atomic
-            ++stat.numLegalPos;
-        } else {
-            #pragma omp atomic
-            ++stat.numWin;
-            #pragma omp atomic
-            ++stat.numLegalPos;
+    if (ts->mode != TIERSOLVER_MODE_SPILL) {
+        mark_draw_positions(ts, ts->tierSize);
+    } else {
+        for (uint64_t p = 0; p < ts->nPartitions; ++p) {
+            uint64_t base, n = partition_range(ts, p, &base);
+            if (!transfer_partition(ts, p, false, false)) return false;
+            mark_draw_positions(ts, n);
+            if (!transfer_partition(ts, p, true, true)) return false;
         }
     }
-    free(nUndChild); nUndChild = NULL;
+    memtrack_free(&ts->mem, ts->nUndChild); ts->nUndChild = NULL;
+
+    /* With all frontiers freed, heap memory that is still held but free
+       shows how fragmented the heap was left by solving. The heap is
+       shared with any tiers being solved concurrently. */
+    struct mallinfo2 info = mallinfo2();
+    ts->telemetry.heapBytes = info.arena + info.hblkhd;
+    ts->telemetry.heapFreeBytes = info.fordblks;
+    return true;
+}
+
+/* Records the wall time and the peak memory usage of TS since the
+   previous step as those of STEP. */
+static void finish_step(tier_solver_t *ts, int step) {
+    double now = omp_get_wtime();
+    uint64_t peak = memtrack_reset_peak(&ts->mem);
+    ts->telemetry.stepSeconds[step] = now - ts->stepStart;
+    ts->stepStart = now;
+    ts->memStat.stepPeaks[step] = peak;
+    if (peak > ts->memStat.peak) ts->memStat.peak = peak;
+}
+
+static double per_second(uint64_t n, double seconds) {
+    return seconds > 0.0 ? n / seconds : 0.0;
+}
+
+static void write_json_load(FILE *f, const thread_load_t *load) {
+    fprintf(f, "\"load\":{\"threads\":%d,\"busyMaxSeconds\":%.6f,\"busyMeanSeconds\":%.6f,"
+            "\"idleSeconds\":%.6f,\"imbalance\":%.3f}", load->nThreads, load->busyMax,
+            load->nThreads ? load->busySum / load->nThreads : 0.0, load->idleSum,
+            thread_load_imbalance(load));
 }
 
-static void solve_tier_step_6_save_values(void) {
+static void write_json_array(FILE *f, const uint64_t *array, uint16_t n) {
+    fputc('[', f);
+    for (uint16_t i = 0; i < n; ++i) {
+        fprintf(f, i ? ",%" PRIu64 : "%" PRIu64, array[i]);
+    }
+    fputc(']', f);
+}
+
+/* Saves the telemetry of TS as a single-line JSON record next to the
+   tier file. Telemetry is best-effort and skipped if OOM. */
+static void save_telemetry(const tier_solver_t *ts) {
+    static const char *modeNames[] = {"normal", "compact", "spill", "none"};
+    static const char *placementNames[] = {"first-touch", "interleave", "calloc"};
+    static const char *propagationNames[] = {"direct", "blocked"};
+    const tier_telemetry_t *t = &ts->telemetry;
+    char *json = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&json, &size);
+    if (!f) return;
+
+    fprintf(f, "{\"tier\":\"%s\",\"mode\":\"%s\",\"positions\":%" PRIu64 ",\"legal\":%" PRIu64
+            ",\"placement\":\"%s\",\"hugePages\":%s,\"propagation\":\"%s\",\"sortedFrontier\":%s,"
+            "\"threads\":%d,\"steps\":[", ts->tier, modeNames[ts->mode], ts->tierSize, ts->stat.numLegalPos,
+            placementNames[arrayPlacement], arrayHugePages ? "true" : "false",
+            propagationNames[parentPropagation], sortFrontier ? "true" : "false", omp_get_max_threads());
+    for (int i = 0; i < DB_NUM_SOLVER_STEPS; ++i) {
+        fprintf(f, "%s{\"seconds\":%.6f,\"peakBytes\":%" PRIu64 "}", i ? "," : "",
+                t->stepSeconds[i], ts->memStat.stepPeaks[i]);
+    }
+    fprintf(f, "],\"step1\":{\"childPositions\":%" PRIu64 ",\"positionsPerSecond\":%.1f,"
+            "\"bytesRead\":%" PRIu64 "}", t->childPositions,
+            per_second(t->childPositions, t->stepSeconds[1]), t->bytesRead);
+    fprintf(f, ",\"step3\":{\"positionsPerSecond\":%.1f,",
+            per_second(ts->tierSize, t->stepSeconds[3]));
+    write_json_load(f, &t->step3Load);
+    fprintf(f, "},\"step4\":{\"positions\":%" PRIu64 ",\"positionsPerSecond\":%.1f,"
+            "\"parents\":%" PRIu64 ",\"levels\":%" PRIu16 ",", t->step4Positions,
+            per_second(t->step4Positions, t->stepSeconds[4]), t->parents, t->nLevels);
+    write_json_load(f, &t->step4Load);
+    fputc('}', f);
+    fprintf(f, ",\"unhash\":{\"steps\":%" PRIu64 ",\"reused\":%" PRIu64 ",\"savedFraction\":%.4f}",
+            t->unhashSteps, t->unhashStepsReused,
+            t->unhashSteps ? (double)t->unhashStepsReused / t->unhashSteps : 0.0);
+    fprintf(f, ",\"memory\":{\"budgetBytes\":%" PRIu64 ",\"deniedAllocations\":%" PRIu64
+            ",\"heapBytes\":%" PRIu64 ",\"heapFreeBytes\":%" PRIu64 ",\"fragmentation\":%.4f}",
+            ts->mem.limit, memtrack_denied(&ts->mem), t->heapBytes, t->heapFreeBytes,
+            t->heapBytes ? (double)t->heapFreeBytes / t->heapBytes : 0.0);
+    fprintf(f, ",\"lockWaitSeconds\":%.6f,\"bytesWritten\":%" PRIu64 ",\"frontier\":{\"lose\":",
+            t->lockWaitNs / 1e9, t->bytesWritten);
+    write_json_array(f, t->loseSizes, t->nLevels);
+    fputs(",\"win\":", f);
+    write_json_array(f, t->winSizes, t->nLevels);
+    fputs("}}\n", f);
+    if (fclose(f) == 0) db_save_telemetry(ts->tier, json);
+    free(json);
+}
+
+/* Saves the values that step 5 left in the scratch file as the tier file.
+   Values are compressed in chunks of whole blocks, so the tier file is
+   identical to the one db_save_tier writes. Returns the number of bytes
+   written, or 0 on failure. */
+static uint64_t save_spilled_values(tier_solver_t *ts) {
+    uint64_t chunkSize = 1ULL << ts->partitionBits;
+    if (chunkSize < DB_TIER_BLOCK_VALUES) chunkSize = DB_TIER_BLOCK_VALUES;
+    memtrack_free(&ts->mem, ts->values);
+    ts->values = (uint16_t*)memtrack_malloc(&ts->mem, chunkSize * sizeof(uint16_t));
+    if (!ts->values) return 0; // OOM.
+
+    tier_writer_t writer;
+    bool success = db_open_tier_writer(&writer, ts->tier, DB_LAYOUT_TURN_SPLIT, &ts->mem);
+    for (uint64_t base = 0; success && base < ts->tierSize; base += chunkSize) {
+        uint64_t n = (ts->tierSize - base < chunkSize) ? ts->tierSize - base : chunkSize;
+        success = transfer_bytes(ts->arraysFd, ts->values, n * sizeof(uint16_t), base * sizeof(uint16_t), false) &&
+                  db_write_tier_values(&writer, ts->values, n);
+    }
+    return db_close_tier_writer(&writer, success);
+}
+
+static bool solve_tier_step_6_save_values(tier_solver_t *ts) {
     /* STEP 6: SAVE SOLVER DATA TO DISK. */
     /* First save the tier file. */
-    db_save_tier(kTier, values, tierSize);
+    if (ts->mode == TIERSOLVER_MODE_SPILL) {
+        ts->telemetry.bytesWritten = save_spilled_values(ts);
+        if (!ts->telemetry.bytesWritten) {
+            printf("tiersolver_solve_tier: failed to save tier %s.\n", ts->tier);
+            return false;
+        }
+    } else {
+        ts->telemetry.bytesWritten = db_save_tier(ts->tier, ts->values, ts->tierSize, DB_LAYOUT_TURN_SPLIT,
+                                                  &ts->mem);
+        /* The parents of this tier are likely to be solved soon by the
+           same process. */
+        tier_cache_insert_copy(ts->tier, ts->values, ts->tierSize, DB_LAYOUT_TURN_SPLIT,
+                               ts->telemetry.bytesWritten);
+    }
+    ts->telemetry.bytesWritten += sizeof(tier_solver_stat_t) + sizeof(tier_mem_stat_t);
+    finish_step(ts, 6);
 
-    /* Then save the stat file as a success indicator. */
-    db_save_stat(kTier, stat);
+    /* Then save the stat file as a success indicator, followed by
+       the telemetry record. */
+    db_save_stat(ts->tier, ts->stat, &ts->memStat, DB_LAYOUT_TURN_SPLIT);
+    save_telemetry(ts);
+    return true;
 }
 
-static void solve_tier_step_7_cleanup(void) {
-    kTier = NULL;
-    destroy_FR();
-    destroy_dividers();
-    tier_array_destroy(&childTiers);
-    free(nUndChild); nUndChild = NULL;
-    free(values); values = NULL;
-    omp_destroy_lock(&nUndChildLock);
+static void solve_tier_step_7_cleanup(tier_solver_t *ts) {
+    destroy_FR(ts);
+    destroy_parent_buffers(ts);
+    tier_array_destroy(&ts->childTiers);
+    memtrack_free(&ts->mem, ts->nUndChild); ts->nUndChild = NULL;
+    memtrack_free(&ts->mem, ts->values); ts->values = NULL;
+    if (ts->updates) {
+        for (uint64_t i = 0; i < 2 * ts->nPartitions; ++i) spill_stream_destroy(&ts->updates[i]);
+        memtrack_free(&ts->mem, ts->updates); ts->updates = NULL;
+    }
+    memtrack_free(&ts->mem, ts->records); ts->records = NULL;
+    if (ts->arraysFd >= 0) close(ts->arraysFd);
+    if (ts->arraysFilename) remove(ts->arraysFilename);
+    free(ts->arraysFilename); ts->arraysFilename = NULL;
+    memtrack_free(&ts->mem, ts->telemetry.loseSizes); ts->telemetry.loseSizes = NULL;
+    memtrack_free(&ts->mem, ts->telemetry.winSizes); ts->telemetry.winSizes = NULL;
+    omp_destroy_lock(&ts->nUndChildLock);
+
+    /* Everything allocated through the account has been released. Return
+       the freed memory of large tiers to the system so that the next
+       tier, which may be solved by another process, starts from an
+       unfragmented heap. */
+    if (memtrack_live(&ts->mem)) {
+        printf("tiersolver_solve_tier: %" PRIu64 " bytes still allocated after cleanup of tier %s.\n",
+               memtrack_live(&ts->mem), ts->tier);
+    }
+    if (memtrack_peak(&ts->mem) >= HEAP_TRIM_MIN_PEAK || ts->memStat.peak >= HEAP_TRIM_MIN_PEAK) malloc_trim(0);
 }
 
 /**
@@ -390,25 +1657,181 @@ static void solve_tier_step_7_cleanup(void) {
  * to a red/black win.
  */
 tier_solver_stat_t tiersolver_solve_tier(const char *tier, uint64_t mem, bool force) {
+    tier_solver_t ts;
     if (force) goto _solve;
     int tierStatus = db_check_tier(tier);
     if (tierStatus == DB_TIER_OK) {
         /* If the given TIER is already solved, skip solving and return. */
-        stat = db_load_stat(tier);
-        return stat;
+        return db_load_stat(tier);
     }
 
     /* Solver main algorithm. */
 _solve:
-    if (!solve_tier_step_0_initialize(tier, mem)) goto _bailout;
-    if (!solve_tier_step_1_load_children()) goto _bailout;    
-    if (!solve_tier_step_2_setup_solver_arrays()) goto _bailout;
-    if (!solve_tier_step_3_scan_tier()) goto _bailout;
-    if (!solve_tier_step_4_push_frontier_up()) goto _bailout;
-    solve_tier_step_5_mark_draw_positions();
-    solve_tier_step_6_save_values();
+    if (!solve_tier_step_0_initialize(&ts, tier, mem)) goto _bailout;
+    finish_step(&ts, 0);
+    if (load_checkpoint(&ts)) {
+        /* Steps 1 to 3 were replaced by loading the checkpoint. */
+        finish_step(&ts, 1);
+    } else {
+        /* A stop requested before the tier is scanned gives up the tier,
+           as there is nothing to checkpoint yet. One requested later is
+           served at the first level boundary of step 4, and one requested
+           after step 4 lets the tier finish. */
+        if (tiersolver_stop_requested()) goto _bailout;
+        if (!solve_tier_step_1_load_children(&ts)) goto _bailout;
+        finish_step(&ts, 1);
+        if (tiersolver_stop_requested()) goto _bailout;
+        if (!solve_tier_step_2_setup_solver_arrays(&ts)) goto _bailout;
+        finish_step(&ts, 2);
+        if (!solve_tier_step_3_scan_tier(&ts)) goto _bailout;
+        finish_step(&ts, 3);
+    }
+    if (!solve_tier_step_4_push_frontier_up(&ts)) goto _bailout;
+    finish_step(&ts, 4);
+    if (!solve_tier_step_5_mark_draw_positions(&ts)) goto _bailout;
+    finish_step(&ts, 5);
+    if (!solve_tier_step_6_save_values(&ts)) goto _bailout;
+    remove_checkpoint(tier);
 
 _bailout:
-    solve_tier_step_7_cleanup();
-    return stat;
+    if (memtrack_denied(&ts.mem)) {
+        printf("tiersolver_solve_tier: tier %s ran out of memory budget (%zd bytes for the tier).\n", tier, mem);
+    }
+    solve_tier_step_7_cleanup(&ts);
+    return ts.stat;
+}
+
+/* Bytes per position of a frontier, allowing for buckets that have just
+   doubled their capacity. */
+#define FR_BYTES_PER_POS (2 * sizeof(uint64_t))
+/* Extra margin on top of a measured peak, which depends on the number
+   of threads and on how full the frontier buckets happened to be. */
+#define MEASURED_PEAK_MARGIN(peak) ((peak) + ((peak) >> 3))
+
+/* Returns the number of winning and losing positions of all child tiers
+   of TIER, or their sizes for child tiers that have not been solved. */
+static uint64_t count_decided_child_pos(const char *tier) {
+    uint64_t total = 0;
+    TierList *childTiers = tier_get_child_tier_list(tier);
+    for (struct TierListElem *walker = childTiers; walker; walker = walker->next) {
+        struct TierListElem *canonical = tier_get_canonical_tier(walker->tier);
+        if (canonical && db_check_tier(canonical->tier) == DB_TIER_OK) {
+            tier_solver_stat_t childStat = db_load_stat(canonical->tier);
+            total += childStat.numWin + childStat.numLose;
+        } else {
+            total += tier_size(walker->tier);
+        }
+        free(canonical);
+    }
+    tier_list_destroy(childTiers);
+    return total;
+}
+
+/**
+ * @brief Estimates the peak memory needed to solve TIER in MODE with
+ * NTHREADS threads, or returns 0 if TIER is not a legal tier. Child tiers
+ * are counted into INFO the first time they are needed.
+ *
+ * All modes need the values and undecided-children arrays (3 bytes per
+ * position) and one block buffer per thread while loading children.
+ * Normal and compact mode hold every winning and losing position of the
+ * child tiers in the frontiers. Normal mode additionally bounds the
+ * frontier segment of TIER by the size of TIER. Blocked propagation adds
+ * the parent buffers of each thread. Step 6 holds the values
+ * and the compressed tier, which is assumed to be no larger than the
+ * values. Spill mode keeps the frontiers on disk and needs the memory
+ * of spill_mem with the smallest partitions. Tiers too large for spill
+ * records can not be solved in spill mode at all.
+ */
+static uint64_t estimate_mem(const char *tier, int mode, uint64_t nThreads, tier_admit_info_t *info) {
+    uint64_t size = tier_size(tier);
+    if (!size) return 0;
+    if (mode == TIERSOLVER_MODE_SPILL) {
+        /* Spilled records only have room for hashes below SPILL_SEG_SHIFT bits. */
+        if (size >= (1ULL << SPILL_SEG_SHIFT)) return 0;
+        return spill_mem(size, spill_partition_bits(size, 0, nThreads), nThreads);
+    }
+    uint64_t buffers = nThreads * 3 * (1ULL << 20);
+    uint64_t arrays = 3 * size + buffers;
+    uint64_t save = 4 * size + buffers;
+    uint64_t frontier = 0;
+    if (mode == TIERSOLVER_MODE_NORMAL || mode == TIERSOLVER_MODE_COMPACT) {
+        if (info->decidedChildPos == TIERSOLVER_UNCOUNTED) info->decidedChildPos = count_decided_child_pos(tier);
+        frontier += FR_BYTES_PER_POS * info->decidedChildPos;
+    }
+    if (mode == TIERSOLVER_MODE_NORMAL) frontier += FR_BYTES_PER_POS * size;
+    if (parentPropagation == TIERSOLVER_PROPAGATE_BLOCKED) {
+        uint64_t nPartitions = ((size - 1) >> PARENT_PARTITION_BITS) + 1;
+        uint64_t entries = (size < BLOCKED_ROUND_ENTRIES) ? size : BLOCKED_ROUND_ENTRIES;
+        frontier += nThreads * (2 * sizeof(uint64_t) * entries *
+                    BLOCKED_PARENTS_PER_POS + sizeof(uint64_t) * (nPartitions + 1));
+    }
+    return (arrays + frontier > save) ? arrays + frontier : save;
+}
+
+/* Loads the memory record of the last solve of TIER into INFO. Child
+   tiers are only counted once an estimate needs them. */
+void tiersolver_load_admit_info(const char *tier, tier_admit_info_t *info) {
+    tier_mem_stat_t history;
+    memset(info, 0, sizeof(*info));
+    info->decidedChildPos = TIERSOLVER_UNCOUNTED;
+    if (db_load_mem_stat(tier, &history) && history.peak) {
+        info->peak = history.peak;
+        info->peakMode = (int)history.mode;
+    }
+    info->loaded = true;
+}
+
+/**
+ * @brief Decides whether and in which mode TIER can be solved by NTHREADS
+ * threads within MEM bytes of memory, preferring normal over compact over
+ * spill mode. For each mode, the peak recorded the last time TIER was
+ * solved in that mode is used if there is one, and the estimate of the
+ * memory model otherwise. Spill mode always uses the estimate, as its
+ * partitions grow with the memory available and its recorded peak says
+ * little about smaller budgets. Only the mode set by tiersolver_set_mode
+ * is considered if there is one. INFO is loaded on first use and may be
+ * kept for later decisions on the same tier, which then read no files.
+ * @param requiredMem: set to the memory needed in the chosen mode, or in
+ * spill mode if no mode fits.
+ * @return The chosen mode, or TIERSOLVER_MODE_NONE if no mode fits.
+ */
+int tiersolver_admit_with(const char *tier, tier_admit_info_t *info, uint64_t mem, int nThreads,
+                          uint64_t *requiredMem) {
+    if (!info->loaded) tiersolver_load_admit_info(tier, info);
+    for (int mode = TIERSOLVER_MODE_NORMAL; mode < TIERSOLVER_MODE_NONE; ++mode) {
+        if (forcedMode != TIERSOLVER_MODE_NONE && mode != forcedMode) continue;
+        if (info->peak && info->peakMode == mode && mode != TIERSOLVER_MODE_SPILL) {
+            *requiredMem = MEASURED_PEAK_MARGIN(info->peak);
+        } else {
+            *requiredMem = estimate_mem(tier, mode, nThreads < 1 ? 1 : (uint64_t)nThreads, info);
+        }
+        if (*requiredMem && *requiredMem <= mem) return mode;
+    }
+    return TIERSOLVER_MODE_NONE;
+}
+
+/* Same as tiersolver_admit_with for a solve by all threads of this
+   process, loading what is needed of TIER from the database. */
+int tiersolver_admit(const char *tier, uint64_t mem, uint64_t *requiredMem) {
+    tier_admit_info_t info = {0};
+    return tiersolver_admit_with(tier, &info, mem, omp_get_max_threads(), requiredMem);
+}
+
+/* Returns the memory needed to solve TIER by NTHREADS threads in the mode
+   tiersolver_admit_with chooses for a budget of MEM bytes, or 0 if TIER
+   does not fit. A tier that needs spill mode takes all of MEM, so it is
+   solved on its own with partitions as large as possible. */
+uint64_t tiersolver_required_mem_with(const char *tier, tier_admit_info_t *info, uint64_t mem, int nThreads) {
+    uint64_t requiredMem;
+    int mode = tiersolver_admit_with(tier, info, mem, nThreads, &requiredMem);
+    if (mode == TIERSOLVER_MODE_NONE) return 0;
+    return (mode == TIERSOLVER_MODE_SPILL) ? mem : requiredMem;
+}
+
+/* Same as tiersolver_required_mem_with for a solve by all threads of this
+   process. */
+uint64_t tiersolver_required_mem(const char *tier, uint64_t mem) {
+    tier_admit_info_t info = {0};
+    return tiersolver_required_mem_with(tier, &info, mem, omp_get_max_threads());
 }
@@ -4,6 +4,55 @@
 #include <stdint.h>
 #include "db.h"
 
+/* Solver modes, from fastest to most memory-efficient. */
+enum tiersolver_mode {
+    TIERSOLVER_MODE_NORMAL = 0,
+    TIERSOLVER_MODE_COMPACT,  // Finds positions of the tier itself by scanning values.
+    TIERSOLVER_MODE_SPILL,    // Keeps frontiers and solver arrays on disk.
+    TIERSOLVER_MODE_NONE      // The tier can not be solved within the budget.
+};
+
+/* Placement of the solver arrays of a tier on NUMA nodes. */
+enum tiersolver_placement {
+    TIERSOLVER_PLACE_FIRST_TOUCH = 0, // Pages are touched first by the threads that scan them.
+    TIERSOLVER_PLACE_INTERLEAVE,      // Pages are interleaved across all allowed nodes.
+    TIERSOLVER_PLACE_CALLOC           // Arrays are zeroed by calloc on a single thread.
+};
+
+/* How parents of frontier positions are updated in step 4. */
+enum tiersolver_propagation {
+    TIERSOLVER_PROPAGATE_DIRECT = 0, // Each parent is updated as soon as it is generated.
+    TIERSOLVER_PROPAGATE_BLOCKED     // Parents are grouped by index range and updated range by range.
+};
+
 tier_solver_stat_t tiersolver_solve_tier(const char *tier, uint64_t mem, bool force);
 
+void tiersolver_set_checkpoint(const char *dir, double interval);
+void tiersolver_request_stop(void);
+bool tiersolver_stop_requested(void);
+void tiersolver_set_placement(int placement, bool hugePages);
+void tiersolver_set_propagation(int propagation);
+void tiersolver_set_sorted_frontier(bool sorted);
+void tiersolver_set_mode(int mode);
+
+/* Count of child positions that has not been made yet. */
+#define TIERSOLVER_UNCOUNTED UINT64_MAX
+
+/* What admission needs to know of a tier from the database, loaded once
+   so that the same tier can be admitted again and again, for example by
+   a manager weighing it against many workers, without reading any file. */
+typedef struct TierAdmitInfo {
+    uint64_t decidedChildPos; // Winning and losing positions of all child tiers, or TIERSOLVER_UNCOUNTED.
+    uint64_t peak;            // Peak memory of the last solve of the tier, 0 if unknown.
+    int peakMode;             // Solver mode of that solve.
+    bool loaded;              // False until the memory record has been loaded.
+} tier_admit_info_t;
+
+void tiersolver_load_admit_info(const char *tier, tier_admit_info_t *info);
+int tiersolver_admit_with(const char *tier, tier_admit_info_t *info, uint64_t mem, int nThreads,
+                          uint64_t *requiredMem);
+int tiersolver_admit(const char *tier, uint64_t mem, uint64_t *requiredMem);
+uint64_t tiersolver_required_mem_with(const char *tier, tier_admit_info_t *info, uint64_t mem, int nThreads);
+uint64_t tiersolver_required_mem(const char *tier, uint64_t mem);
+
 #endif // TIERSOLVER_H
@@ -0,0 +1,688 @@
+#include "common.h"
+#include "db.h"
+#include "frontier.h"
+#include "game.h"
+#include "memtrack.h"
+#include "misc.h"
+#include "tier.h"
+#include "tiersolvermpi.h"
+#include <inttypes.h>
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Distributed solver of a single tier. All ranks of MPI_COMM_WORLD solve
+   the tier together. Each rank owns a slice of consecutive positions of
+   the tier in turn-split layout, holds the values and numbers of
+   undecided children of its slice only, and compresses its slice of the
+   tier file. Slice boundaries are multiples of DB_TIER_BLOCK_VALUES so
+   that the blocks of each slice are blocks of the tier file.
+
+   The blocks of all child tiers are dealt out to the ranks, which load
+   the decided positions of their blocks into their own frontiers.
+   Positions of the tier are added to the frontiers of their owners. At
+   each remoteness level, every rank generates the parents of its frontier
+   positions in batches and sends each parent to its owner, which applies
+   the update. While the parents of one batch are exchanged, those of the
+   next batch are generated. Positions are decided in the same order as by
+   tiersolver_solve_tier, so the tier file is identical. */
+
+#define FR_SIZE (((UINT16_MAX)-1)>>1)
+#define EXCHANGE_BATCH_POSITIONS (1ULL << 14) // Frontier positions of each rank per exchange.
+#define EXCHANGE_CHUNK_BYTES (1ULL << 30)     // Largest message sent at once in step 6.
+#define GENERATE_CHUNK_SIZE 64
+#define APPLY_CHUNK_SIZE 4096
+#define PROGRESS_INTERVAL 63                  // Positions between calls that progress a pending exchange.
+#define DIST_NUM_STEPS 7
+
+/* Parents generated by one thread in the current batch. The board and
+   unhash cache are kept across batches so that leading unhash steps are
+   reused as in tiersolver.c. */
+typedef struct ThreadParents {
+    uint64_t *parents;            // Indices of parents in the order they were generated.
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t *ownerCounts;        // Number of parents owned by each rank, then where to put them.
+    board_t board;
+    unhash_cache_t cache;
+} thread_parents_t;
+
+/* Parents of one batch grouped by owner, on their way to their owners. */
+typedef struct ParentExchange {
+    uint64_t *send;
+    uint64_t sendCapacity;
+    uint64_t *recv;
+    uint64_t recvCapacity;
+    uint64_t nRecv;
+    int *sendCounts, *sendDispls;
+    int *recvCounts, *recvDispls;
+    MPI_Request request;
+    bool lose;                    // True if the parents are those of losing positions.
+    bool pending;                 // True while the exchange is in flight.
+} exchange_t;
+
+/* Solver context of one rank. */
+typedef struct DistTierSolver {
+    const char *tier;
+    int rank, nRanks;
+    uint64_t tierSize;
+    uint64_t sliceSize;           // Number of positions owned by each rank, except at the end of the tier.
+    uint64_t base;                // Index of the first position owned by this rank.
+    uint64_t n;                   // Number of positions owned by this rank.
+    struct TierArray childTiers;
+    fr_t winFR, loseFR;           // One segment per child tier plus one for TIER.
+    uint16_t *values;             // Values of the positions owned by this rank.
+    uint8_t *nUndChild;           // Undecided children of the positions owned by this rank.
+    tier_solver_stat_t stat;
+    memtrack_t mem;
+    board_t board;
+    thread_parents_t *threads;
+    int nThreads;
+    exchange_t exchanges[2];
+    double stepSeconds[DIST_NUM_STEPS];
+    double stepStart;
+    uint64_t parentsSent;         // Parents sent to all ranks including this one.
+    uint64_t parentsSentRemote;   // Parents sent to other ranks.
+} dist_solver_t;
+
+static double finish_step(dist_solver_t *ds, int step) {
+    double now = omp_get_wtime();
+    ds->stepSeconds[step] = now - ds->stepStart;
+    ds->stepStart = now;
+    return now;
+}
+
+/* Returns true on all ranks if SUCCESS is true on all ranks. */
+static bool all_succeeded(bool success) {
+    int local = success, global;
+    MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return global;
+}
+
+static inline int owner(const dist_solver_t *ds, uint64_t idx) {
+    return (int)(idx / ds->sliceSize);
+}
+
+static inline uint64_t pos_index(const dist_solver_t *ds, uint64_t hash) {
+    return db_layout_index(DB_LAYOUT_TURN_SPLIT, ds->tierSize, hash);
+}
+
+static inline uint64_t pos_hash(const dist_solver_t *ds, uint64_t idx) {
+    return db_layout_hash(DB_LAYOUT_TURN_SPLIT, ds->tierSize, idx);
+}
+
+static const char *segment_tier(const dist_solver_t *ds, uint16_t seg) {
+    return (seg < ds->childTiers.size) ? ds->childTiers.tiers[seg] : ds->tier;
+}
+
+static tier_change_t segment_change(const dist_solver_t *ds, uint16_t seg) {
+    const tier_change_t noChange = {INVALID_IDX, -1, INVALID_IDX, -1};
+    return (seg < ds->childTiers.size) ? ds->childTiers.changes[seg] : noChange;
+}
+
+static void update_win_stat(tier_solver_stat_t *stat, uint64_t hash, uint16_t rmt) {
+    bool blackTurn = game_is_black_turn(hash);
+    if (blackTurn && stat->longestNumStepsToBlackWin < rmt) {
+        stat->longestNumStepsToBlackWin = rmt;
+        stat->longestPosToBlackWin = hash;
+    } else if (!blackTurn && stat->longestNumStepsToRedWin < rmt) {
+        stat->longestNumStepsToRedWin = rmt;
+        stat->longestPosToRedWin = hash;
+    }
+}
+
+/* Adds the decided value VAL of position HASH of child tier CHILDIDX to
+   the frontiers. Reserved values and draws are skipped. */
+static bool load_child_value(dist_solver_t *ds, uint8_t childIdx, uint64_t hash, uint16_t val) {
+    if (!val || val == DRAW_VALUE) return true;
+    if (val < DRAW_VALUE) return frontier_add(&ds->loseFR, hash, val - 1, childIdx);
+    return frontier_add(&ds->winFR, hash, UINT16_MAX - val, childIdx);
+}
+
+static bool step_0_initialize(dist_solver_t *ds, const char *tier, uint64_t mem) {
+    memset(ds, 0, sizeof(*ds));
+    ds->stepStart = omp_get_wtime();
+    MPI_Comm_rank(MPI_COMM_WORLD, &ds->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ds->nRanks);
+    memtrack_init(&ds->mem, memtrack_node());
+    memtrack_set_limit(&ds->mem, mem);
+    ds->tier = tier;
+    ds->tierSize = tier_size(tier);
+    if (!ds->tierSize) return false;
+
+    uint64_t share = (ds->tierSize + ds->nRanks - 1) / ds->nRanks;
+    ds->sliceSize = (share + DB_TIER_BLOCK_VALUES - 1) / DB_TIER_BLOCK_VALUES * DB_TIER_BLOCK_VALUES;
+    ds->base = ds->sliceSize * ds->rank;
+    if (ds->base > ds->tierSize) ds->base = ds->tierSize;
+    ds->n = (ds->tierSize - ds->base < ds->sliceSize) ? ds->tierSize - ds->base : ds->sliceSize;
+    game_init_board(&ds->board);
+
+    ds->nThreads = omp_get_max_threads();
+    ds->threads = (thread_parents_t*)memtrack_calloc(&ds->mem, ds->nThreads, sizeof(thread_parents_t));
+    if (!ds->threads) return false;
+    for (int t = 0; t < ds->nThreads; ++t) {
+        ds->threads[t].ownerCounts = (uint64_t*)memtrack_calloc(&ds->mem, ds->nRanks, sizeof(uint64_t));
+        if (!ds->threads[t].ownerCounts) return false;
+        game_init_board(&ds->threads[t].board);
+        game_init_unhash_cache(&ds->threads[t].cache);
+    }
+    for (int k = 0; k < 2; ++k) {
+        exchange_t *ex = &ds->exchanges[k];
+        ex->sendCounts = (int*)memtrack_calloc(&ds->mem, 4 * ds->nRanks, sizeof(int));
+        if (!ex->sendCounts) return false;
+        ex->sendDispls = ex->sendCounts + ds->nRanks;
+        ex->recvCounts = ex->sendDispls + ds->nRanks;
+        ex->recvDispls = ex->recvCounts + ds->nRanks;
+    }
+    return true;
+}
+
+/* A child tier as it is stored on disk, together with a reader for it. */
+typedef struct ChildTierSource {
+    struct TierListElem *stored; // Canonical tier under which the child is stored.
+    bool canonical;              // True if the child tier is itself canonical.
+    tier_reader_t reader;
+    uint64_t firstBlock;         // Index of the child's first block among all child blocks.
+} child_source_t;
+
+static void destroy_child_sources(dist_solver_t *ds, child_source_t *sources, uint8_t n) {
+    for (uint8_t i = 0; i < n; ++i) {
+        if (sources[i].reader.offsets) db_close_tier_reader(&sources[i].reader);
+        free(sources[i].stored);
+    }
+    memtrack_free(&ds->mem, sources);
+}
+
+static bool step_1_load_children(dist_solver_t *ds) {
+    /* STEP 1: LOAD THE DECIDED POSITIONS OF THE CHILD BLOCKS DEALT TO THIS RANK. */
+    ds->childTiers = tier_get_child_tier_array(ds->tier); // If OOM, there is a bug.
+    if (!frontier_init(&ds->winFR, FR_SIZE, ds->childTiers.size + 1, &ds->mem) ||
+        !frontier_init(&ds->loseFR, FR_SIZE, ds->childTiers.size + 1, &ds->mem)) {
+        return false;
+    }
+    if (!ds->childTiers.size) return true;
+
+    child_source_t *sources = (child_source_t*)memtrack_calloc(&ds->mem, ds->childTiers.size,
+                                                               sizeof(child_source_t));
+    if (!sources) return false;
+    uint64_t nBlocks = 0, maxBlockSize = 0;
+    for (uint8_t childIdx = 0; childIdx < ds->childTiers.size; ++childIdx) {
+        child_source_t *src = sources + childIdx;
+        src->stored = tier_get_canonical_tier(ds->childTiers.tiers[childIdx]);
+        if (!src->stored || !db_open_tier_reader(&src->reader, src->stored->tier,
+                                                 tier_size(src->stored->tier), &ds->mem)) {
+            destroy_child_sources(ds, sources, childIdx + 1);
+            return false;
+        }
+        src->canonical = !strncmp(src->stored->tier, ds->childTiers.tiers[childIdx], TIER_STR_LENGTH_MAX);
+        src->firstBlock = nBlocks;
+        nBlocks += src->reader.nBlocks;
+        if (src->reader.blockSize > maxBlockSize) maxBlockSize = src->reader.blockSize;
+    }
+
+    /* Blocks are dealt out round-robin, so every rank reads a share of
+       every child tier. */
+    bool success = true;
+    uint64_t nOwnBlocks = (nBlocks > (uint64_t)ds->rank) ? (nBlocks - ds->rank - 1) / ds->nRanks + 1 : 0;
+    #pragma omp parallel
+    {
+        bool loadSuccess = true;
+        uint16_t *block = NULL;
+        uint8_t childIdx = 0;
+        board_t localBoard;
+        game_init_board(&localBoard);
+
+        #pragma omp for schedule(dynamic)
+        for (uint64_t k = 0; k < nOwnBlocks; ++k) {
+            if (!loadSuccess) continue;
+            uint64_t i = ds->rank + k * ds->nRanks;
+            while (childIdx + 1 < ds->childTiers.size && sources[childIdx + 1].firstBlock <= i) ++childIdx;
+            while (sources[childIdx].firstBlock > i) --childIdx;
+            const child_source_t *src = sources + childIdx;
+
+            if (!block) block = (uint16_t*)memtrack_malloc(&ds->mem, maxBlockSize * sizeof(uint16_t));
+            uint64_t size = block ? db_read_tier_block(&src->reader, i - src->firstBlock, block) : 0;
+            if (!size) { // OOM.
+                loadSuccess = false;
+                continue;
+            }
+            uint64_t begin = (i - src->firstBlock) * src->reader.blockSize;
+            for (uint64_t j = 0; j < size; ++j) {
+                if (!block[j] || block[j] == DRAW_VALUE) continue;
+                uint64_t hash = db_layout_hash(src->reader.layout, src->reader.tierSize, begin + j);
+                if (!src->canonical) {
+                    hash = game_get_noncanonical_hash(src->stored->tier, hash,
+                                                      ds->childTiers.tiers[childIdx], &localBoard);
+                }
+                loadSuccess &= load_child_value(ds, childIdx, hash, block[j]);
+            }
+        }
+        memtrack_free(&ds->mem, block);
+        #pragma omp atomic
+        success &= loadSuccess;
+    }
+    destroy_child_sources(ds, sources, ds->childTiers.size);
+    return success;
+}
+
+static bool step_2_setup_solver_arrays(dist_solver_t *ds) {
+    /* STEP 2: SET UP THE SOLVER ARRAYS OF THE SLICE OWNED BY THIS RANK. */
+    uint64_t n = ds->n ? ds->n : 1;
+    ds->values = (uint16_t*)memtrack_calloc(&ds->mem, n, sizeof(uint16_t));
+    ds->nUndChild = (uint8_t*)memtrack_calloc(&ds->mem, n, sizeof(uint8_t));
+    return ds->values && ds->nUndChild;
+}
+
+static bool step_3_scan_slice(dist_solver_t *ds) {
+    /* STEP 3: COUNT THE CHILDREN OF THE POSITIONS OWNED BY THIS RANK AND
+       LOAD ITS PRIMITIVE POSITIONS INTO THE FRONTIER. */
+    const uint16_t own = ds->childTiers.size;
+    board_t board = ds->board;
+    bool success = true;
+
+    #pragma omp parallel for firstprivate(board) schedule(dynamic, 1024) reduction(&&:success)
+    for (uint64_t i = 0; i < ds->n; ++i) {
+        uint64_t hash = pos_hash(ds, ds->base + i);
+        ds->nUndChild[i] = game_num_child_pos(ds->tier, hash, &board);
+        success &= (ds->nUndChild[i] != ILLEGAL_NUM_CHILD_POS_OOM);
+        if (!ds->nUndChild[i]) {
+            ds->values[i] = 1;
+            success &= frontier_add(&ds->loseFR, hash, 0, own);
+        }
+    }
+    return success;
+}
+
+static bool reserve(dist_solver_t *ds, uint64_t **array, uint64_t *capacity, uint64_t size) {
+    if (size <= *capacity) return true;
+    uint64_t newCapacity = *capacity ? *capacity : 1024;
+    while (newCapacity < size) newCapacity <<= 1;
+    uint64_t *newArray = (uint64_t*)memtrack_realloc(&ds->mem, *array, newCapacity * sizeof(uint64_t));
+    if (!newArray) return false;
+    *array = newArray;
+    *capacity = newCapacity;
+    return true;
+}
+
+/* Generates the parents of positions BEGIN to END of frontier LEVEL at
+   remoteness RMT into EX, grouped by owner. If PENDING is not NULL, the
+   main thread keeps that exchange progressing meanwhile. */
+static bool generate_parents(dist_solver_t *ds, const fr_level_t *level, const uint64_t *offsets,
+                             uint64_t begin, uint64_t end, bool lose, uint16_t rmt,
+                             exchange_t *ex, MPI_Request *pending) {
+    const uint16_t nSegments = ds->childTiers.size + 1;
+    bool success = true;
+
+    #pragma omp parallel num_threads(ds->nThreads)
+    {
+        thread_parents_t *tp = &ds->threads[omp_get_thread_num()];
+        bool threadSuccess = true;
+        uint16_t seg = nSegments;
+        tp->size = 0;
+        memset(tp->ownerCounts, 0, ds->nRanks * sizeof(uint64_t));
+
+        #pragma omp for schedule(dynamic, GENERATE_CHUNK_SIZE) nowait
+        for (uint64_t i = begin; i < end; ++i) {
+            if (pending && omp_get_thread_num() == 0 && !(i & PROGRESS_INTERVAL)) {
+                /* Only the main thread may call MPI. */
+                int done;
+                MPI_Test(pending, &done, MPI_STATUS_IGNORE);
+            }
+            if (!threadSuccess) continue;
+            if (seg == nSegments || i < offsets[seg] || i >= offsets[seg + 1]) {
+                seg = frontier_find_segment(offsets, nSegments, i);
+            }
+            uint64_t hash = level->buckets[seg][i - offsets[seg]];
+            pos_array_t parents = game_get_parents(segment_tier(ds, seg), hash, ds->tier,
+                                                   segment_change(ds, seg), &tp->board, &tp->cache);
+            if (parents.size == ILLEGAL_POSITION_ARRAY_SIZE ||
+                !reserve(ds, &tp->parents, &tp->capacity, tp->size + parents.size)) { // OOM.
+                free(parents.array);
+                threadSuccess = false;
+                continue;
+            }
+            for (uint8_t j = 0; j < parents.size; ++j) {
+                uint64_t idx = pos_index(ds, parents.array[j]);
+                tp->parents[tp->size++] = idx;
+                ++tp->ownerCounts[owner(ds, idx)];
+            }
+            free(parents.array);
+            if (!lose && seg == ds->childTiers.size) {
+                #pragma omp critical(dist_win_stat)
+                update_win_stat(&ds->stat, hash, rmt);
+            }
+        }
+        #pragma omp barrier
+
+        /* Turn the counts of all threads into where each thread puts the
+           parents it owns for each rank, ordered by rank, then thread. */
+        #pragma omp single
+        {
+            uint64_t total = 0;
+            for (int r = 0; r < ds->nRanks; ++r) {
+                ex->sendDispls[r] = (int)total;
+                for (int t = 0; t < ds->nThreads; ++t) {
+                    uint64_t count = ds->threads[t].ownerCounts[r];
+                    ds->threads[t].ownerCounts[r] = total;
+                    total += count;
+                }
+                ex->sendCounts[r] = (int)(total - ex->sendDispls[r]);
+            }
+            if (!reserve(ds, &ex->send, &ex->sendCapacity, total)) success = false;
+        }
+        if (success) {
+            for (uint64_t k = 0; k < tp->size; ++k) {
+                ex->send[tp->ownerCounts[owner(ds, tp->parents[k])]++] = tp->parents[k];
+            }
+        }
+        if (!threadSuccess) {
+            #pragma omp atomic write
+            success = false;
+        }
+    }
+    ex->lose = lose;
+    return success;
+}
+
+/* Starts sending the parents in EX to their owners. Returns false on all
+   ranks, without exchanging anything, if any rank is out of memory for
+   the parents it would receive. */
+static bool start_exchange(dist_solver_t *ds, exchange_t *ex) {
+    MPI_Alltoall(ex->sendCounts, 1, MPI_INT, ex->recvCounts, 1, MPI_INT, MPI_COMM_WORLD);
+    uint64_t nRecv = 0;
+    for (int r = 0; r < ds->nRanks; ++r) {
+        ex->recvDispls[r] = (int)nRecv;
+        nRecv += ex->recvCounts[r];
+        ds->parentsSent += ex->sendCounts[r];
+        if (r != ds->rank) ds->parentsSentRemote += ex->sendCounts[r];
+    }
+    ex->nRecv = nRecv;
+    /* The counts of every rank must match those of its peers, so either
+       all ranks exchange or none does. */
+    if (!all_succeeded(reserve(ds, &ex->recv, &ex->recvCapacity, nRecv))) return false;
+    MPI_Ialltoallv(ex->send, ex->sendCounts, ex->sendDispls, MPI_UINT64_T,
+                   ex->recv, ex->recvCounts, ex->recvDispls, MPI_UINT64_T, MPI_COMM_WORLD, &ex->request);
+    ex->pending = true;
+    return true;
+}
+
+/* Waits for the parents of EX to arrive and updates them. All parents of
+   positions that lose in RMT win in RMT+1. Parents of positions that win
+   in RMT lose in RMT+1 once their last undecided child is decided. */
+static bool finish_exchange(dist_solver_t *ds, exchange_t *ex, uint16_t rmt) {
+    const uint16_t own = ds->childTiers.size;
+    bool success = true;
+    MPI_Wait(&ex->request, MPI_STATUS_IGNORE);
+    ex->pending = false;
+
+    #pragma omp parallel for schedule(dynamic, APPLY_CHUNK_SIZE) reduction(&&:success)
+    for (uint64_t k = 0; k < ex->nRecv; ++k) {
+        uint64_t i = ex->recv[k] - ds->base;
+        if (ex->lose) {
+            if (!__atomic_exchange_n(&ds->nUndChild[i], 0, __ATOMIC_RELAXED)) continue;
+            ds->values[i] = UINT16_MAX - rmt - 1; // Refer to the value table.
+            success &= frontier_add(&ds->winFR, pos_hash(ds, ex->recv[k]), rmt + 1, own);
+        } else {
+            uint8_t remaining = __atomic_load_n(&ds->nUndChild[i], __ATOMIC_RELAXED);
+            while (remaining && !__atomic_compare_exchange_n(&ds->nUndChild[i], &remaining, remaining - 1,
+                                                             false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            if (remaining != 1) continue;
+            ds->values[i] = rmt + 2; // Refer to the value table.
+            success &= frontier_add(&ds->loseFR, pos_hash(ds, ex->recv[k]), rmt + 1, own);
+        }
+    }
+    return success;
+}
+
+/* Processes the N local positions of level RMT of FRONTIER in NBATCHES
+   batches, the largest number of batches of any rank. */
+static bool push_level(dist_solver_t *ds, fr_t *frontier, uint16_t rmt, bool lose, uint64_t nBatches,
+                       uint64_t *offsets) {
+    uint64_t n = frontier_get_ranges(frontier, rmt, offsets);
+    const fr_level_t *level = frontier->levels[rmt];
+    bool success = true;
+    for (uint64_t b = 0; b < nBatches; ++b) {
+        exchange_t *ex = &ds->exchanges[b & 1], *prev = &ds->exchanges[(b + 1) & 1];
+        uint64_t begin = b * EXCHANGE_BATCH_POSITIONS;
+        uint64_t end = begin + EXCHANGE_BATCH_POSITIONS;
+        if (begin > n) begin = n;
+        if (end > n) end = n;
+        success &= generate_parents(ds, level, offsets, begin, end, lose, rmt, ex,
+                                    prev->pending ? &prev->request : NULL);
+        if (prev->pending) success &= finish_exchange(ds, prev, rmt);
+        if (!success) memset(ex->sendCounts, 0, ds->nRanks * sizeof(int));
+        success &= start_exchange(ds, ex);
+    }
+    exchange_t *last = &ds->exchanges[(nBatches + 1) & 1];
+    if (last->pending) success &= finish_exchange(ds, last, rmt);
+    return success;
+}
+
+static bool step_4_push_frontier_up(dist_solver_t *ds) {
+    /* STEP 4: PUSH FRONTIER UP. */
+    const uint16_t nSegments = ds->childTiers.size + 1;
+    uint64_t *offsets = (uint64_t*)memtrack_malloc(&ds->mem, (nSegments + 1) * sizeof(uint64_t));
+    bool success = (offsets != NULL);
+
+    for (uint16_t rmt = 0; ; ++rmt) {
+        /* Levels RMT of both frontiers are complete on all ranks, so all
+           ranks agree on the number of batches of each. */
+        uint64_t local[2] = {0, 0}, global[2];
+        if (offsets) {
+            local[0] = (frontier_get_ranges(&ds->loseFR, rmt, offsets) + EXCHANGE_BATCH_POSITIONS - 1) /
+                       EXCHANGE_BATCH_POSITIONS;
+            local[1] = (frontier_get_ranges(&ds->winFR, rmt, offsets) + EXCHANGE_BATCH_POSITIONS - 1) /
+                       EXCHANGE_BATCH_POSITIONS;
+        }
+        MPI_Allreduce(local, global, 2, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+        if (!all_succeeded(success)) break;
+
+        success &= push_level(ds, &ds->loseFR, rmt, true, global[0], offsets);
+        frontier_free(&ds->loseFR, rmt);
+        success &= push_level(ds, &ds->winFR, rmt, false, global[1], offsets);
+        frontier_free(&ds->winFR, rmt);
+
+        /* Stop after the highest remoteness populated on any rank. */
+        uint64_t levelsEnd = (ds->loseFR.levelsEnd > ds->winFR.levelsEnd) ? ds->loseFR.levelsEnd :
+                                                                             ds->winFR.levelsEnd;
+        uint64_t globalLevelsEnd;
+        MPI_Allreduce(&levelsEnd, &globalLevelsEnd, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+        if (rmt + 1 >= FR_SIZE || rmt + 1 >= globalLevelsEnd) break;
+    }
+    memtrack_free(&ds->mem, offsets);
+    return all_succeeded(success);
+}
+
+static void step_5_mark_draw_positions(dist_solver_t *ds) {
+    /* STEP 5: MARK DRAW POSITIONS AND UPDATE STATISTICS. */
+    uint64_t numLegalPos = 0, numLose = 0, numWin = 0;
+
+    #pragma omp parallel for simd schedule(static) reduction(+:numLegalPos, numLose, numWin)
+    for (uint64_t i = 0; i < ds->n; ++i) {
+        uint8_t nUndChild = ds->nUndChild[i];
+        uint16_t value = ds->values[i];
+        bool legal = (nUndChild != ILLEGAL_NUM_CHILD_POS);
+        bool draw = legal && nUndChild;
+        ds->values[i] = draw ? DRAW_VALUE : value;
+        numLegalPos += legal;
+        numLose += (legal && !nUndChild && value < DRAW_VALUE);
+        numWin += (legal && !nUndChild && value >= DRAW_VALUE);
+    }
+    ds->stat.numLegalPos = numLegalPos;
+    ds->stat.numLose = numLose;
+    ds->stat.numWin = numWin;
+    memtrack_free(&ds->mem, ds->nUndChild); ds->nUndChild = NULL;
+}
+
+static void send_bytes(const void *buf, uint64_t size, int dest) {
+    for (uint64_t sent = 0; sent < size; sent += EXCHANGE_CHUNK_BYTES) {
+        uint64_t count = (size - sent < EXCHANGE_CHUNK_BYTES) ? size - sent : EXCHANGE_CHUNK_BYTES;
+        MPI_Send((const uint8_t*)buf + sent, (int)count, MPI_BYTE, dest, 0, MPI_COMM_WORLD);
+    }
+}
+
+static void recv_bytes(void *buf, uint64_t size, int source) {
+    for (uint64_t received = 0; received < size; received += EXCHANGE_CHUNK_BYTES) {
+        uint64_t count = (size - received < EXCHANGE_CHUNK_BYTES) ? size - received : EXCHANGE_CHUNK_BYTES;
+        MPI_Recv((uint8_t*)buf + received, (int)count, MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+}
+
+/* Adds the statistics of another rank to STAT. Ties are broken in favor
+   of lower ranks. */
+static void merge_stat(tier_solver_stat_t *stat, const tier_solver_stat_t *other) {
+    stat->numLegalPos += other->numLegalPos;
+    stat->numWin += other->numWin;
+    stat->numLose += other->numLose;
+    if (other->longestNumStepsToRedWin > stat->longestNumStepsToRedWin) {
+        stat->longestNumStepsToRedWin = other->longestNumStepsToRedWin;
+        stat->longestPosToRedWin = other->longestPosToRedWin;
+    }
+    if (other->longestNumStepsToBlackWin > stat->longestNumStepsToBlackWin) {
+        stat->longestNumStepsToBlackWin = other->longestNumStepsToBlackWin;
+        stat->longestPosToBlackWin = other->longestPosToBlackWin;
+    }
+}
+
+static bool step_6_save_values(dist_solver_t *ds) {
+    /* STEP 6: COMPRESS EACH SLICE AND SAVE THEM IN ORDER ON RANK 0. */
+    mgz_res_t own = {0};
+    bool success = true;
+    if (ds->n) {
+        own = db_compress_tier_values(ds->values, ds->n, &ds->mem);
+        success = (own.out != NULL);
+    }
+    memtrack_free(&ds->mem, ds->values); ds->values = NULL;
+
+    if (ds->rank) {
+        uint64_t header[3] = {own.size, own.nOutBlocks, success};
+        MPI_Send(header, 3, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
+        if (success) {
+            send_bytes(own.out, own.size, 0);
+            send_bytes(own.outBlockSizes, own.nOutBlocks * sizeof(uint64_t), 0);
+        }
+    } else {
+        tier_writer_t writer;
+        success = db_open_tier_writer(&writer, ds->tier, DB_LAYOUT_TURN_SPLIT, &ds->mem) && success;
+        if (success) success = db_write_tier_blocks(&writer, &own);
+        for (int r = 1; r < ds->nRanks; ++r) {
+            uint64_t header[3];
+            MPI_Recv(header, 3, MPI_UINT64_T, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            if (!header[2]) {
+                success = false;
+                continue;
+            }
+            /* Slices must still be received after a failure. */
+            mgz_res_t slice = {0};
+            slice.size = header[0];
+            slice.nOutBlocks = header[1];
+            slice.out = memtrack_malloc(&ds->mem, slice.size ? slice.size : 1);
+            slice.outBlockSizes = (uint64_t*)memtrack_malloc(&ds->mem, (slice.nOutBlocks + 1) * sizeof(uint64_t));
+            if (!slice.out || !slice.outBlockSizes) {
+                printf("tiersolvermpi_solve_tier: (fatal) out of memory while saving tier %s.\n", ds->tier);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            recv_bytes(slice.out, slice.size, r);
+            recv_bytes(slice.outBlockSizes, slice.nOutBlocks * sizeof(uint64_t), r);
+            if (success) success = db_write_tier_blocks(&writer, &slice);
+            memtrack_free(&ds->mem, slice.out);
+            memtrack_free(&ds->mem, slice.outBlockSizes);
+        }
+        success = db_close_tier_writer(&writer, success) && success;
+    }
+    memtrack_free(&ds->mem, own.out);
+    memtrack_free(&ds->mem, own.outBlockSizes);
+
+    /* Statistics are merged on rank 0, which saves the stat file as the
+       success indicator once the tier file is complete. */
+    tier_solver_stat_t *stats = NULL;
+    if (!ds->rank) stats = (tier_solver_stat_t*)safe_calloc(ds->nRanks, sizeof(tier_solver_stat_t));
+    MPI_Gather(&ds->stat, sizeof(ds->stat), MPI_BYTE, stats, sizeof(ds->stat), MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (!ds->rank) {
+        for (int r = 1; r < ds->nRanks; ++r) merge_stat(&stats[0], &stats[r]);
+        ds->stat = stats[0];
+        free(stats);
+        if (success) db_save_stat(ds->tier, ds->stat, NULL, DB_LAYOUT_TURN_SPLIT);
+    }
+    MPI_Bcast(&ds->stat, sizeof(ds->stat), MPI_BYTE, 0, MPI_COMM_WORLD);
+    int ok = success;
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return ok;
+}
+
+static void step_7_cleanup(dist_solver_t *ds) {
+    frontier_destroy(&ds->winFR);
+    frontier_destroy(&ds->loseFR);
+    tier_array_destroy(&ds->childTiers);
+    memtrack_free(&ds->mem, ds->values); ds->values = NULL;
+    memtrack_free(&ds->mem, ds->nUndChild); ds->nUndChild = NULL;
+    if (ds->threads) {
+        for (int t = 0; t < ds->nThreads; ++t) {
+            memtrack_free(&ds->mem, ds->threads[t].parents);
+            memtrack_free(&ds->mem, ds->threads[t].ownerCounts);
+        }
+        memtrack_free(&ds->mem, ds->threads); ds->threads = NULL;
+    }
+    for (int k = 0; k < 2; ++k) {
+        memtrack_free(&ds->mem, ds->exchanges[k].send);
+        memtrack_free(&ds->mem, ds->exchanges[k].recv);
+        memtrack_free(&ds->mem, ds->exchanges[k].sendCounts);
+    }
+}
+
+/* Prints the slowest rank's time of each step and how many parents were
+   exchanged between ranks. */
+static void print_report(dist_solver_t *ds) {
+    double slowest[DIST_NUM_STEPS];
+    uint64_t local[2] = {ds->parentsSent, ds->parentsSentRemote}, total[2];
+    MPI_Reduce(ds->stepSeconds, slowest, DIST_NUM_STEPS, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local, total, 2, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (ds->rank) return;
+    double elapsed = 0.0;
+    for (int i = 0; i < DIST_NUM_STEPS; ++i) elapsed += slowest[i];
+    printf("tiersolvermpi_solve_tier: solved tier %s on %d ranks with %d threads each in %f seconds.\n",
+           ds->tier, ds->nRanks, ds->nThreads, elapsed);
+    printf("  step seconds:");
+    for (int i = 0; i < DIST_NUM_STEPS; ++i) printf(" %f", slowest[i]);
+    printf("\n  parents exchanged: %" PRIu64 ", sent to other ranks: %" PRIu64 " (%.1f%%)\n",
+           total[0], total[1], total[0] ? 100.0 * total[1] / total[0] : 0.0);
+}
+
+/**
+ * @brief Solves TIER together with all other ranks of MPI_COMM_WORLD,
+ * which must call this function with the same arguments. Assumes all
+ * child tiers have been solved and exist in the database.
+ * @param mem: amount of memory in Bytes available to each rank.
+ * @return Solver statistics of the whole tier on all ranks, or all zeros
+ * if any rank ran out of memory.
+ */
+tier_solver_stat_t tiersolvermpi_solve_tier(const char *tier, uint64_t mem) {
+    dist_solver_t ds;
+    tier_solver_stat_t failed = {0};
+    bool success = all_succeeded(step_0_initialize(&ds, tier, mem));
+    finish_step(&ds, 0);
+    if (success) success = all_succeeded(step_1_load_children(&ds));
+    finish_step(&ds, 1);
+    if (success) success = all_succeeded(step_2_setup_solver_arrays(&ds));
+    finish_step(&ds, 2);
+    if (success) success = all_succeeded(step_3_scan_slice(&ds));
+    finish_step(&ds, 3);
+    if (success) success = step_4_push_frontier_up(&ds);
+    finish_step(&ds, 4);
+    frontier_destroy(&ds.winFR);
+    frontier_destroy(&ds.loseFR);
+    if (success) step_5_mark_draw_positions(&ds);
+    finish_step(&ds, 5);
+    if (success) success = step_6_save_values(&ds);
+    finish_step(&ds, 6);
+    step_7_cleanup(&ds);
+
+    if (!success) {
+        if (!ds.rank) printf("tiersolvermpi_solve_tier: failed to solve tier %s.\n", tier);
+        return failed;
+    }
+    print_report(&ds);
+    return ds.stat;
+}
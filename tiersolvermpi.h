@@ -0,0 +1,8 @@
+#ifndef TIERSOLVERMPI_H
+#define TIERSOLVERMPI_H
+#include <stdint.h>
+#include "db.h"
+
+tier_solver_stat_t tiersolvermpi_solve_tier(const char *tier, uint64_t mem);
+
+#endif // TIERSOLVERMPI_H
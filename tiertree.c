@@ -2,7 +2,7 @@
 #include "tiertree.h"
 #include "common.h"
 #include <assert.h>
-#include <pthread.h>
+#include <omp.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -25,16 +25,24 @@ static const uint64_t DEFAULT_BUCKETS[14] = {
 static tier_tree_entry_t **tree = NULL;
 static uint64_t nbuckets = 0ULL;
 static uint64_t nelements = 0ULL;
-static pthread_mutex_t treeLock;
-static pthread_mutex_t solvableLock;
+static omp_lock_t treeLock;
+static omp_lock_t solvableLock;
+/* Parent index of the tiers in the tree when it was built. Entries are
+   kept by index, and their names are kept sorted by index for lookups
+   after the entries have been freed. */
+static tier_parent_index_t parentIndex;
+static tier_tree_entry_t **indexedEntries = NULL;
+static char (*indexedNames)[TIER_STR_LENGTH_MAX] = NULL;
+static bool *indexedSolved = NULL;
 /************************* End Global Variables *************************/
 
 /********************* Helper Function Declarations *********************/
 static void next_rem(char *tier);
 static uint64_t strhash(const char *str);
-static void tier_tree_add(const char *tier, uint8_t nChildren, pthread_mutex_t *treeLock);
-static void solvable_list_add(const char *tier, TierTreeEntryList **solvable, pthread_mutex_t *solvableLock);
+static void tier_tree_add(const char *tier, uint8_t nChildren, omp_lock_t *treeLock);
+static void solvable_list_add(const char *tier, TierTreeEntryList **solvable, omp_lock_t *solvableLock);
 static void print_tier_tree_status(TierTreeEntryList *solvable);
+static void tier_tree_index_destroy(void);
 /******************* End Helper Function Declarations *******************/
 
 /******************************* Tier Scanner **********************************/
@@ -110,7 +118,33 @@ void tier_scan_driver(int nPiecesMax, void (*func)(const char*)) {
 
 /************************* Tree Builder Multithreaded **************************/
 
-static void append_black_pawns_multithread(char *tier, TierTreeEntryList **solvable) {
+/* Where the tiers found by a scan go: into the tier tree and SOLVABLE, or
+   into RECORDS if RECORDS is not NULL. */
+typedef struct TierScanSink {
+    TierTreeEntryList **solvable;
+    tier_tree_record_t *records;
+    int64_t nRecords;
+    int64_t capacity;
+} tier_scan_sink_t;
+
+static void record_tier(const char *tier, uint8_t nChildren, tier_scan_sink_t *sink) {
+    omp_set_lock(&treeLock);
+    if (sink->nRecords == sink->capacity) {
+        sink->capacity = sink->capacity ? sink->capacity * 2 : 4096;
+        tier_tree_record_t *grown = (tier_tree_record_t*)realloc(sink->records,
+                                                                sink->capacity * sizeof(tier_tree_record_t));
+        if (!grown) {
+            printf("tier_tree_scan_part: OOM.\n");
+            exit(1);
+        }
+        sink->records = grown;
+    }
+    memcpy(sink->records[sink->nRecords].tier, tier, TIER_STR_LENGTH_MAX);
+    sink->records[sink->nRecords++].nChildren = nChildren;
+    omp_unset_lock(&treeLock);
+}
+
+static void append_black_pawns_multithread(char *tier, tier_scan_sink_t *sink) {
     int begin = 14 + tier[RED_P_IDX] - '0';
     int nump = tier[BLACK_P_IDX] - '0';
     tier[begin - 1] = '_';
@@ -121,10 +155,11 @@ static void append_black_pawns_multithread(char *tier, TierTreeEntryList **solva
     while (true) {
         uint8_t numChildren = tier_num_canonical_child_tiers(tier);
 
+        if (sink->records) record_tier(tier, numChildren, sink);
         /* Add tier to tier tree if it depends on at least one child tier. */
-        if (numChildren) tier_tree_add(tier, numChildren, &treeLock);
+        else if (numChildren) tier_tree_add(tier, numChildren, &treeLock);
         /* Tier is primitive and can be solved immediately. */
-        else solvable_list_add(tier, solvable, &solvableLock);
+        else solvable_list_add(tier, sink->solvable, &solvableLock);
 
         /* Go to next combination. */
         int i = begin;
@@ -135,12 +170,12 @@ static void append_black_pawns_multithread(char *tier, TierTreeEntryList **solva
     }
 }
 
-static void append_red_pawns_multithread(char *tier, TierTreeEntryList **solvable) {
+static void append_red_pawns_multithread(char *tier, tier_scan_sink_t *sink) {
     tier[12] = '_';
     int numP = tier[RED_P_IDX] - '0';
     for (int i = 0; i < numP; ++i) tier[13 + i] = '0';
     while (true) {
-        append_black_pawns_multithread(tier, solvable);
+        append_black_pawns_multithread(tier, sink);
         /* Go to next combination. */
         int i = 13;
         ++tier[13];
@@ -150,69 +185,93 @@ static void append_red_pawns_multithread(char *tier, TierTreeEntryList **solvabl
     }
 }
 
-static void generate_tiers_multithread(char *tier, int nPiecesMax, TierTreeEntryList **solvable) {
+static void generate_tiers_multithread(char *tier, int nPiecesMax, tier_scan_sink_t *sink) {
     /* Do not include tiers that exceed maximum
        number of pieces on board. */
     int count = 0;
     for (int i = 0; i < 12; ++i) count += tier[i] - '0';
     if (count > nPiecesMax) return;
-    append_red_pawns_multithread(tier, solvable);
+    append_red_pawns_multithread(tier, sink);
 }
 
-typedef struct TTBTMHelperArgs {
-    uint64_t begin;
-    uint64_t end;
-    char **tiers;
-    TierTreeEntryList **solvable;
-    int nPiecesMax;
-} ttbtm_helper_args_t;
-
-static void *btm_helper(void *_args) {
-    ttbtm_helper_args_t *args = (ttbtm_helper_args_t*)_args;
-    for (uint64_t i = args->begin; i < args->end; ++i) {
-        generate_tiers_multithread(args->tiers[i], args->nPiecesMax, args->solvable);
-    }
-    pthread_exit(NULL);
-    return NULL;
+/* Returns the part, out of NPARTS, that the set of remaining pieces with
+   index I belongs to. Neighboring sets differ in few pieces and expand into
+   similar numbers of tiers, so they are scattered with a hash to keep the
+   parts even. */
+static int rem_part(uint64_t i, int nParts) {
+    uint64_t x = i + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (int)((x ^ (x >> 31)) % (uint64_t)nParts);
 }
 
-static TierTreeEntryList *build_tree_multithread(int nPiecesMax, uint64_t nthread) {
-    TierTreeEntryList *solvable = NULL;
+/* Scans the sets of remaining pieces in part PART of NPARTS with NTHREAD
+   threads and sends every tier found to SINK. */
+static void scan_multithread(int nPiecesMax, uint64_t nthread, int part, int nParts,
+                             tier_scan_sink_t *sink, const char *functionName) {
     char tier[TIER_STR_LENGTH_MAX] = "000000000000";
     char **tiers = (char**)safe_calloc(N_REMS, sizeof(char*));
+    uint64_t n = 0;
     for (uint64_t i = 0; i < N_REMS; ++i) {
-        tiers[i] = (char*)safe_malloc(TIER_STR_LENGTH_MAX);
-        memcpy(tiers[i], tier, TIER_STR_LENGTH_MAX);
+        if (nParts == 1 || rem_part(i, nParts) == part) {
+            tiers[n] = (char*)safe_malloc(TIER_STR_LENGTH_MAX);
+            memcpy(tiers[n++], tier, TIER_STR_LENGTH_MAX);
+        }
         next_rem(tier);
     }
     
-    pthread_t *tid = (pthread_t*)safe_calloc(nthread, sizeof(pthread_t*));
-    ttbtm_helper_args_t *args = (ttbtm_helper_args_t*)safe_malloc(
-                nthread * sizeof(ttbtm_helper_args_t));
-    pthread_mutex_init(&treeLock, NULL);
-    pthread_mutex_init(&solvableLock, NULL);
-
-    for (uint64_t i = 0; i < nthread; ++i) {
-        args[i].begin = i * (N_REMS / nthread);
-        args[i].end = (i == nthread - 1) ? N_REMS : (i + 1) * (N_REMS / nthread);
-        args[i].tiers = tiers;
-        args[i].nPiecesMax = nPiecesMax;
-        args[i].solvable = &solvable;
-        pthread_create(tid + i, NULL, btm_helper, (void*)(args + i));
-    }
-    for (uint64_t i = 0; i < nthread; ++i) pthread_join(tid[i], NULL);
-    free(args);
-    free(tid);
-    for (uint64_t i = 0; i < N_REMS; ++i) free(tiers[i]);
+    omp_init_lock(&treeLock);
+    omp_init_lock(&solvableLock);
+
+    /* Sets of remaining pieces with few pieces are skipped right away
+       while others expand into many tiers, so they are handed out in
+       small chunks rather than split evenly among threads. */
+    thread_load_t load = {0};
+    #pragma omp parallel num_threads(nthread)
+    {
+        double start = omp_get_wtime(), busy = 0.0, idle = 0.0;
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (uint64_t i = 0; i < n; ++i) {
+            generate_tiers_multithread(tiers[i], nPiecesMax, sink);
+        }
+        load_barrier(start, &busy, &idle);
+        thread_load_add(&load, busy, idle);
+    }
+    for (uint64_t i = 0; i < n; ++i) free(tiers[i]);
     free(tiers);
-    pthread_mutex_destroy(&treeLock);
-    pthread_mutex_destroy(&solvableLock);
+    omp_destroy_lock(&treeLock);
+    omp_destroy_lock(&solvableLock);
+
+    printf("%s: tier tree built by %d threads, busiest thread %.3fs, "
+           "imbalance %.3f, idle %.3fs.\n", functionName, load.nThreads, load.busyMax,
+           thread_load_imbalance(&load), load.idleSum);
+}
 
-    printf("build_tree_multithread: tier tree built.\n");
+static TierTreeEntryList *build_tree_multithread(int nPiecesMax, uint64_t nthread) {
+    TierTreeEntryList *solvable = NULL;
+    tier_scan_sink_t sink = {&solvable, NULL, 0, 0};
+    scan_multithread(nPiecesMax, nthread, 0, 1, &sink, "build_tree_multithread");
     print_tier_tree_status(solvable);
     return solvable;
 }
 
+/**
+ * @brief Scans part PART of NPARTS of all tiers with at most NPIECESMAX
+ * pieces with NTHREAD threads, without building a tree, and returns the
+ * tiers found with their numbers of canonical children. Sets *N to their
+ * number. Every tier is in exactly one part, so the parts scanned by
+ * separate processes together make up the tier tree, which one of them
+ * builds with tier_tree_init_from_records.
+ */
+tier_tree_record_t *tier_tree_scan_part(uint8_t nPiecesMax, int part, int nParts, uint64_t nthread, int64_t *n) {
+    tier_scan_sink_t sink = {NULL, NULL, 0, 0};
+    sink.records = (tier_tree_record_t*)safe_malloc(sizeof(tier_tree_record_t));
+    sink.capacity = 1;
+    scan_multithread(nPiecesMax, nthread, part, nParts, &sink, "tier_tree_scan_part");
+    *n = sink.nRecords;
+    return sink.records;
+}
+
 /********************** End Tree Builder Multithreaded ***********************/
 
 /************************* File-based Tree Builder ***************************/
@@ -291,6 +350,25 @@ TierTreeEntryList *tier_tree_init(uint8_t nPiecesMax, uint64_t nthread) {
     return build_tree_multithread(nPiecesMax, nthread);
 }
 
+/**
+ * @brief Initializes the tier tree of tiers with at most NPIECESMAX pieces
+ * from the N RECORDS of all parts scanned by tier_tree_scan_part, returning
+ * a list of immediately solvable tiers. Does nothing and returns NULL if
+ * tier tree has already been initialized.
+ */
+TierTreeEntryList *tier_tree_init_from_records(uint8_t nPiecesMax, const tier_tree_record_t *records, int64_t n) {
+    if (tree) return NULL;
+    TierTreeEntryList *solvable = NULL;
+    nbuckets = DEFAULT_BUCKETS[nPiecesMax];
+    tree = safe_calloc(nbuckets, sizeof(tier_tree_entry_t*));
+    for (int64_t i = 0; i < n; ++i) {
+        if (records[i].nChildren) tier_tree_add(records[i].tier, records[i].nChildren, NULL);
+        else solvable_list_add(records[i].tier, &solvable, NULL);
+    }
+    print_tier_tree_status(solvable);
+    return solvable;
+}
+
 TierTreeEntryList *tier_tree_init_from_file(const char *filename, uint64_t mem) {
     if (tree) return NULL;
     nbuckets = DEFAULT_BUCKETS[6]; // Estimated upper bound.
@@ -316,6 +394,7 @@ void tier_tree_destroy(void) {
     free(tree); tree = NULL;
     nbuckets = 0ULL;
     nelements = 0ULL;
+    tier_tree_index_destroy();
 }
 
 /**
@@ -352,6 +431,227 @@ tier_tree_entry_t *tier_tree_remove(const char *tier) {
 
 /**************************** End Tree Utilities *******************************/
 
+/******************************* Parent Index *********************************/
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp((*(tier_tree_entry_t* const*)a)->tier, (*(tier_tree_entry_t* const*)b)->tier);
+}
+
+static int compare_ids(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns the index of TIER among the N sorted tier NAMES, or -1 if TIER
+   is not among them. */
+static int64_t find_name(const char (*names)[TIER_STR_LENGTH_MAX], int64_t n, const char *tier) {
+    int64_t lo = 0, hi = n - 1;
+    while (lo <= hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(names[mid], tier);
+        if (!cmp) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/* Stores the distinct canonical parents of TIER among the N sorted tier
+   NAMES in PARENTS, sorted by index, and returns their number. */
+static int64_t find_indexed_parents(const char (*names)[TIER_STR_LENGTH_MAX], int64_t n,
+                                    const char *tier, int64_t **parents) {
+    int64_t nParents = 0, capacity = 0;
+    *parents = NULL;
+    TierList *parentTiers = tier_get_parent_tier_list(tier);
+    for (struct TierListElem *walker = parentTiers; walker; walker = walker->next) {
+        struct TierListElem *canonical = tier_get_canonical_tier(walker->tier);
+        int64_t id = find_name(names, n, canonical->tier);
+        free(canonical);
+        if (id < 0) continue; // Not being solved.
+        if (nParents == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            int64_t *grown = (int64_t*)realloc(*parents, capacity * sizeof(int64_t));
+            if (!grown) {
+                printf("tier_tree_index_parents: OOM.\n");
+                exit(1);
+            }
+            *parents = grown;
+        }
+        (*parents)[nParents++] = id;
+    }
+    tier_list_destroy(parentTiers);
+    qsort(*parents, nParents, sizeof(int64_t), compare_ids);
+    /* A child may have two parents that are symmetrical to each other,
+       in which case it counts towards their canonical tier only once. */
+    int64_t nDistinct = 0;
+    for (int64_t i = 0; i < nParents; ++i) {
+        if (!nDistinct || (*parents)[nDistinct - 1] != (*parents)[i]) (*parents)[nDistinct++] = (*parents)[i];
+    }
+    return nDistinct;
+}
+
+/**
+ * @brief Indexes all tiers in the tier tree and in the SOLVABLE list in
+ * the order of their names, replacing any existing index, and returns the
+ * names of the N indexed tiers, TIER_STR_LENGTH_MAX bytes apart. Their
+ * parents are then found with tier_tree_find_parents_part and set with
+ * tier_tree_index_set_parents.
+ */
+const char *tier_tree_index_tiers(TierTreeEntryList *solvable, int64_t *n) {
+    tier_tree_index_destroy();
+    *n = (int64_t)nelements;
+    for (TierTreeEntryList *walker = solvable; walker; walker = walker->next) ++*n;
+    indexedEntries = (tier_tree_entry_t**)safe_malloc((*n ? *n : 1) * sizeof(tier_tree_entry_t*));
+    int64_t k = 0;
+    for (uint64_t i = 0; i < nbuckets; ++i) {
+        for (tier_tree_entry_t *walker = tree[i]; walker; walker = walker->next) indexedEntries[k++] = walker;
+    }
+    for (TierTreeEntryList *walker = solvable; walker; walker = walker->next) indexedEntries[k++] = walker;
+    qsort(indexedEntries, *n, sizeof(tier_tree_entry_t*), compare_entries);
+
+    indexedNames = safe_malloc((*n ? *n : 1) * TIER_STR_LENGTH_MAX);
+    indexedSolved = (bool*)safe_calloc(*n ? *n : 1, sizeof(bool));
+    for (int64_t i = 0; i < *n; ++i) {
+        memcpy(indexedNames[i], indexedEntries[i]->tier, TIER_STR_LENGTH_MAX);
+        indexedEntries[i]->id = i;
+    }
+    parentIndex.nTiers = *n;
+    return (const char*)indexedNames;
+}
+
+/**
+ * @brief Finds the distinct canonical parents of the tiers in part PART of
+ * NPARTS among the N sorted tier NAMES, TIER_STR_LENGTH_MAX bytes apart,
+ * with NTHREAD threads. The tiers with indices I + PART * NPARTS make up
+ * the part. Stores their numbers of parents in LENGTHS in the order of
+ * their indices and returns their parents in the same order, setting
+ * *NPARENTS to the total. Needs no tier tree, so the parts of an index
+ * built by one process can be found by others.
+ */
+int64_t *tier_tree_find_parents_part(const char *names, int64_t n, int part, int nParts,
+                                     uint64_t nthread, int32_t *lengths, int64_t *nParents) {
+    const char (*sorted)[TIER_STR_LENGTH_MAX] = (const char (*)[TIER_STR_LENGTH_MAX])names;
+    int64_t nPart = (n > part) ? (n - part + nParts - 1) / nParts : 0;
+    int64_t **rows = (int64_t**)safe_calloc(nPart ? nPart : 1, sizeof(int64_t*));
+
+    /* Non-canonical tiers are never solved and need no parents. */
+    #pragma omp parallel for schedule(dynamic, 256) num_threads(nthread)
+    for (int64_t i = 0; i < nPart; ++i) {
+        const char *tier = sorted[part + i * nParts];
+        lengths[i] = tier_is_canonical_tier(tier) ? (int32_t)find_indexed_parents(sorted, n, tier, &rows[i]) : 0;
+    }
+    *nParents = 0;
+    for (int64_t i = 0; i < nPart; ++i) *nParents += lengths[i];
+    int64_t *parents = (int64_t*)safe_malloc((*nParents ? *nParents : 1) * sizeof(int64_t)), k = 0;
+    for (int64_t i = 0; i < nPart; ++i) {
+        if (lengths[i]) memcpy(parents + k, rows[i], lengths[i] * sizeof(int64_t));
+        k += lengths[i];
+        free(rows[i]);
+    }
+    free(rows);
+    return parents;
+}
+
+/* Sets the parents of the indexed tiers from the LENGTHS and PARENTS that
+   tier_tree_find_parents_part found for all NPARTS parts, each
+   concatenated in the order of the parts. */
+void tier_tree_index_set_parents(int nParts, const int32_t *lengths, const int64_t *parents) {
+    int64_t n = parentIndex.nTiers, k = 0;
+    parentIndex.offsets = (int64_t*)safe_calloc(n + 1, sizeof(int64_t));
+    for (int part = 0; part < nParts; ++part) {
+        for (int64_t id = part; id < n; id += nParts) parentIndex.offsets[id + 1] = lengths[k++];
+    }
+    for (int64_t i = 0; i < n; ++i) parentIndex.offsets[i + 1] += parentIndex.offsets[i];
+    parentIndex.parents = (int64_t*)safe_malloc((parentIndex.offsets[n] ? parentIndex.offsets[n] : 1) * sizeof(int64_t));
+    k = 0;
+    for (int part = 0; part < nParts; ++part) {
+        for (int64_t id = part; id < n; id += nParts) {
+            int64_t length = parentIndex.offsets[id + 1] - parentIndex.offsets[id];
+            memcpy(parentIndex.parents + parentIndex.offsets[id], parents + k, length * sizeof(int64_t));
+            k += length;
+        }
+    }
+}
+
+/**
+ * @brief Indexes all tiers in the tier tree and in the SOLVABLE list and
+ * finds the canonical parents of each of them once, using NTHREAD threads,
+ * so that solving a tier updates its parents with tier_tree_mark_solved
+ * without generating, canonicalizing, or looking up a single tier name.
+ * Indices follow the order of tier names. Replaces any existing index.
+ */
+void tier_tree_index_parents(TierTreeEntryList *solvable, uint64_t nthread) {
+    int64_t n, nParents;
+    const char *names = tier_tree_index_tiers(solvable, &n);
+    int32_t *lengths = (int32_t*)safe_malloc((n ? n : 1) * sizeof(int32_t));
+    int64_t *parents = tier_tree_find_parents_part(names, n, 0, 1, nthread, lengths, &nParents);
+    tier_tree_index_set_parents(1, lengths, parents);
+    free(lengths);
+    free(parents);
+}
+
+/* Returns the parent index, which is empty if no index has been built. */
+const tier_parent_index_t *tier_tree_parent_index(void) {
+    return &parentIndex;
+}
+
+/* Returns the index of TIER, or -1 if TIER is not indexed. */
+int64_t tier_tree_index_find(const char *tier) {
+    return find_name(indexedNames, parentIndex.nTiers, tier);
+}
+
+bool tier_tree_index_solved(int64_t id) {
+    return id >= 0 && id < parentIndex.nTiers && indexedSolved[id];
+}
+
+/**
+ * @brief Marks the indexed tier ID solved and returns the entries of its
+ * parents that have no unsolved children left, removed from the tier tree
+ * in the order of their indices. Each parent costs a decrement, so the
+ * cost of a solved tier is proportional to its number of parents only.
+ * Marking a tier solved again has no effect and returns NULL.
+ */
+TierTreeEntryList *tier_tree_mark_solved(int64_t id) {
+    TierTreeEntryList *ret = NULL, **tail = &ret;
+    if (id < 0 || id >= parentIndex.nTiers || indexedSolved[id]) return NULL;
+    indexedSolved[id] = true;
+    for (int64_t i = parentIndex.offsets[id]; i < parentIndex.offsets[id + 1]; ++i) {
+        int64_t parent = parentIndex.parents[i];
+        if (indexedSolved[parent]) continue;
+        tier_tree_entry_t *entry = indexedEntries[parent];
+        if (!entry->numUnsolvedChildren || --entry->numUnsolvedChildren) continue;
+        if (!(*tail = tier_tree_remove_indexed(parent))) continue;
+        tail = &(*tail)->next;
+        *tail = NULL;
+    }
+    return ret;
+}
+
+/* Removes and returns the entry of the indexed tier ID from the tier tree,
+   or returns NULL if it is not in the tree. */
+tier_tree_entry_t *tier_tree_remove_indexed(int64_t id) {
+    if (id < 0 || id >= parentIndex.nTiers || indexedSolved[id]) return NULL;
+    return tier_tree_remove(indexedNames[id]);
+}
+
+/* Returns the entry of the indexed tier ID, or NULL if it has been marked
+   solved. The entry may have been removed from the tier tree. */
+tier_tree_entry_t *tier_tree_indexed_entry(int64_t id) {
+    if (id < 0 || id >= parentIndex.nTiers || indexedSolved[id]) return NULL;
+    return indexedEntries[id];
+}
+
+static void tier_tree_index_destroy(void) {
+    free(parentIndex.offsets);
+    free(parentIndex.parents);
+    memset(&parentIndex, 0, sizeof(parentIndex));
+    free(indexedEntries); indexedEntries = NULL;
+    free(indexedNames); indexedNames = NULL;
+    free(indexedSolved); indexedSolved = NULL;
+}
+
+/***************************** End Parent Index *******************************/
+
 /***************************** Helper Functions ******************************/
 
 static void next_rem(char *tier) {
@@ -384,19 +684,21 @@ static uint64_t strhash(const char *str) {
  * tier again results in undefined behavior.
  */
 static void tier_tree_add(const char *tier, uint8_t nChildren,
-                          pthread_mutex_t *treeLock) {
+                          omp_lock_t *treeLock) {
     uint64_t slot = strhash(tier) % nbuckets;
     tier_tree_entry_t *e = safe_malloc(sizeof(tier_tree_entry_t));
     memcpy(e->tier, tier, TIER_STR_LENGTH_MAX);
     e->numUnsolvedChildren = nChildren;
-    if (treeLock) pthread_mutex_lock(treeLock);
+    e->criticalPath = 0.0;
+    e->id = -1;
+    if (treeLock) omp_set_lock(treeLock);
     e->next = tree[slot];
     tree[slot] = e;
     ++nelements;
-    if (treeLock) pthread_mutex_unlock(treeLock);
+    if (treeLock) omp_unset_lock(treeLock);
 }
 
-static void solvable_list_add(const char *tier, TierTreeEntryList **solvable, pthread_mutex_t *solvableLock) {
+static void solvable_list_add(const char *tier, TierTreeEntryList **solvable, omp_lock_t *solvableLock) {
     /* Do not add if the given tier has already been added. */
     for (tier_tree_entry_t *walker = *solvable; walker; walker = walker->next) {
         if (!strncmp(tier, walker->tier, TIER_STR_LENGTH_MAX)) return;
@@ -405,10 +707,12 @@ static void solvable_list_add(const char *tier, TierTreeEntryList **solvable, pt
     tier_tree_entry_t *e = safe_malloc(sizeof(tier_tree_entry_t));
     memcpy(e->tier, tier, TIER_STR_LENGTH_MAX);
     e->numUnsolvedChildren = 0;
-    if (solvableLock) pthread_mutex_lock(solvableLock);
+    e->criticalPath = 0.0;
+    e->id = -1;
+    if (solvableLock) omp_set_lock(solvableLock);
     e->next = *solvable;
     *solvable = e;
-    if (solvableLock) pthread_mutex_unlock(solvableLock);
+    if (solvableLock) omp_unset_lock(solvableLock);
 }
 
 static void print_tier_tree_status(TierTreeEntryList *solvable) {
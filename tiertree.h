@@ -1,5 +1,6 @@
 #ifndef TIERTREE_H
 #define TIERTREE_H
+#include <stdbool.h>
 #include <stdint.h>
 #include "tier.h"
 
@@ -7,15 +8,45 @@ typedef struct TierTreeEntry {
     struct TierTreeEntry *next;
     char tier[TIER_STR_LENGTH_MAX];
     uint8_t numUnsolvedChildren;
+    double criticalPath; // Estimated thread-seconds to solve the tier and its longest chain of ancestors, 0 if unknown.
+    int64_t id;          // Index of the tier in the parent index, -1 if not indexed.
 } tier_tree_entry_t;
 
 typedef tier_tree_entry_t TierTreeEntryList;
 
+/* A tier found by tier_tree_scan_part and its number of canonical children. */
+typedef struct TierTreeRecord {
+    char tier[TIER_STR_LENGTH_MAX];
+    uint8_t nChildren;
+} tier_tree_record_t;
+
+/* Distinct canonical parents of every indexed tier. The parents of the
+   tier with index I are PARENTS[OFFSETS[I]] to PARENTS[OFFSETS[I+1]-1]. */
+typedef struct TierParentIndex {
+    int64_t nTiers;
+    int64_t *offsets;
+    int64_t *parents;
+} tier_parent_index_t;
+
 TierTreeEntryList *tier_tree_init(uint8_t nPiecesMax, uint64_t nthread);
 TierTreeEntryList *tier_tree_init_from_file(const char *filename, uint64_t mem);
+tier_tree_record_t *tier_tree_scan_part(uint8_t nPiecesMax, int part, int nParts, uint64_t nthread, int64_t *n);
+TierTreeEntryList *tier_tree_init_from_records(uint8_t nPiecesMax, const tier_tree_record_t *records, int64_t n);
 void tier_tree_destroy(void);
 tier_tree_entry_t *tier_tree_find(const char *tier);
 tier_tree_entry_t *tier_tree_remove(const char *tier);
 
+void tier_tree_index_parents(TierTreeEntryList *solvable, uint64_t nthread);
+const char *tier_tree_index_tiers(TierTreeEntryList *solvable, int64_t *n);
+int64_t *tier_tree_find_parents_part(const char *names, int64_t n, int part, int nParts,
+                                     uint64_t nthread, int32_t *lengths, int64_t *nParents);
+void tier_tree_index_set_parents(int nParts, const int32_t *lengths, const int64_t *parents);
+const tier_parent_index_t *tier_tree_parent_index(void);
+int64_t tier_tree_index_find(const char *tier);
+bool tier_tree_index_solved(int64_t id);
+TierTreeEntryList *tier_tree_mark_solved(int64_t id);
+tier_tree_entry_t *tier_tree_remove_indexed(int64_t id);
+tier_tree_entry_t *tier_tree_indexed_entry(int64_t id);
+
 void tier_scan_driver(int nPiecesMax, void (*func)(const char*));
 #endif // TIERTREE_H
@@ -8,6 +8,7 @@ SOURCES += \
         frontier.c \
         game.c \
         main.c \
+        memtrack.c \
         misc.c \
         solver.c \
         tests/game_test.c \
@@ -20,6 +21,7 @@ HEADERS += \
     common.h \
     frontier.h \
     game.h \
+    memtrack.h \
     misc.h \
     solver.h \
     tests/game_test.h \